@@ -0,0 +1,160 @@
+/*
+** Copyright (C) 2017 Romain CYRILLE
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+/*
+ * Benchmark of the aggregation table
+ *
+ * A synthetic device has NB_AGGS aggregations and NB_PORTS ports, every port
+ * being attached to one of them. A walk of the device is replayed on:
+ *   - the agg_table_t of the module, allocated by the walk
+ *   - the agg_table_t of the module, reset and reused as the spare table of
+ *     the walk of the device
+ *   - the linked list the aggregations were kept in before, where adding an
+ *     aggregation or looking one up browses the list
+ * The module is included so its static functions can be called.
+ */
+
+#include BENCH_MODULE
+#include <time.h>
+
+#define NB_AGGS 500
+#define NB_PORTS 2000
+#define NB_ROUNDS 200
+#define FIRST_AGG_INDEX 5000
+
+/* the linked list of the aggregations before the agg_table_t */
+struct list_agg_struct{
+    struct list_agg_struct * next;
+    long index;
+    long * ports;
+    int nb_ports;
+    int max_ports;
+};
+typedef struct list_agg_struct list_agg_t;
+
+static list_agg_t * list_agg_exist(long index, list_agg_t *agg){
+    for(;agg != NULL;agg = agg->next){
+        if(agg->index == index)return agg;
+    }
+    return NULL;
+}
+
+static list_agg_t * list_agg_add(long index, list_agg_t **agg){
+    list_agg_t *new = (list_agg_t *)calloc(1, sizeof(list_agg_t));
+
+    new->index = index;
+    while(*agg != NULL)agg = &(*agg)->next;
+    *agg = new;
+    return new;
+}
+
+static void list_agg_add_port(long port, list_agg_t *agg){
+    if(agg->nb_ports == agg->max_ports){
+        agg->max_ports = agg->max_ports ? agg->max_ports*2 : 8;
+        agg->ports = (long *)realloc(agg->ports, sizeof(long)*agg->max_ports);
+    }
+    agg->ports[agg->nb_ports++] = port;
+}
+
+static void list_agg_free(list_agg_t *agg){
+    list_agg_t *next;
+
+    for(;agg != NULL;agg = next){
+        next = agg->next;
+        free(agg->ports);
+        free(agg);
+    }
+}
+
+/* the aggregation of a port of the synthetic device */
+static long port_agg(long port){
+    return FIRST_AGG_INDEX + port % NB_AGGS;
+}
+
+static double bench_now(void){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1e6 + ts.tv_nsec/1e3;
+}
+
+static int walk_table(agg_table_t **table){
+    agg_struct_t *agg;
+    long i;
+
+    for(i=0;i<NB_AGGS;i++){
+        if(agg_table_add(FIRST_AGG_INDEX+i, table, NULL) == NULL)return -1;
+    }
+    for(i=1;i<=NB_PORTS;i++){
+        agg = agg_table_exist(port_agg(i), *table);
+        if(agg == NULL || agg_table_add_port(i, agg, *table) != SUCCEED)return -1;
+    }
+    agg_table_build_ports(*table);
+    return (*table)->aggs[NB_AGGS-1].nb_ports;
+}
+
+static int walk_list(list_agg_t **list){
+    list_agg_t *agg;
+    long i;
+
+    for(i=0;i<NB_AGGS;i++)list_agg_add(FIRST_AGG_INDEX+i, list);
+    for(i=1;i<=NB_PORTS;i++){
+        agg = list_agg_exist(port_agg(i), *list);
+        if(agg == NULL)return -1;
+        list_agg_add_port(i, agg);
+    }
+    return list_agg_exist(FIRST_AGG_INDEX+NB_AGGS-1, *list)->nb_ports;
+}
+
+int main(void){
+    agg_table_t *table;
+    agg_table_t *spare = NULL;
+    list_agg_t *list;
+    double start;
+    double table_us = 0;
+    double spare_us = 0;
+    double list_us = 0;
+    int round;
+
+    for(round=0;round<NB_ROUNDS;round++){
+        table = NULL;
+        start = bench_now();
+        if(walk_table(&table) != NB_PORTS/NB_AGGS)return 1;
+        agg_table_free(table);
+        table_us += bench_now() - start;
+
+        //The spare table is filled again as by the walk of a device
+        start = bench_now();
+        agg_table_reset(spare);
+        if(walk_table(&spare) != NB_PORTS/NB_AGGS)return 1;
+        spare_us += bench_now() - start;
+
+        list = NULL;
+        start = bench_now();
+        if(walk_list(&list) != NB_PORTS/NB_AGGS)return 1;
+        list_agg_free(list);
+        list_us += bench_now() - start;
+    }
+    agg_table_free(spare);
+
+    printf("agg_table: %d aggregations, %d ports, mean of %d walks\n", NB_AGGS, NB_PORTS, NB_ROUNDS);
+    printf("  agg_table_t           %8.1f us\n", table_us/NB_ROUNDS);
+    printf("  agg_table_t reused    %8.1f us\n", spare_us/NB_ROUNDS);
+    printf("  linked list           %8.1f us\n", list_us/NB_ROUNDS);
+    return 0;
+}
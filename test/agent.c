@@ -0,0 +1,502 @@
+/*
+** Copyright (C) 2017 Romain CYRILLE
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+/*
+ * Stub SNMP agent of the tests
+ *
+ * It implements the subset of the net-snmp API used by the module. Every
+ * device answers from the same MIB, loaded from a file by agent_load, except
+ * agent_dead_peer which never answers. Every session owns a pipe standing
+ * for its socket: a byte is written in it when a request is answered, so the
+ * epoll loop of the module wakes up as with a real socket.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <net-snmp/net-snmp-includes.h>
+#include "test.h"
+
+#define AGENT_MAX_VALUE 256
+
+/*  This structure is a variable of the MIB of the agent*/
+struct agent_var_struct{
+    oid name[MAX_OID_LEN];
+    size_t name_length;
+    u_char type;
+    long integer;
+    char string[AGENT_MAX_VALUE];
+};
+typedef struct agent_var_struct agent_var_t;
+
+/*  This structure, that is a list, is a request waiting for its response*/
+struct agent_request_struct{
+    netsnmp_pdu *pdu;
+    netsnmp_callback callback;
+    void *magic;
+    long long deadline;
+    struct in_addr peer;
+    struct agent_request_struct *next;
+};
+typedef struct agent_request_struct agent_request_t;
+
+/*  This structure is a session opened by snmp_sess_open*/
+struct agent_session_struct{
+    netsnmp_session session;
+    netsnmp_transport transport;
+    int pipe_fds[2];
+    agent_request_t *requests;
+    pthread_mutex_t lock;
+};
+typedef struct agent_session_struct agent_session_t;
+
+static agent_var_t *mib = NULL;
+static int nb_vars = 0;
+static long next_reqid = 1;
+static pthread_mutex_t agent_lock = PTHREAD_MUTEX_INITIALIZER;
+
+const char *agent_dead_peer = "10.0.0.99";
+int agent_requests = 0;
+int agent_sessions = 0;
+
+static long long agent_clock(void){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec*1000 + ts.tv_nsec/1000000;
+}
+
+static int agent_oid_compare(const oid *name1, size_t len1, const oid *name2, size_t len2){
+    size_t i;
+
+    for(i=0;i<len1 && i<len2;i++){
+        if(name1[i] != name2[i])return name1[i] < name2[i] ? -1 : 1;
+    }
+    if(len1 == len2)return 0;
+    return len1 < len2 ? -1 : 1;
+}
+
+static int agent_var_compare(const void *var1, const void *var2){
+    const agent_var_t *a = var1;
+    const agent_var_t *b = var2;
+
+    return agent_oid_compare(a->name, a->name_length, b->name, b->name_length);
+}
+
+static size_t agent_oid_parse(const char *str, oid *name, char **end){
+    size_t length = 0;
+    char *next;
+
+    if(*str == '.')str++;
+    while(length < MAX_OID_LEN){
+        name[length++] = strtoul(str, &next, 10);
+        str = next;
+        if(*str != '.')break;
+        str++;
+    }
+    if(end != NULL)*end = (char *)str;
+    return length;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: agent_load                                                       *
+ *                                                                            *
+ * Purpose: Load the MIB answered by the agent                                *
+ *                                                                            *
+ * Parameters: path - a file with a variable per line, as                    *
+ *                    ".1.3.6.1.2.1.2.2.1.8.1 i 1" or                         *
+ *                    ".1.3.6.1.2.1.2.2.1.2.1 s GigabitEthernet1/0/1"         *
+ *                                                                            *
+ * Return value: 0 - the MIB is loaded                                        *
+ *               -1 - the file can not be read                                *
+ *                                                                            *
+ ******************************************************************************/
+int agent_load(const char *path){
+    FILE *file;
+    char line[512];
+    char *value;
+    agent_var_t *var;
+
+    file = fopen(path, "r");
+    if(file == NULL)return -1;
+    free(mib);
+    mib = NULL;
+    nb_vars = 0;
+    while(fgets(line, sizeof(line), file) != NULL){
+        if(line[0] != '.')continue;
+        line[strcspn(line, "\n")] = '\0';
+        mib = realloc(mib, sizeof(agent_var_t)*(nb_vars+1));
+        var = &mib[nb_vars++];
+        memset(var, 0, sizeof(agent_var_t));
+        var->name_length = agent_oid_parse(line, var->name, &value);
+        if(strncmp(value, " i ", 3) == 0){
+            var->type = ASN_INTEGER;
+            var->integer = atol(value+3);
+        }else{
+            var->type = ASN_OCTET_STR;
+            snprintf(var->string, sizeof(var->string), "%s", value+3);
+        }
+    }
+    fclose(file);
+    qsort(mib, nb_vars, sizeof(agent_var_t), agent_var_compare);
+    return 0;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: agent_set                                                        *
+ *                                                                            *
+ * Purpose: Change the value of an integer variable of the MIB                *
+ *                                                                            *
+ * Parameters: name - the oid of the variable, as ".1.3.6.1.2.1.2.2.1.8.1"    *
+ *             value - its new value                                          *
+ *                                                                            *
+ ******************************************************************************/
+void agent_set(const char *name, long value){
+    oid var_name[MAX_OID_LEN];
+    size_t length;
+    int i;
+
+    length = agent_oid_parse(name, var_name, NULL);
+    for(i=0;i<nb_vars;i++){
+        if(agent_oid_compare(var_name, length, mib[i].name, mib[i].name_length) == 0)mib[i].integer = value;
+    }
+}
+
+static netsnmp_variable_list * agent_add_var(netsnmp_pdu *pdu, const oid *name, size_t name_length, u_char type, const void *value, size_t value_length){
+    netsnmp_variable_list *var;
+    netsnmp_variable_list **last = &pdu->variables;
+
+    var = calloc(1, sizeof(netsnmp_variable_list));
+    while(*last != NULL)last = &(*last)->next_variable;
+    *last = var;
+    var->name = var->name_loc;
+    memcpy(var->name, name, sizeof(oid)*name_length);
+    var->name_length = name_length;
+    var->type = type;
+    if(type == ASN_INTEGER){
+        var->val.integer = malloc(sizeof(long));
+        *var->val.integer = *(const long *)value;
+        var->val_len = sizeof(long);
+    }else if(type == ASN_OCTET_STR){
+        var->val.string = malloc(value_length+1);
+        memcpy(var->val.string, value, value_length);
+        var->val.string[value_length] = '\0';
+        var->val_len = value_length;
+    }
+    return var;
+}
+
+static netsnmp_variable_list * agent_add_mib_var(netsnmp_pdu *pdu, agent_var_t *var){
+    if(var->type == ASN_INTEGER)return agent_add_var(pdu, var->name, var->name_length, ASN_INTEGER, &var->integer, sizeof(long));
+    return agent_add_var(pdu, var->name, var->name_length, ASN_OCTET_STR, var->string, strlen(var->string));
+}
+
+static agent_var_t * agent_next_var(const oid *name, size_t name_length){
+    int i;
+
+    for(i=0;i<nb_vars;i++){
+        if(agent_oid_compare(mib[i].name, mib[i].name_length, name, name_length) > 0)return &mib[i];
+    }
+    return NULL;
+}
+
+/* Build the response of a GET or a GETBULK request from the MIB */
+static netsnmp_pdu * agent_answer(netsnmp_pdu *request){
+    netsnmp_pdu *response;
+    netsnmp_variable_list *var;
+    netsnmp_variable_list *columns[MAX_OID_LEN];
+    agent_var_t *next;
+    int nb_columns = 0;
+    int repetition;
+    int i;
+
+    response = snmp_pdu_create(SNMP_MSG_RESPONSE);
+    response->reqid = request->reqid;
+    __sync_fetch_and_add(&agent_requests, 1);
+    if(request->command == SNMP_MSG_GET){
+        for(var=request->variables;var!=NULL;var=var->next_variable){
+            for(i=0;i<nb_vars;i++){
+                if(agent_oid_compare(var->name, var->name_length, mib[i].name, mib[i].name_length) == 0)break;
+            }
+            if(i < nb_vars)agent_add_mib_var(response, &mib[i]);
+            else agent_add_var(response, var->name, var->name_length, SNMP_NOSUCHINSTANCE, NULL, 0);
+        }
+        return response;
+    }
+
+    //The columns of a GETBULK are repeated errindex (max-repetitions) times
+    for(var=request->variables;var!=NULL && nb_columns<MAX_OID_LEN;var=var->next_variable)columns[nb_columns++] = var;
+    for(repetition=0;repetition<request->errindex;repetition++){
+        for(i=0;i<nb_columns;i++){
+            next = agent_next_var(columns[i]->name, columns[i]->name_length);
+            if(next == NULL){
+                agent_add_var(response, columns[i]->name, columns[i]->name_length, SNMP_ENDOFMIBVIEW, NULL, 0);
+                continue;
+            }
+            //The next repetition continues from the variable returned
+            columns[i] = agent_add_mib_var(response, next);
+        }
+    }
+    return response;
+}
+
+static int agent_dead(struct in_addr peer){
+    struct in_addr dead;
+
+    return agent_dead_peer != NULL && inet_aton(agent_dead_peer, &dead) && dead.s_addr == peer.s_addr;
+}
+
+void init_snmp(const char *type){
+}
+
+void snmp_sess_init(netsnmp_session *session){
+    memset(session, 0, sizeof(netsnmp_session));
+    session->version = SNMP_VERSION_2c;
+    session->retries = -1;
+    session->timeout = -1;
+}
+
+void * snmp_sess_open(netsnmp_session *session){
+    agent_session_t *s;
+
+    s = calloc(1, sizeof(agent_session_t));
+    if(s == NULL)return NULL;
+    if(pipe(s->pipe_fds) != 0){
+        free(s);
+        return NULL;
+    }
+    s->session = *session;
+    s->session.peername = NULL;
+    s->transport.sock = s->pipe_fds[0];
+    pthread_mutex_init(&s->lock, NULL);
+    __sync_fetch_and_add(&agent_sessions, 1);
+    return s;
+}
+
+int snmp_sess_close(void *handle){
+    agent_session_t *s = handle;
+    agent_request_t *request;
+
+    while((request = s->requests) != NULL){
+        s->requests = request->next;
+        snmp_free_pdu(request->pdu);
+        free(request);
+    }
+    close(s->pipe_fds[0]);
+    close(s->pipe_fds[1]);
+    pthread_mutex_destroy(&s->lock);
+    free(s);
+    __sync_fetch_and_sub(&agent_sessions, 1);
+    return 1;
+}
+
+netsnmp_session * snmp_sess_session(void *handle){
+    return &((agent_session_t *)handle)->session;
+}
+
+netsnmp_transport * snmp_sess_transport(void *handle){
+    return &((agent_session_t *)handle)->transport;
+}
+
+int snmp_sess_async_send(void *handle, netsnmp_pdu *pdu, netsnmp_callback callback, void *magic){
+    agent_session_t *s = handle;
+    agent_request_t *request;
+    netsnmp_indexed_addr_pair *addr_pair = pdu->transport_data;
+    char byte = 1;
+
+    if(addr_pair == NULL)return 0;
+    request = calloc(1, sizeof(agent_request_t));
+    if(request == NULL)return 0;
+    request->pdu = pdu;
+    request->callback = callback;
+    request->magic = magic;
+    request->deadline = agent_clock() + s->session.timeout/1000;
+    request->peer = addr_pair->remote_addr.sin.sin_addr;
+
+    pthread_mutex_lock(&s->lock);
+    request->next = s->requests;
+    s->requests = request;
+    pthread_mutex_unlock(&s->lock);
+    if(!agent_dead(request->peer) && write(s->pipe_fds[1], &byte, 1) != 1)return 0;
+    return (int)pdu->reqid;
+}
+
+int snmp_sess_read2(void *handle, netsnmp_large_fd_set *fdset){
+    agent_session_t *s = handle;
+    agent_request_t *requests;
+    agent_request_t *request;
+    netsnmp_pdu *response;
+    netsnmp_indexed_addr_pair *addr_pair;
+    char bytes[64];
+
+    if(!netsnmp_large_fd_is_set(s->transport.sock, fdset))return 0;
+    if(read(s->transport.sock, bytes, sizeof(bytes)) <= 0)return 0;
+
+    //The callbacks send the next requests, so the pending ones are taken first
+    pthread_mutex_lock(&s->lock);
+    requests = s->requests;
+    s->requests = NULL;
+    pthread_mutex_unlock(&s->lock);
+    while((request = requests) != NULL){
+        requests = request->next;
+        if(agent_dead(request->peer)){
+            pthread_mutex_lock(&s->lock);
+            request->next = s->requests;
+            s->requests = request;
+            pthread_mutex_unlock(&s->lock);
+            continue;
+        }
+        response = agent_answer(request->pdu);
+        addr_pair = calloc(1, sizeof(netsnmp_indexed_addr_pair));
+        addr_pair->remote_addr.sin.sin_family = AF_INET;
+        addr_pair->remote_addr.sin.sin_port = htons(SNMP_PORT);
+        addr_pair->remote_addr.sin.sin_addr = request->peer;
+        response->transport_data = addr_pair;
+        response->transport_data_length = sizeof(netsnmp_indexed_addr_pair);
+        request->callback(NETSNMP_CALLBACK_OP_RECEIVED_MESSAGE, &s->session, (int)request->pdu->reqid, response, request->magic);
+        snmp_free_pdu(response);
+        snmp_free_pdu(request->pdu);
+        free(request);
+    }
+    return 0;
+}
+
+void snmp_sess_timeout(void *handle){
+    agent_session_t *s = handle;
+    agent_request_t *expired = NULL;
+    agent_request_t **last;
+    agent_request_t *request;
+    long long now = agent_clock();
+
+    pthread_mutex_lock(&s->lock);
+    last = &s->requests;
+    while((request = *last) != NULL){
+        if(request->deadline <= now){
+            *last = request->next;
+            request->next = expired;
+            expired = request;
+        }else{
+            last = &request->next;
+        }
+    }
+    pthread_mutex_unlock(&s->lock);
+    while((request = expired) != NULL){
+        expired = request->next;
+        __sync_fetch_and_add(&agent_requests, 1);
+        request->callback(NETSNMP_CALLBACK_OP_TIMED_OUT, &s->session, (int)request->pdu->reqid, request->pdu, request->magic);
+        snmp_free_pdu(request->pdu);
+        free(request);
+    }
+}
+
+netsnmp_pdu * snmp_pdu_create(int command){
+    netsnmp_pdu *pdu;
+
+    pdu = calloc(1, sizeof(netsnmp_pdu));
+    if(pdu == NULL)return NULL;
+    pdu->command = command;
+    pdu->reqid = snmp_get_next_reqid();
+    return pdu;
+}
+
+netsnmp_pdu * snmp_clone_pdu(netsnmp_pdu *pdu){
+    netsnmp_pdu *clone;
+    netsnmp_variable_list *var;
+
+    clone = snmp_pdu_create(pdu->command);
+    if(clone == NULL)return NULL;
+    clone->reqid = pdu->reqid;
+    clone->version = pdu->version;
+    clone->errstat = pdu->errstat;
+    clone->errindex = pdu->errindex;
+    if(pdu->community != NULL){
+        clone->community = malloc(pdu->community_len+1);
+        memcpy(clone->community, pdu->community, pdu->community_len);
+        clone->community_len = pdu->community_len;
+    }
+    if(pdu->transport_data != NULL){
+        clone->transport_data = malloc(pdu->transport_data_length);
+        memcpy(clone->transport_data, pdu->transport_data, pdu->transport_data_length);
+        clone->transport_data_length = pdu->transport_data_length;
+    }
+    for(var=pdu->variables;var!=NULL;var=var->next_variable){
+        agent_add_var(clone, var->name, var->name_length, var->type, var->type == ASN_INTEGER ? (void *)var->val.integer : (void *)var->val.string, var->val_len);
+    }
+    return clone;
+}
+
+void snmp_free_pdu(netsnmp_pdu *pdu){
+    netsnmp_variable_list *var;
+
+    if(pdu == NULL)return;
+    while((var = pdu->variables) != NULL){
+        pdu->variables = var->next_variable;
+        if(var->type == ASN_INTEGER)free(var->val.integer);
+        if(var->type == ASN_OCTET_STR)free(var->val.string);
+        free(var);
+    }
+    free(pdu->community);
+    free(pdu->transport_data);
+    free(pdu);
+}
+
+netsnmp_variable_list * snmp_add_null_var(netsnmp_pdu *pdu, const oid *name, size_t name_length){
+    return agent_add_var(pdu, name, name_length, ASN_NULL, NULL, 0);
+}
+
+long snmp_get_next_reqid(void){
+    long reqid;
+
+    pthread_mutex_lock(&agent_lock);
+    reqid = next_reqid++;
+    pthread_mutex_unlock(&agent_lock);
+    return reqid;
+}
+
+const char * snmp_errstring(int errstat){
+    return "Agent error";
+}
+
+void netsnmp_large_fd_set_init(netsnmp_large_fd_set *fdset, int setsize){
+    fdset->lfs_setsize = setsize;
+    fdset->lfs_setptr = calloc(1, setsize/8+1);
+}
+
+void netsnmp_large_fd_set_cleanup(netsnmp_large_fd_set *fdset){
+    free(fdset->lfs_setptr);
+    fdset->lfs_setptr = NULL;
+    fdset->lfs_setsize = 0;
+}
+
+void netsnmp_large_fd_setfd(int fd, netsnmp_large_fd_set *fdset){
+    if(fd >= 0 && (unsigned)fd < fdset->lfs_setsize)fdset->lfs_setptr[fd/8] |= 1 << (fd%8);
+}
+
+void netsnmp_large_fd_clr(int fd, netsnmp_large_fd_set *fdset){
+    if(fd >= 0 && (unsigned)fd < fdset->lfs_setsize)fdset->lfs_setptr[fd/8] &= ~(1 << (fd%8));
+}
+
+int netsnmp_large_fd_is_set(int fd, netsnmp_large_fd_set *fdset){
+    return fd >= 0 && (unsigned)fd < fdset->lfs_setsize && (fdset->lfs_setptr[fd/8] >> (fd%8) & 1);
+}
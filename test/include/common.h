@@ -0,0 +1,11 @@
+/*
+ * Stub of the Zabbix headers needed to build the module in the tests,
+ * without the sources of Zabbix
+ */
+#ifndef TEST_COMMON_H
+#define TEST_COMMON_H
+
+#define SUCCEED 0
+#define FAIL -1
+
+#endif
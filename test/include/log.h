@@ -0,0 +1,19 @@
+/*
+ * Stub of the Zabbix headers needed to build the module in the tests,
+ * without the sources of Zabbix
+ */
+#ifndef TEST_LOG_H
+#define TEST_LOG_H
+
+#define LOG_LEVEL_EMPTY 0
+#define LOG_LEVEL_CRIT 1
+#define LOG_LEVEL_ERR 2
+#define LOG_LEVEL_WARNING 3
+#define LOG_LEVEL_DEBUG 4
+#define LOG_LEVEL_TRACE 5
+#define LOG_LEVEL_INFORMATION 127
+
+void __zbx_zabbix_log(int level, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+#define zabbix_log __zbx_zabbix_log
+
+#endif
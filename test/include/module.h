@@ -0,0 +1,67 @@
+/*
+ * Stub of the Zabbix headers needed to build the module in the tests,
+ * without the sources of Zabbix
+ */
+#ifndef TEST_MODULE_H
+#define TEST_MODULE_H
+
+#include "zbxtypes.h"
+
+#define ZBX_MODULE_OK 0
+#define ZBX_MODULE_FAIL -1
+#define ZBX_MODULE_API_VERSION_ONE 1
+#define ZBX_MODULE_API_VERSION 1
+
+#define SYSINFO_RET_OK 0
+#define SYSINFO_RET_FAIL 1
+
+#define CF_HAVEPARAMS 1
+
+typedef struct{
+    char *key;
+    int nparam;
+    char **params;
+    zbx_uint64_t lastlogsize;
+    int mtime;
+}AGENT_REQUEST;
+
+#define AR_UINT64 0x01
+#define AR_DOUBLE 0x02
+#define AR_STRING 0x04
+#define AR_TEXT 0x08
+#define AR_MESSAGE 0x20
+
+typedef struct{
+    int type;
+    zbx_uint64_t ui64;
+    double dbl;
+    char *str;
+    char *text;
+    char *msg;
+}AGENT_RESULT;
+
+typedef struct{
+    char *key;
+    unsigned flags;
+    int (*function)(AGENT_REQUEST *request, AGENT_RESULT *result);
+    char *test_param;
+}ZBX_METRIC;
+
+#define get_rparam(request, num) ((request)->nparam > (num) ? (request)->params[num] : NULL)
+
+#define SET_UI64_RESULT(res, val) ((res)->type |= AR_UINT64, (res)->ui64 = (zbx_uint64_t)(val))
+#define SET_DBL_RESULT(res, val) ((res)->type |= AR_DOUBLE, (res)->dbl = (double)(val))
+#define SET_STR_RESULT(res, val) ((res)->type |= AR_STRING, (res)->str = (char *)(val))
+#define SET_TEXT_RESULT(res, val) ((res)->type |= AR_TEXT, (res)->text = (char *)(val))
+#define SET_MSG_RESULT(res, val) ((res)->type |= AR_MESSAGE, (res)->msg = (char *)(val))
+
+#define ISSET_UI64(res) ((res)->type & AR_UINT64)
+#define ISSET_DBL(res) ((res)->type & AR_DOUBLE)
+#define ISSET_STR(res) ((res)->type & AR_STRING)
+#define ISSET_TEXT(res) ((res)->type & AR_TEXT)
+#define ISSET_MSG(res) ((res)->type & AR_MESSAGE)
+
+void init_result(AGENT_RESULT *result);
+void free_result(AGENT_RESULT *result);
+
+#endif
@@ -0,0 +1,4 @@
+/*
+ * Stub of the net-snmp headers needed to build the module in the tests,
+ * the functions are the ones of the stub agent of test/agent.c
+ */
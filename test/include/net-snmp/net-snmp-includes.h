@@ -0,0 +1,137 @@
+/*
+ * Stub of the net-snmp headers needed to build the module in the tests,
+ * the functions are the ones of the stub agent of test/agent.c
+ */
+#ifndef TEST_NET_SNMP_INCLUDES_H
+#define TEST_NET_SNMP_INCLUDES_H
+
+#include <sys/types.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+
+typedef unsigned long oid;
+typedef unsigned char u_char;
+typedef unsigned int u_int;
+typedef unsigned long u_long;
+typedef unsigned short u_short;
+
+#define MAX_OID_LEN 128
+
+#define SNMP_VERSION_1 0
+#define SNMP_VERSION_2c 1
+#define SNMP_PORT 161
+
+#define ASN_INTEGER 0x02
+#define ASN_OCTET_STR 0x04
+#define ASN_NULL 0x05
+#define ASN_OBJECT_ID 0x06
+#define ASN_COUNTER 0x41
+#define ASN_GAUGE 0x42
+#define ASN_TIMETICKS 0x43
+#define SNMP_NOSUCHOBJECT 0x80
+#define SNMP_NOSUCHINSTANCE 0x81
+#define SNMP_ENDOFMIBVIEW 0x82
+
+#define SNMP_MSG_GET 0xA0
+#define SNMP_MSG_GETNEXT 0xA1
+#define SNMP_MSG_RESPONSE 0xA2
+#define SNMP_MSG_GETBULK 0xA5
+#define SNMP_MSG_REPORT 0xA8
+
+#define SNMP_ERR_NOERROR 0
+
+#define STAT_SUCCESS 0
+#define STAT_ERROR 1
+#define STAT_TIMEOUT 2
+
+#define NETSNMP_CALLBACK_OP_RECEIVED_MESSAGE 1
+#define NETSNMP_CALLBACK_OP_TIMED_OUT 2
+
+typedef union{
+    long *integer;
+    u_char *string;
+    oid *objid;
+}netsnmp_vardata;
+
+typedef struct variable_list{
+    struct variable_list *next_variable;
+    oid *name;
+    size_t name_length;
+    u_char type;
+    netsnmp_vardata val;
+    size_t val_len;
+    oid name_loc[MAX_OID_LEN];
+}netsnmp_variable_list;
+
+typedef struct snmp_pdu{
+    long version;
+    int command;
+    long reqid;
+    long errstat;
+    long errindex;
+    void *transport_data;
+    int transport_data_length;
+    netsnmp_variable_list *variables;
+    u_char *community;
+    size_t community_len;
+}netsnmp_pdu;
+
+struct snmp_session;
+typedef int (*netsnmp_callback)(int operation, struct snmp_session *session, int reqid, netsnmp_pdu *pdu, void *magic);
+
+typedef struct snmp_session{
+    long version;
+    int retries;
+    long timeout;
+    char *peername;
+    u_char *community;
+    size_t community_len;
+}netsnmp_session;
+
+typedef union{
+    struct sockaddr sa;
+    struct sockaddr_in sin;
+}netsnmp_sockaddr_storage;
+
+typedef struct{
+    netsnmp_sockaddr_storage remote_addr;
+    netsnmp_sockaddr_storage local_addr;
+    int if_index;
+}netsnmp_indexed_addr_pair;
+
+typedef struct{
+    int sock;
+}netsnmp_transport;
+
+typedef struct{
+    unsigned lfs_setsize;
+    unsigned char *lfs_setptr;
+}netsnmp_large_fd_set;
+
+void netsnmp_large_fd_set_init(netsnmp_large_fd_set *fdset, int setsize);
+void netsnmp_large_fd_set_cleanup(netsnmp_large_fd_set *fdset);
+void netsnmp_large_fd_setfd(int fd, netsnmp_large_fd_set *fdset);
+void netsnmp_large_fd_clr(int fd, netsnmp_large_fd_set *fdset);
+int netsnmp_large_fd_is_set(int fd, netsnmp_large_fd_set *fdset);
+#define NETSNMP_LARGE_FD_SET(fd, fdset) netsnmp_large_fd_setfd(fd, fdset)
+#define NETSNMP_LARGE_FD_CLR(fd, fdset) netsnmp_large_fd_clr(fd, fdset)
+#define NETSNMP_LARGE_FD_ISSET(fd, fdset) netsnmp_large_fd_is_set(fd, fdset)
+
+void init_snmp(const char *type);
+void snmp_sess_init(netsnmp_session *session);
+void *snmp_sess_open(netsnmp_session *session);
+int snmp_sess_close(void *handle);
+netsnmp_session *snmp_sess_session(void *handle);
+netsnmp_transport *snmp_sess_transport(void *handle);
+int snmp_sess_async_send(void *handle, netsnmp_pdu *pdu, netsnmp_callback callback, void *magic);
+int snmp_sess_read2(void *handle, netsnmp_large_fd_set *fdset);
+void snmp_sess_timeout(void *handle);
+
+netsnmp_pdu *snmp_pdu_create(int command);
+netsnmp_pdu *snmp_clone_pdu(netsnmp_pdu *pdu);
+void snmp_free_pdu(netsnmp_pdu *pdu);
+netsnmp_variable_list *snmp_add_null_var(netsnmp_pdu *pdu, const oid *name, size_t name_length);
+long snmp_get_next_reqid(void);
+const char *snmp_errstring(int errstat);
+
+#endif
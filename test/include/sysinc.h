@@ -0,0 +1,20 @@
+/*
+ * Stub of the Zabbix headers needed to build the module in the tests,
+ * without the sources of Zabbix
+ */
+#ifndef TEST_SYSINC_H
+#define TEST_SYSINC_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#endif
@@ -0,0 +1,44 @@
+/*
+ * Stub of the Zabbix headers needed to build the module in the tests,
+ * without the sources of Zabbix
+ */
+#ifndef TEST_ZBXJSON_H
+#define TEST_ZBXJSON_H
+
+#include <stddef.h>
+#include "zbxtypes.h"
+
+#define ZBX_PROTO_TAG_DATA "data"
+#define ZBX_JSON_STAT_BUF_LEN 4096
+#define ZBX_JSON_MAX_LEVEL 32
+
+typedef enum{
+    ZBX_JSON_TYPE_UNKNOWN = 0,
+    ZBX_JSON_TYPE_STRING,
+    ZBX_JSON_TYPE_INT,
+    ZBX_JSON_TYPE_ARRAY,
+    ZBX_JSON_TYPE_OBJECT,
+    ZBX_JSON_TYPE_NULL,
+    ZBX_JSON_TYPE_TRUE,
+    ZBX_JSON_TYPE_FALSE
+}zbx_json_type_t;
+
+struct zbx_json{
+    char *buffer;
+    size_t buffer_allocated;
+    size_t buffer_offset;
+    size_t buffer_size;
+    int status;
+    int level;
+    char closers[ZBX_JSON_MAX_LEVEL];
+};
+
+void zbx_json_init(struct zbx_json *j, size_t allocate);
+void zbx_json_free(struct zbx_json *j);
+void zbx_json_addobject(struct zbx_json *j, const char *name);
+void zbx_json_addarray(struct zbx_json *j, const char *name);
+void zbx_json_addstring(struct zbx_json *j, const char *name, const char *string, zbx_json_type_t type);
+void zbx_json_adduint64(struct zbx_json *j, const char *name, zbx_uint64_t value);
+int zbx_json_close(struct zbx_json *j);
+
+#endif
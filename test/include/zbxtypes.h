@@ -0,0 +1,11 @@
+/*
+ * Stub of the Zabbix headers needed to build the module in the tests,
+ * without the sources of Zabbix
+ */
+#ifndef TEST_ZBXTYPES_H
+#define TEST_ZBXTYPES_H
+
+typedef unsigned long long zbx_uint64_t;
+#define ZBX_FS_UI64 "%llu"
+
+#endif
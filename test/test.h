@@ -0,0 +1,53 @@
+/*
+** Copyright (C) 2017 Romain CYRILLE
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+/*
+ * Helpers shared by the tests: the stub SNMP agent of agent.c and the stub
+ * Zabbix agent of zabbix.c, which calls the items of the module
+ */
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "module.h"
+
+/* the stub SNMP agent */
+extern const char *agent_dead_peer;
+extern int agent_requests;
+extern int agent_sessions;
+int agent_load(const char *path);
+void agent_set(const char *name, long value);
+
+/* the stub Zabbix agent */
+ZBX_METRIC * zbx_module_item_list(void);
+int zbx_module_init(void);
+int zbx_module_uninit(void);
+int test_call(const char *key, const char *params, AGENT_RESULT *result);
+char * test_result(AGENT_RESULT *result, int ret);
+
+#define TEST_CHECK(condition, ...) do{ \
+        if(!(condition)){ \
+            fprintf(stderr, "%s:%d: ", __FILE__, __LINE__); \
+            fprintf(stderr, __VA_ARGS__); \
+            fputc('\n', stderr); \
+            exit(1); \
+        } \
+    }while(0)
+
+#endif
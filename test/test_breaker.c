@@ -0,0 +1,127 @@
+/*
+** Copyright (C) 2017 Romain CYRILLE
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+/*
+ * Test of the circuit breaker of the devices
+ *
+ * The module is built with time renamed to test_time below, so the backoff
+ * delays are elapsed by moving the clock instead of waiting. The device
+ * polled is agent_dead_peer, which answers again once agent_dead_peer is
+ * cleared. The requests sent are counted by agent_requests.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "test.h"
+
+/* as in the module */
+#define BREAKER_THRESHOLD 3
+#define BREAKER_BACKOFF_MIN 30
+#define BREAKER_BACKOFF_MAX 600
+
+#define DEAD_PEER "10.0.0.99"
+#define IRF_OK "0 ui64 0"
+#define IRF_TIMEOUT "0 ui64 4"
+
+static time_t test_clock = 1500000000;
+
+time_t test_time(time_t *t){
+    time_t now = __sync_fetch_and_add(&test_clock, 0);
+
+    if(t != NULL)*t = now;
+    return now;
+}
+
+/* poll the device and return the number of requests sent */
+static int poll_device(const char *expected){
+    AGENT_RESULT result;
+    char *str;
+    int requests = agent_requests;
+    int ret;
+
+    ret = test_call("monitor.irf", DEAD_PEER ",public,2,0", &result);
+    str = test_result(&result, ret);
+    free_result(&result);
+    TEST_CHECK(strcmp(str, expected) == 0, "the poll returned \"%s\" instead of \"%s\"", str, expected);
+    free(str);
+    return agent_requests - requests;
+}
+
+static void check_skipped(const char *step){
+    TEST_CHECK(poll_device(IRF_TIMEOUT) == 0, "%s: a request is sent while the breaker is open", step);
+}
+
+static void check_probe(const char *step){
+    TEST_CHECK(poll_device(IRF_TIMEOUT) == 1, "%s: a single probe is not sent", step);
+}
+
+/* time out until the breaker opens */
+static void open_breaker(void){
+    int i;
+
+    for(i=0;i<BREAKER_THRESHOLD;i++){
+        TEST_CHECK(poll_device(IRF_TIMEOUT) > 0, "timeout %d: no request is sent before the breaker opens", i+1);
+    }
+    check_skipped("after the threshold");
+}
+
+int main(int argc, char **argv){
+    int backoff;
+
+    TEST_CHECK(agent_load(argc > 1 ? argv[1] : "switch.mib") == 0, "cannot load the MIB");
+    TEST_CHECK(zbx_module_init() == ZBX_MODULE_OK, "cannot init the module");
+    agent_dead_peer = DEAD_PEER;
+
+    //The breaker opens after BREAKER_THRESHOLD timeouts and the device is skipped until the backoff is elapsed
+    open_breaker();
+    test_clock += BREAKER_BACKOFF_MIN-1;
+    check_skipped("before the backoff");
+
+    //Then a single probe is sent, if it times out the backoff is doubled up to BREAKER_BACKOFF_MAX
+    for(backoff=BREAKER_BACKOFF_MIN;backoff<BREAKER_BACKOFF_MAX;){
+        test_clock += 1;
+        check_probe("after the backoff");
+        check_skipped("after the probe");
+        backoff = backoff*2 < BREAKER_BACKOFF_MAX ? backoff*2 : BREAKER_BACKOFF_MAX;
+        test_clock += backoff-1;
+        check_skipped("before the doubled backoff");
+    }
+    test_clock += 1;
+    check_probe("after the max backoff");
+    test_clock += BREAKER_BACKOFF_MAX-1;
+    check_skipped("before the max backoff");
+
+    //Once the device answers again it is still skipped until the probe, which closes the breaker
+    agent_dead_peer = NULL;
+    check_skipped("device back before the backoff");
+    test_clock += 1;
+    TEST_CHECK(poll_device(IRF_OK) > 1, "the probe is not followed by the poll");
+    TEST_CHECK(poll_device(IRF_OK) > 0, "no request is sent once the breaker is closed");
+
+    //A closed breaker starts again from BREAKER_BACKOFF_MIN
+    agent_dead_peer = DEAD_PEER;
+    open_breaker();
+    test_clock += BREAKER_BACKOFF_MIN;
+    check_probe("after the backoff of the breaker opened again");
+
+    zbx_module_uninit();
+    printf("test_breaker: OK\n");
+    return 0;
+}
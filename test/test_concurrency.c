@@ -0,0 +1,118 @@
+/*
+** Copyright (C) 2017 Romain CYRILLE
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+/*
+ * Concurrency test of the monitoring core
+ *
+ * The irf, lacp and rrpp items (and monitor.hp.all, which runs the three) are
+ * called by several threads at the same time against the same devices, so
+ * the threads share the devices, their caches, the arenas and the event
+ * loops of the module. Every result must be the one of a call made alone.
+ * Build it with CFLAGS=-fsanitize=thread to also check the data races.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "test.h"
+
+#define NB_THREADS 8
+#define NB_CALLS 200
+#define NB_DEVICES 6
+#define NB_ITEMS 4
+
+static const char *items[NB_ITEMS][2] = {
+    {"monitor.irf", "%s,public,2"},
+    {"monitor.lacp", "%s,public"},
+    {"monitor.rrpp", "%s,public"},
+    {"monitor.hp.all", "%s,public,2"}
+};
+
+static char *expected[NB_DEVICES][NB_ITEMS];
+static int nb_errors = 0;
+
+static char * call_item(int device, int item){
+    AGENT_RESULT result;
+    char ip_address[16];
+    char params[64];
+    char *str;
+    int ret;
+
+    snprintf(ip_address, sizeof(ip_address), "10.0.0.%d", device+1);
+    snprintf(params, sizeof(params), items[item][1], ip_address);
+    ret = test_call(items[item][0], params, &result);
+    str = test_result(&result, ret);
+    free_result(&result);
+    return str;
+}
+
+static void * run_thread(void *arg){
+    long thread = (long)arg;
+    int device;
+    int item;
+    char *str;
+    int i;
+
+    for(i=0;i<NB_CALLS;i++){
+        device = (thread+i) % NB_DEVICES;
+        item = (thread*3+i) % NB_ITEMS;
+        str = call_item(device, item);
+        if(strcmp(str, expected[device][item]) != 0){
+            fprintf(stderr, "thread %ld: %s of 10.0.0.%d returned \"%s\" instead of \"%s\"\n", thread, items[item][0], device+1, str, expected[device][item]);
+            __sync_fetch_and_add(&nb_errors, 1);
+        }
+        free(str);
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv){
+    pthread_t threads[NB_THREADS];
+    long thread;
+    int device;
+    int item;
+
+    TEST_CHECK(agent_load(argc > 1 ? argv[1] : "switch.mib") == 0, "cannot load the MIB");
+    TEST_CHECK(zbx_module_init() == ZBX_MODULE_OK, "cannot init the module");
+
+    //The results of the calls made alone
+    for(device=0;device<NB_DEVICES;device++){
+        for(item=0;item<NB_ITEMS;item++){
+            expected[device][item] = call_item(device, item);
+            TEST_CHECK(strncmp(expected[device][item], "0 ", 2) == 0, "%s failed: %s", items[item][0], expected[device][item]);
+        }
+    }
+
+    for(thread=0;thread<NB_THREADS;thread++){
+        TEST_CHECK(pthread_create(&threads[thread], NULL, run_thread, (void *)thread) == 0, "cannot create a thread");
+    }
+    for(thread=0;thread<NB_THREADS;thread++)pthread_join(threads[thread], NULL);
+    TEST_CHECK(nb_errors == 0, "%d calls returned another result", nb_errors);
+
+    //Every thread running a call at the same time keeps its event loop open until the module is unloaded
+    TEST_CHECK(agent_sessions <= NB_THREADS*4, "%d sessions are open for %d threads", agent_sessions, NB_THREADS);
+    zbx_module_uninit();
+    TEST_CHECK(agent_sessions == 0, "%d sessions are still open", agent_sessions);
+
+    for(device=0;device<NB_DEVICES;device++){
+        for(item=0;item<NB_ITEMS;item++)free(expected[device][item]);
+    }
+    printf("test_concurrency: %d threads x %d calls OK\n", NB_THREADS, NB_CALLS);
+    return 0;
+}
@@ -0,0 +1,162 @@
+/*
+** Copyright (C) 2017 Romain CYRILLE
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+/*
+ * Test of the flap detection
+ *
+ * The module is included so flap_table_update and flap_table_count can be
+ * called directly: the ring buffer wraps after FLAP_HISTORY_LEN transitions,
+ * a status older than the last one is ignored and a window counts the
+ * transitions since its start. Then monitor.lacp.flaps and
+ * monitor.rrpp.flaps are polled while the ports of switch.mib go up and
+ * down, with time renamed to test_time below so the cached status expires
+ * without waiting.
+ */
+
+#include "test.h"
+#include TEST_MODULE_SOURCE
+
+#define NB_KEYS 1000
+#define PORT_STATUS ".1.3.6.1.2.1.2.2.1.8."
+
+static time_t test_clock = 1500000000;
+
+time_t test_time(time_t *t){
+    time_t now = __sync_fetch_and_add(&test_clock, 0);
+
+    if(t != NULL)*t = now;
+    return now;
+}
+
+static void test_wrap(void){
+    flap_table_t *table = NULL;
+    int i;
+
+    TEST_CHECK(flap_table_update(1, PORT_UP, 100, &table) == SUCCEED, "cannot add the history");
+    TEST_CHECK(flap_table_count(1, 0, table) == 0, "the first status is counted as a transition");
+    for(i=1;i<=FLAP_HISTORY_LEN+8;i++){
+        TEST_CHECK(flap_table_update(1, i%2 ? PORT_DOWN : PORT_UP, 100+i, &table) == SUCCEED, "cannot update the history");
+    }
+    //Only the last FLAP_HISTORY_LEN transitions are kept, the newest ones
+    TEST_CHECK(flap_table_count(1, 0, table) == FLAP_HISTORY_LEN, "%d transitions kept instead of %d", flap_table_count(1, 0, table), FLAP_HISTORY_LEN);
+    TEST_CHECK(flap_table_count(1, 100+FLAP_HISTORY_LEN+8-9, table) == 10, "%d transitions in the last 10s instead of 10", flap_table_count(1, 100+FLAP_HISTORY_LEN+8-9, table));
+    TEST_CHECK(flap_table_count(1, 100+FLAP_HISTORY_LEN+9, table) == 0, "a transition is counted after the last one");
+    flap_table_free(table);
+}
+
+static void test_order(void){
+    flap_table_t *table = NULL;
+
+    flap_table_update(2, PORT_UP, 200, &table);
+    flap_table_update(2, PORT_DOWN, 210, &table);
+    TEST_CHECK(flap_table_count(2, 0, table) == 1, "the transition is not counted");
+
+    //An evaluation ending after a newer one is ignored
+    flap_table_update(2, PORT_UP, 205, &table);
+    TEST_CHECK(flap_table_count(2, 0, table) == 1, "an older status is counted as a transition");
+    TEST_CHECK(flap_table_exist(2, table)->status == PORT_DOWN, "an older status replaced the last one");
+
+    //The same status is not a transition, another one at the same time is
+    flap_table_update(2, PORT_DOWN, 210, &table);
+    TEST_CHECK(flap_table_count(2, 0, table) == 1, "the same status is counted as a transition");
+    flap_table_update(2, PORT_UP, 210, &table);
+    TEST_CHECK(flap_table_count(2, 0, table) == 2, "a status of the same time is ignored");
+    flap_table_free(table);
+}
+
+static void test_window(void){
+    flap_table_t *table = NULL;
+    unsigned long key;
+
+    TEST_CHECK(flap_table_count(3, 0, NULL) == 0, "an empty table has a transition");
+    flap_table_update(3, PORT_UP, 290, &table);
+    flap_table_update(3, PORT_DOWN, 300, &table);
+    flap_table_update(3, PORT_UP, 310, &table);
+    flap_table_update(3, PORT_DOWN, 320, &table);
+    TEST_CHECK(flap_table_count(3, 310, table) == 2, "the start of the window is not counted");
+    TEST_CHECK(flap_table_count(3, 311, table) == 1, "a transition before the window is counted");
+    TEST_CHECK(flap_table_count(4, 0, table) == 0, "an unknown key has a transition");
+
+    //The histories stay apart while the hash index grows
+    for(key=1000;key<1000+NB_KEYS;key++){
+        TEST_CHECK(flap_table_update(key, PORT_UP, 300, &table) == SUCCEED, "cannot add the history of %lu", key);
+        if(key%2)flap_table_update(key, PORT_DOWN, 310, &table);
+    }
+    for(key=1000;key<1000+NB_KEYS;key++){
+        TEST_CHECK(flap_table_count(key, 0, table) == (int)(key%2), "key %lu has %d transitions", key, flap_table_count(key, 0, table));
+    }
+    TEST_CHECK(flap_table_count(3, 0, table) == 3, "the first history is lost");
+    flap_table_free(table);
+}
+
+static zbx_uint64_t call_flaps(const char *key, long window){
+    AGENT_RESULT result;
+    char params[64];
+    char *str;
+    zbx_uint64_t nb;
+    int ret;
+
+    snprintf(params, sizeof(params), "10.0.0.1,public,%ld", window);
+    ret = test_call(key, params, &result);
+    str = test_result(&result, ret);
+    TEST_CHECK(ret == SYSINFO_RET_OK && ISSET_UI64(&result), "%s[%s] returned \"%s\"", key, params, str);
+    nb = result.ui64;
+    free(str);
+    free_result(&result);
+    return nb;
+}
+
+/* toggle a port every IF_STATUS_MAX_AGE and check the transitions counted by the item */
+static void test_item(const char *key, const char *port){
+    long window = IF_STATUS_MAX_AGE*(FLAP_HISTORY_LEN+20);
+    zbx_uint64_t nb;
+    int i;
+
+    TEST_CHECK(call_flaps(key, window) == 0, "%s: the first status is counted", key);
+    for(i=1;i<=FLAP_HISTORY_LEN+8;i++){
+        test_clock += IF_STATUS_MAX_AGE;
+        agent_set(port, i%2 ? 2 : 1);
+        nb = call_flaps(key, window);
+        TEST_CHECK(nb == (zbx_uint64_t)(i < FLAP_HISTORY_LEN ? i : FLAP_HISTORY_LEN), "%s: %llu transitions after %d", key, (unsigned long long)nb, i);
+    }
+    //The window only counts the last transitions
+    nb = call_flaps(key, IF_STATUS_MAX_AGE*3-1);
+    TEST_CHECK(nb == 3, "%s: %llu transitions in 3 polls", key, (unsigned long long)nb);
+
+    //No transition while the status is cached
+    agent_set(port, 2);
+    nb = call_flaps(key, window);
+    TEST_CHECK(nb == FLAP_HISTORY_LEN, "%s: %llu transitions with the cached status", key, (unsigned long long)nb);
+    agent_set(port, 1);
+    test_clock += IF_STATUS_MAX_AGE;
+}
+
+int main(void){
+    test_wrap();
+    test_order();
+    test_window();
+
+    TEST_CHECK(agent_load("switch.mib") == 0, "cannot load the MIB");
+    TEST_CHECK(zbx_module_init() == ZBX_MODULE_OK, "cannot init the module");
+    //The first port of Bridge-Aggregation1, which is also the primary port of the ring 1 of the domain 2
+    test_item("monitor.lacp.flaps", PORT_STATUS "1");
+    test_item("monitor.rrpp.flaps", PORT_STATUS "1");
+    zbx_module_uninit();
+    printf("test_flaps: OK\n");
+    return 0;
+}
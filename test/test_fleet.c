@@ -0,0 +1,110 @@
+/*
+** Copyright (C) 2017 Romain CYRILLE
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+/*
+ * Test of the list of devices of the fleet functions
+ *
+ * A file of devices is only read in the ZBXMODHP_FLEET_DIR directory, even
+ * through a link, and the tokens which are not IP addresses are dropped, so
+ * the content of another file can never be returned. The lines of a file
+ * are read whatever their length.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "test.h"
+
+static char * call_fleet(const char *hosts){
+    AGENT_RESULT result;
+    char params[4096];
+    char *str;
+    int ret;
+
+    snprintf(params, sizeof(params), "%s,public,2", hosts);
+    ret = test_call("monitor.fleet.irf", params, &result);
+    str = test_result(&result, ret);
+    free_result(&result);
+    return str;
+}
+
+static int count(const char *str, const char *pattern){
+    int nb = 0;
+
+    for(str=strstr(str, pattern);str!=NULL;str=strstr(str+1, pattern))nb++;
+    return nb;
+}
+
+static void check_refused(const char *hosts, const char *message){
+    char *str = call_fleet(hosts);
+
+    TEST_CHECK(strncmp(str, "1 msg ", 6) == 0 && strstr(str, message) != NULL, "%s returned \"%s\" instead of \"%s\"", hosts, str, message);
+    free(str);
+}
+
+int main(int argc, char **argv){
+    char dir[4096];
+    char path[4200];
+    char *str;
+
+    TEST_CHECK(agent_load(argc > 1 ? argv[1] : "switch.mib") == 0, "cannot load the MIB");
+    TEST_CHECK(getcwd(dir, sizeof(dir)) != NULL, "cannot get the directory");
+
+    //Without directory no file is read
+    unsetenv("ZBXMODHP_FLEET_DIR");
+    TEST_CHECK(zbx_module_init() == ZBX_MODULE_OK, "cannot init the module");
+    snprintf(path, sizeof(path), "%s/fleet.hosts", dir);
+    check_refused(path, "ZBXMODHP_FLEET_DIR is not set");
+    check_refused("/etc/passwd", "ZBXMODHP_FLEET_DIR is not set");
+    zbx_module_uninit();
+
+    setenv("ZBXMODHP_FLEET_DIR", dir, 1);
+    TEST_CHECK(zbx_module_init() == ZBX_MODULE_OK, "cannot init the module");
+
+    //The files out of the directory are refused, even through .. or a link
+    check_refused("/etc/passwd", "not in ZBXMODHP_FLEET_DIR");
+    snprintf(path, sizeof(path), "%s/../Makefile", dir);
+    check_refused(path, "not in ZBXMODHP_FLEET_DIR");
+    snprintf(path, sizeof(path), "%s/fleet.link", dir);
+    unlink(path);
+    TEST_CHECK(symlink("/etc/passwd", path) == 0, "cannot create %s", path);
+    check_refused(path, "not in ZBXMODHP_FLEET_DIR");
+    unlink(path);
+    snprintf(path, sizeof(path), "%s/fleet.missing", dir);
+    check_refused(path, "Cannot read the list of devices");
+
+    //Every address of the file is polled, the long line included, and the other tokens are dropped
+    snprintf(path, sizeof(path), "%s/fleet.hosts", dir);
+    str = call_fleet(path);
+    TEST_CHECK(strncmp(str, "0 str {", 7) == 0, "%s returned \"%s\"", path, str);
+    TEST_CHECK(count(str, "\"10.0.1.") == 41, "%d devices polled instead of 41: %s", count(str, "\"10.0.1."), str);
+    TEST_CHECK(strstr(str, "\"10.0.1.4\"") != NULL && strstr(str, "\"10.0.1.41\"") != NULL, "a device is missing: %s", str);
+    TEST_CHECK(strstr(str, "10.0.2.1") == NULL, "a comment is polled: %s", str);
+    TEST_CHECK(strstr(str, "secret") == NULL && strstr(str, "not-an-ip") == NULL && strstr(str, "Invalid IP") == NULL, "a token is returned: %s", str);
+    free(str);
+
+    //The same for a list given as parameter
+    str = call_fleet("10.0.0.1;secret 10.0.0.2");
+    TEST_CHECK(count(str, "\"10.0.0.") == 2 && strstr(str, "secret") == NULL, "the list returned \"%s\"", str);
+    free(str);
+
+    zbx_module_uninit();
+    printf("test_fleet: OK\n");
+    return 0;
+}
@@ -0,0 +1,104 @@
+/*
+** Copyright (C) 2017 Romain CYRILLE
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+/*
+ * Test of the numeric keys of the entities
+ *
+ * The values of monitor.irf.member, monitor.lacp.agg, monitor.rrpp.ring and
+ * of the count keys are checked against the state of switch.mib:
+ *   - the IRF members 1 and 2 have their two stack ports up
+ *   - Bridge-Aggregation1 (100) has its ports 1 and 2 up,
+ *     Bridge-Aggregation2 (101) has its port 3 down and
+ *     Bridge-Aggregation3 (102) has its single port 7 down
+ *   - the ring 1 of the domain 1 has its secondary port 6 down and the ring 1
+ *     of the domain 2 has its ports 1 and 2 up
+ * Every device caches its evaluation, so the MIB is changed before polling
+ * another device.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+
+#define IRF_PORT_STATUS ".1.3.6.1.4.1.25506.2.91.4.1.3."
+#define PORT_STATUS ".1.3.6.1.2.1.2.2.1.8."
+
+static void check(const char *key, const char *params, const char *expected){
+    AGENT_RESULT result;
+    char *str;
+    int ret;
+
+    ret = test_call(key, params, &result);
+    str = test_result(&result, ret);
+    free_result(&result);
+    TEST_CHECK(strcmp(str, expected) == 0, "%s[%s] returned \"%s\" instead of \"%s\"", key, params, str, expected);
+    free(str);
+}
+
+int main(int argc, char **argv){
+    TEST_CHECK(agent_load(argc > 1 ? argv[1] : "switch.mib") == 0, "cannot load the MIB");
+    TEST_CHECK(zbx_module_init() == ZBX_MODULE_OK, "cannot init the module");
+
+    //IRF_MEMBER_OK, IRF_MEMBER_PORT_DOWN, IRF_MEMBER_DOWN
+    check("monitor.irf.member", "10.0.0.1,public,1", "0 ui64 0");
+    check("monitor.irf.member", "10.0.0.1,public,2", "0 ui64 0");
+    check("monitor.irf.member", "10.0.0.1,public,3", "1 msg Unknown member");
+    agent_set(IRF_PORT_STATUS "1.1", 2);
+    check("monitor.irf.member", "10.0.0.2,public,1", "0 ui64 1");
+    check("monitor.irf.member", "10.0.0.2,public,2", "0 ui64 0");
+    agent_set(IRF_PORT_STATUS "1.2", 2);
+    check("monitor.irf.member", "10.0.0.3,public,1", "0 ui64 2");
+    agent_set(IRF_PORT_STATUS "1.1", 1);
+    agent_set(IRF_PORT_STATUS "1.2", 1);
+
+    //AGG_STATUS_OK, AGG_STATUS_LINK_DOWN, AGG_STATUS_DOWN
+    check("monitor.lacp.agg", "10.0.0.1,public,100", "0 ui64 0");
+    check("monitor.lacp.agg", "10.0.0.1,public,101", "0 ui64 1");
+    check("monitor.lacp.agg", "10.0.0.1,public,102", "0 ui64 2");
+    check("monitor.lacp.agg", "10.0.0.1,public,103", "1 msg Unknown aggregation");
+    check("monitor.lacp.count", "10.0.0.1,public,down", "0 ui64 1");
+    check("monitor.lacp.count", "10.0.0.1,public,degraded", "0 ui64 1");
+    check("monitor.lacp.count", "10.0.0.1,public,other", "1 msg Invalid state");
+    agent_set(PORT_STATUS "3", 1);
+    agent_set(PORT_STATUS "7", 1);
+    check("monitor.lacp.agg", "10.0.0.4,public,101", "0 ui64 0");
+    check("monitor.lacp.count", "10.0.0.4,public,down", "0 ui64 0");
+    check("monitor.lacp.count", "10.0.0.4,public,degraded", "0 ui64 0");
+    agent_set(PORT_STATUS "3", 2);
+    agent_set(PORT_STATUS "7", 2);
+
+    //RING_STATUS_OK, RING_STATUS_PRIMARY_DOWN, RING_STATUS_SECONDARY_DOWN, RING_STATUS_DOWN
+    check("monitor.rrpp.ring", "10.0.0.1,public,1,1", "0 ui64 2");
+    check("monitor.rrpp.ring", "10.0.0.1,public,2,1", "0 ui64 0");
+    check("monitor.rrpp.ring", "10.0.0.1,public,1,2", "1 msg Unknown ring");
+    check("monitor.rrpp.count", "10.0.0.1,public,down", "0 ui64 0");
+    check("monitor.rrpp.count", "10.0.0.1,public,degraded", "0 ui64 1");
+    agent_set(PORT_STATUS "5", 2);
+    agent_set(PORT_STATUS "1", 2);
+    check("monitor.rrpp.ring", "10.0.0.5,public,1,1", "0 ui64 3");
+    check("monitor.rrpp.ring", "10.0.0.5,public,2,1", "0 ui64 1");
+    check("monitor.rrpp.count", "10.0.0.5,public,down", "0 ui64 1");
+    check("monitor.rrpp.count", "10.0.0.5,public,degraded", "0 ui64 1");
+    agent_set(PORT_STATUS "5", 1);
+    agent_set(PORT_STATUS "1", 1);
+
+    zbx_module_uninit();
+    printf("test_keys: OK\n");
+    return 0;
+}
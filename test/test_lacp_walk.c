@@ -0,0 +1,117 @@
+/*
+** Copyright (C) 2017 Romain CYRILLE
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+/*
+ * Test of the incremental walk of the aggregations
+ *
+ * The device has several pages of aggregations and of ports, so a walk
+ * limited to a request per call takes several calls. Until the first walk is
+ * complete the aggregations are not known, so the items fail instead of
+ * returning that everything is OK, and a single request is sent per call.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "test.h"
+
+#define NB_AGG 300
+#define AGG_INDEX 1000
+#define MAX_CALLS 20
+
+static const char *in_progress = "1 msg Aggregation walk in progress";
+
+/* two ports per aggregation, the first port of the first aggregation is down */
+static void write_mib(const char *path){
+    FILE *file = fopen(path, "w");
+    int i;
+
+    TEST_CHECK(file != NULL, "cannot create %s", path);
+    for(i=0;i<NB_AGG;i++){
+        fprintf(file, ".1.2.840.10006.300.43.1.1.2.1.1.%d i 5\n", AGG_INDEX+i);
+        fprintf(file, ".1.3.6.1.2.1.2.2.1.2.%d s Bridge-Aggregation%d\n", AGG_INDEX+i, i+1);
+        fprintf(file, ".1.3.6.1.2.1.2.2.1.8.%d i 1\n", AGG_INDEX+i);
+    }
+    for(i=1;i<=NB_AGG*2;i++){
+        fprintf(file, ".1.2.840.10006.300.43.1.2.1.1.13.%d i %d\n", i, AGG_INDEX+(i-1)/2);
+        fprintf(file, ".1.3.6.1.2.1.2.2.1.2.%d s GigabitEthernet1/0/%d\n", i, i);
+        fprintf(file, ".1.3.6.1.2.1.2.2.1.8.%d i %d\n", i, i == 1 ? 2 : 1);
+    }
+    fclose(file);
+}
+
+static char * call(const char *key, const char *params){
+    AGENT_RESULT result;
+    char *str;
+    int ret;
+
+    ret = test_call(key, params, &result);
+    str = test_result(&result, ret);
+    free_result(&result);
+    return str;
+}
+
+int main(void){
+    char path[] = "/tmp/test_lacp_walk.XXXXXX";
+    char *str;
+    int fd;
+    int requests;
+    int nb_calls;
+
+    fd = mkstemp(path);
+    TEST_CHECK(fd >= 0, "cannot create the MIB");
+    close(fd);
+    write_mib(path);
+    TEST_CHECK(agent_load(path) == 0, "cannot load the MIB");
+    unlink(path);
+    TEST_CHECK(zbx_module_init() == ZBX_MODULE_OK, "cannot init the module");
+
+    //A request per call: the item fails until the first walk is complete
+    for(nb_calls=1;nb_calls<=MAX_CALLS;nb_calls++){
+        requests = agent_requests;
+        str = call("monitor.lacp", "10.0.0.1,public,,,1");
+        if(strcmp(str, in_progress) != 0)break;
+        TEST_CHECK(agent_requests - requests == 1, "call %d sent %d requests instead of 1", nb_calls, agent_requests - requests);
+        free(str);
+    }
+    TEST_CHECK(nb_calls > 2, "the walk is complete after %d calls, the device has too few aggregations", nb_calls);
+    TEST_CHECK(nb_calls <= MAX_CALLS, "the walk is not complete after %d calls", MAX_CALLS);
+    TEST_CHECK(strncmp(str, "0 str ", 6) == 0 && strstr(str, "Bridge-Aggregation1") != NULL, "call %d returned \"%s\" instead of the aggregation down", nb_calls, str);
+    TEST_CHECK(strstr(str, "Bridge-Aggregation2") == NULL, "call %d returned an aggregation up: \"%s\"", nb_calls, str);
+    free(str);
+
+    //Once the aggregations are known, the previous walk is used while a new one is in progress
+    str = call("monitor.lacp", "10.0.0.1,public,,,1");
+    TEST_CHECK(strncmp(str, "0 str ", 6) == 0 && strstr(str, "Bridge-Aggregation1") != NULL, "the next call returned \"%s\"", str);
+    free(str);
+
+    //The same for the fingerprint of another device
+    str = call("monitor.lacp.fingerprint", "10.0.0.2,public,,,1");
+    TEST_CHECK(strcmp(str, in_progress) == 0, "the fingerprint returned \"%s\" during the first walk", str);
+    free(str);
+
+    //Without limit the walk is done by the first call
+    str = call("monitor.lacp", "10.0.0.3,public");
+    TEST_CHECK(strncmp(str, "0 str ", 6) == 0 && strstr(str, "Bridge-Aggregation1") != NULL, "a whole walk returned \"%s\"", str);
+    free(str);
+
+    zbx_module_uninit();
+    printf("test_lacp_walk: OK\n");
+    return 0;
+}
@@ -0,0 +1,116 @@
+/*
+** Copyright (C) 2017 Romain CYRILLE
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+/*
+ * Allocation test of the monitoring core
+ *
+ * The module is built with malloc, calloc, realloc and strdup renamed to the
+ * counting functions below, so only its own allocations are counted, not the
+ * ones of net-snmp nor of Zabbix. Once the arenas, the event loops and the
+ * caches of the devices are warm, a call must only allocate:
+ *   - the community and the transport address of every request, as they are
+ *     owned by the PDU and freed by net-snmp with it
+ *   - the strings of its result (and of the results of monitor.hp.all), as
+ *     they are freed by Zabbix
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+
+#define NB_WARMUP_CALLS 3
+#define NB_CALLS 100
+
+#define PDU_ALLOCS 2
+
+/* the key, the parameters and the number of strings of the result */
+static const struct{
+    const char *key;
+    const char *params;
+    int results;
+}items[] = {
+    {"monitor.irf", "10.0.0.1,public,2", 0},
+    {"monitor.lacp", "10.0.0.1,public", 1},
+    {"monitor.rrpp", "10.0.0.1,public", 1},
+    {"monitor.hp.all", "10.0.0.1,public,2", 3},
+    {"monitor.irf", "10.0.0.2,public,2", 0},
+    {"monitor.lacp", "10.0.0.2,public", 1},
+    {"monitor.rrpp", "10.0.0.2,public", 1},
+    {NULL, NULL, 0}
+};
+
+static long nb_allocs = 0;
+
+void * counted_malloc(size_t size){
+    __sync_fetch_and_add(&nb_allocs, 1);
+    return malloc(size);
+}
+
+void * counted_calloc(size_t nmemb, size_t size){
+    __sync_fetch_and_add(&nb_allocs, 1);
+    return calloc(nmemb, size);
+}
+
+void * counted_realloc(void *ptr, size_t size){
+    __sync_fetch_and_add(&nb_allocs, 1);
+    return realloc(ptr, size);
+}
+
+char * counted_strdup(const char *str){
+    __sync_fetch_and_add(&nb_allocs, 1);
+    return strdup(str);
+}
+
+static void call_item(int item, long *allocs, int *requests){
+    AGENT_RESULT result;
+    int ret;
+
+    *allocs = nb_allocs;
+    *requests = agent_requests;
+    ret = test_call(items[item].key, items[item].params, &result);
+    TEST_CHECK(ret == SYSINFO_RET_OK, "%s %s failed", items[item].key, items[item].params);
+    free_result(&result);
+    *allocs = nb_allocs - *allocs;
+    *requests = agent_requests - *requests;
+}
+
+int main(int argc, char **argv){
+    long allocs;
+    int requests;
+    int item;
+    int i;
+
+    TEST_CHECK(agent_load(argc > 1 ? argv[1] : "switch.mib") == 0, "cannot load the MIB");
+    TEST_CHECK(zbx_module_init() == ZBX_MODULE_OK, "cannot init the module");
+
+    for(item=0;items[item].key!=NULL;item++){
+        for(i=0;i<NB_WARMUP_CALLS;i++)call_item(item, &allocs, &requests);
+    }
+    for(item=0;items[item].key!=NULL;item++){
+        for(i=0;i<NB_CALLS;i++){
+            call_item(item, &allocs, &requests);
+            TEST_CHECK(requests > 0, "%s %s sent no request", items[item].key, items[item].params);
+            TEST_CHECK(allocs == PDU_ALLOCS*requests + items[item].results, "%s %s made %ld allocations for %d requests instead of %d", items[item].key, items[item].params, allocs, requests, PDU_ALLOCS*requests + items[item].results);
+        }
+    }
+
+    zbx_module_uninit();
+    printf("test_malloc: %d calls of %d items OK\n", NB_CALLS, item);
+    return 0;
+}
@@ -0,0 +1,223 @@
+/*
+** Copyright (C) 2017 Romain CYRILLE
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**/
+
+/*
+ * Stub Zabbix agent of the tests
+ *
+ * It implements the functions of Zabbix used by the module (the results,
+ * the JSON builder and the log) and calls the items of the module by key.
+ * The log is printed on stderr when the TEST_LOG environment variable is set.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <pthread.h>
+#include "module.h"
+#include "zbxjson.h"
+#include "test.h"
+
+#define TEST_MAX_PARAMS 16
+#define TEST_MAX_PARAMS_LEN 4096
+
+/* the list of the items is only asked once to the module, as Zabbix does when loading it */
+static ZBX_METRIC *metrics = NULL;
+static pthread_once_t metrics_once = PTHREAD_ONCE_INIT;
+
+static void test_load_metrics(void){
+    metrics = zbx_module_item_list();
+}
+
+void init_result(AGENT_RESULT *result){
+    memset(result, 0, sizeof(AGENT_RESULT));
+}
+
+void free_result(AGENT_RESULT *result){
+    free(result->str);
+    free(result->text);
+    free(result->msg);
+    memset(result, 0, sizeof(AGENT_RESULT));
+}
+
+void __zbx_zabbix_log(int level, const char *fmt, ...){
+    va_list args;
+
+    if(getenv("TEST_LOG") == NULL)return;
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    fputc('\n', stderr);
+    va_end(args);
+}
+
+static void json_append(struct zbx_json *j, const char *str, size_t len){
+    //The closing characters of the open objects and arrays stay at the end of the buffer
+    if(j->buffer_offset+len+j->level+1 > j->buffer_allocated){
+        j->buffer_allocated = (j->buffer_offset+len+j->level+1)*2;
+        j->buffer = realloc(j->buffer, j->buffer_allocated);
+    }
+    memcpy(j->buffer+j->buffer_offset, str, len);
+    j->buffer_offset += len;
+}
+
+static void json_terminate(struct zbx_json *j){
+    int i;
+
+    for(i=0;i<j->level;i++)j->buffer[j->buffer_offset+i] = j->closers[j->level-1-i];
+    j->buffer[j->buffer_offset+j->level] = '\0';
+    j->buffer_size = j->buffer_offset+j->level;
+}
+
+static void json_name(struct zbx_json *j, const char *name){
+    if(j->status)json_append(j, ",", 1);
+    if(name == NULL)return;
+    json_append(j, "\"", 1);
+    json_append(j, name, strlen(name));
+    json_append(j, "\":", 2);
+}
+
+static void json_open(struct zbx_json *j, const char *name, char opener, char closer){
+    json_name(j, name);
+    json_append(j, &opener, 1);
+    j->closers[j->level++] = closer;
+    j->status = 0;
+    json_terminate(j);
+}
+
+void zbx_json_init(struct zbx_json *j, size_t allocate){
+    memset(j, 0, sizeof(struct zbx_json));
+    json_open(j, NULL, '{', '}');
+}
+
+void zbx_json_free(struct zbx_json *j){
+    free(j->buffer);
+    j->buffer = NULL;
+}
+
+void zbx_json_addobject(struct zbx_json *j, const char *name){
+    json_open(j, name, '{', '}');
+}
+
+void zbx_json_addarray(struct zbx_json *j, const char *name){
+    json_open(j, name, '[', ']');
+}
+
+void zbx_json_addstring(struct zbx_json *j, const char *name, const char *string, zbx_json_type_t type){
+    const char *c;
+
+    json_name(j, name);
+    if(string == NULL){
+        json_append(j, "null", 4);
+    }else if(type == ZBX_JSON_TYPE_STRING){
+        json_append(j, "\"", 1);
+        for(c=string;*c!='\0';c++){
+            if(*c == '"' || *c == '\\')json_append(j, "\\", 1);
+            json_append(j, c, 1);
+        }
+        json_append(j, "\"", 1);
+    }else{
+        json_append(j, string, strlen(string));
+    }
+    j->status = 1;
+    json_terminate(j);
+}
+
+void zbx_json_adduint64(struct zbx_json *j, const char *name, zbx_uint64_t value){
+    char buf[21];
+
+    snprintf(buf, sizeof(buf), "%llu", value);
+    zbx_json_addstring(j, name, buf, ZBX_JSON_TYPE_INT);
+}
+
+int zbx_json_close(struct zbx_json *j){
+    if(j->level <= 1)return -1;
+    j->level--;
+    json_append(j, &j->closers[j->level], 1);
+    j->status = 1;
+    json_terminate(j);
+    return 0;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: test_call                                                        *
+ *                                                                            *
+ * Purpose: Call an item of the module as the Zabbix agent does               *
+ *                                                                            *
+ * Parameters: key - the key of the item                                      *
+ *             params - its parameters separated by commas                    *
+ *             result - the result of the item, to free with free_result      *
+ *                                                                            *
+ * Return value: the value returned by the item                               *
+ *               -1 if the key is not known by the module                     *
+ *                                                                            *
+ ******************************************************************************/
+int test_call(const char *key, const char *params, AGENT_RESULT *result){
+    AGENT_REQUEST request;
+    ZBX_METRIC *metric;
+    char buf[TEST_MAX_PARAMS_LEN];
+    char *param[TEST_MAX_PARAMS];
+    char *next;
+    char *comma;
+
+    init_result(result);
+    pthread_once(&metrics_once, test_load_metrics);
+    for(metric=metrics;metric->key!=NULL;metric++){
+        if(strcmp(metric->key, key) == 0)break;
+    }
+    if(metric->key == NULL)return -1;
+
+    memset(&request, 0, sizeof(request));
+    request.key = (char *)key;
+    request.params = param;
+    snprintf(buf, sizeof(buf), "%s", params);
+    next = buf;
+    while(*params != '\0' && next != NULL && request.nparam < TEST_MAX_PARAMS){
+        comma = strchr(next, ',');
+        if(comma != NULL)*comma++ = '\0';
+        param[request.nparam++] = next;
+        next = comma;
+    }
+    return metric->function(&request, result);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: test_result                                                      *
+ *                                                                            *
+ * Purpose: Format the result of an item to compare it                        *
+ *                                                                            *
+ * Parameters: result - the result of the item                                *
+ *             ret - the value returned by the item                           *
+ *                                                                            *
+ * Return value: the value returned, the type and the value of the result,    *
+ *               to free                                                      *
+ *                                                                            *
+ ******************************************************************************/
+char * test_result(AGENT_RESULT *result, int ret){
+    char *str;
+    size_t size;
+
+    size = 64 + (result->str != NULL ? strlen(result->str) : 0) + (result->msg != NULL ? strlen(result->msg) : 0);
+    str = malloc(size);
+    if(ISSET_UI64(result))snprintf(str, size, "%d ui64 %llu", ret, result->ui64);
+    else if(ISSET_STR(result))snprintf(str, size, "%d str %s", ret, result->str);
+    else if(ISSET_MSG(result))snprintf(str, size, "%d msg %s", ret, result->msg);
+    else snprintf(str, size, "%d none", ret);
+    return str;
+}
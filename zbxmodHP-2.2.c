@@ -21,23 +21,41 @@
 #include "zbxtypes.h"
 #include "common.h"
 #include "log.h"
+#include "zbxjson.h"
 #include <net-snmp/net-snmp-config.h>
 #include <net-snmp/net-snmp-includes.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <string.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/time.h>
+#include <arpa/inet.h>
+#include <limits.h>
 
 #define MAX_IRF_SWITCHES 10
-#define MAX_PORT_AGG 16
 #define MAX_BULK_REPETITION 128
-#define MAX_CHAR_RESULT 500
+#define MAX_GET_VARS 32
+#define MAX_WALK_COLUMNS 4
+#define MAX_WALK_INDEX 2
+#define MAX_WALK_OID_LEN 32
+#define ARENA_SIZE 16384
+#define ARENA_ALIGN 16
 #define INADDRS 4
 #define STAT_ERR_INIT 5
 #define AGG_STATUS_OK 0
 #define AGG_STATUS_LINK_DOWN 1
 #define AGG_STATUS_DOWN 2
 #define AGG_STATUS_UNKNOWN 3
+#define RING_STATUS_OK 0
+#define RING_STATUS_PRIMARY_DOWN 1
+#define RING_STATUS_SECONDARY_DOWN 2
+#define RING_STATUS_DOWN 3
+#define IRF_MEMBER_OK 0
+#define IRF_MEMBER_PORT_DOWN 1
+#define IRF_MEMBER_DOWN 2
 #define RRPP_PRIMARY_PORT 1
 #define RRPP_SECONDARY_PORT 2
 #define RRPP_UNKNOWN 0
@@ -45,6 +63,83 @@
 #define RRPP_DISABLE 2
 #define PORT_UP 1
 #define PORT_DOWN 2
+#define PORT_UNKNOWN 0
+#define IF_STATUS_MAX_AGE 10
+#define AGG_TOPOLOGY_MAX_AGE 300
+#define IP_ADDRESS_LEN 16
+#define BREAKER_CLOSED 0
+#define BREAKER_OPEN 1
+#define BREAKER_HALF_OPEN 2
+#define BREAKER_THRESHOLD 3
+#define BREAKER_BACKOFF_MIN 30
+#define BREAKER_BACKOFF_MAX 600
+#define MAX_FLEET_PARAMS 8
+#define LACP_WALK_AGG_LIST 0
+#define LACP_WALK_ATTACHED_ID 1
+#define LACP_WALK_DONE 2
+#define MONITOR_IRF 0
+#define MONITOR_LACP 1
+#define MONITOR_RRPP 2
+#define MONITOR_TYPES 3
+#define MONITOR_PHASE_START 0
+#define MONITOR_PHASE_PROBE 1
+#define MONITOR_PHASE_DONE 2
+#define MONITOR_MODE_STATUS 0
+#define MONITOR_MODE_DISCOVERY 1
+#define MONITOR_MODE_ENTITY 2
+#define MONITOR_MODE_COUNT 3
+#define COUNT_STATE_DOWN 0
+#define COUNT_STATE_DEGRADED 1
+#define MONITOR_MODE_FLAPS 4
+#define FLAP_HISTORY_LEN 32
+#define IRF_PHASE_STACK 3
+#define IRF_PHASE_RESULT 4
+#define LACP_PHASE_WALK 3
+#define LACP_PHASE_PORT_STATUS 4
+#define LACP_PHASE_IF_DESC 5
+#define LACP_PHASE_DISCOVERY 6
+#define LACP_PHASE_AGG 7
+#define RRPP_PHASE_ENABLE 3
+#define RRPP_PHASE_RINGS 4
+#define RRPP_PHASE_PORT_STATUS 5
+#define RRPP_PHASE_RESULT 6
+#define MAX_LOOP_SOCKETS 4
+#define MAX_LOOP_EVENTS 64
+#define STATS_PDU_GET 0
+#define STATS_PDU_GETNEXT 1
+#define STATS_PDU_GETBULK 2
+#define STATS_PDU_RESPONSE 3
+#define STATS_PDU_REPORT 4
+#define STATS_PDU_OTHER 5
+#define STATS_PDU_TYPES 6
+#define STATS_CACHE_IF_STATUS 0
+#define STATS_CACHE_AGG 1
+#define STATS_CACHE_RRPP 2
+#define STATS_CACHE_IRF 3
+#define STATS_CACHES 4
+#define STATS_LATENCY_BUCKETS 64
+#define TRACE_PHASES 9
+#define TRACE_PHASE_ATTACHED_ID 8
+#ifndef MAX_RESULT_LEN
+#define MAX_RESULT_LEN 65535
+#endif
+/* the default duration in milliseconds of a monitoring logged with its phases, 0 disables the tracing of the phases */
+/* it is replaced at the init of the module by the ZBXMODHP_TRACE_THRESHOLD_MS environment variable if it is set */
+#ifndef TRACE_THRESHOLD
+#define TRACE_THRESHOLD 0
+#endif
+/* the number of monitorings running at the same time in an event loop, the next ones wait for one to finish */
+#ifndef MAX_LOOP_MONITORS
+#define MAX_LOOP_MONITORS 1024
+#endif
+/* the number of the last SNMP exchanges kept by every device */
+#ifndef FLIGHT_RECORDER_LEN
+#define FLIGHT_RECORDER_LEN 32
+#endif
+/* the max size of the block kept by an arena of the pool, the calls needing more allocate the rest with malloc */
+#ifndef ARENA_MAX_SIZE
+#define ARENA_MAX_SIZE 1048576
+#endif
 
 /* the variable keeps timeout setting for item processing */
 static int	item_timeout = 30;
@@ -52,62 +147,614 @@ static int	item_timeout = 30;
 /* module SHOULD define internal functions as static and use a naming pattern different from Zabbix internal */
 /* symbols (zbx_*) and loadable module API functions (zbx_module_*) to avoid conflicts                       */
 static int	irf_monitoring(AGENT_REQUEST *request, AGENT_RESULT *result);
+static int	irf_discovery(AGENT_REQUEST *request, AGENT_RESULT *result);
+static int	irf_member_monitoring(AGENT_REQUEST *request, AGENT_RESULT *result);
 static int	lacp_monitoring(AGENT_REQUEST *request, AGENT_RESULT *result);
+static int	lacp_discovery(AGENT_REQUEST *request, AGENT_RESULT *result);
+static int	lacp_agg_monitoring(AGENT_REQUEST *request, AGENT_RESULT *result);
+static int	lacp_count_monitoring(AGENT_REQUEST *request, AGENT_RESULT *result);
+static int	lacp_flaps_monitoring(AGENT_REQUEST *request, AGENT_RESULT *result);
 static int	rrpp_monitoring(AGENT_REQUEST *request, AGENT_RESULT *result);
+static int	rrpp_discovery(AGENT_REQUEST *request, AGENT_RESULT *result);
+static int	rrpp_ring_monitoring(AGENT_REQUEST *request, AGENT_RESULT *result);
+static int	rrpp_count_monitoring(AGENT_REQUEST *request, AGENT_RESULT *result);
+static int	rrpp_flaps_monitoring(AGENT_REQUEST *request, AGENT_RESULT *result);
+static int	irf_fleet_monitoring(AGENT_REQUEST *request, AGENT_RESULT *result);
+static int	lacp_fleet_monitoring(AGENT_REQUEST *request, AGENT_RESULT *result);
+static int	rrpp_fleet_monitoring(AGENT_REQUEST *request, AGENT_RESULT *result);
+static int	hp_all_monitoring(AGENT_REQUEST *request, AGENT_RESULT *result);
+static int	lacp_fingerprint(AGENT_REQUEST *request, AGENT_RESULT *result);
+static int	lacp_changes(AGENT_REQUEST *request, AGENT_RESULT *result);
+static int	rrpp_fingerprint(AGENT_REQUEST *request, AGENT_RESULT *result);
+static int	rrpp_changes(AGENT_REQUEST *request, AGENT_RESULT *result);
+static int	module_stats(AGENT_REQUEST *request, AGENT_RESULT *result);
+static int	stats_item(AGENT_REQUEST *request, AGENT_RESULT *result);
+static int	module_trace(AGENT_REQUEST *request, AGENT_RESULT *result);
+static int	module_recorder(AGENT_REQUEST *request, AGENT_RESULT *result);
 static int is_valid_ip(const char *src);
-char* itoa(int i, char b[]);
-static int snmpbulkget(struct snmp_session session, struct snmp_pdu ** response, oid id_oid[MAX_OID_LEN], size_t id_len,int max_repetition);
-static int snmpget(struct snmp_session session, struct snmp_pdu ** response,oid id_oid[MAX_OID_LEN], size_t id_len);
 
-/*  This structure, that is a list, is used by the lacp_monitoring function to represent a list of Aggregation*/
+/*  This structure, that is a list, is used to allocate the transient data of a call*/
+/*  Everything is freed at once when the arena is released, then the arena is kept in a pool for the next calls*/
+struct arena_struct{
+    struct arena_struct * next;
+    char * base;
+    size_t size;
+    size_t used;
+    void * overflow;
+    size_t overflow_size;
+};
+typedef struct arena_struct arena_t;
+static arena_t * arena_acquire(void);
+static void arena_release(arena_t *arena);
+static void arena_pool_free(void);
+static void * arena_alloc(arena_t *arena, size_t size);
+static void * arena_realloc(arena_t *arena, void *ptr, size_t old_size, size_t size);
+static char * arena_strdup(arena_t *arena, const char *str);
+static void arena_free(arena_t *arena, void *ptr);
+static int table_slot(unsigned long key, int nb_slots);
+
+/* the pool keeps the arenas released by the previous calls */
+static arena_t *arenas = NULL;
+static pthread_mutex_t arenas_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*  This structure is used by the lacp and rrpp monitoring functions to keep the ifOperStatus of all the interfaces of a switch*/
+/*  The interfaces are numbered by increasing ifIndex, their bit is set in present if their status is known and in up if it is up*/
+struct if_status_struct{
+    long * ifindex;
+    zbx_uint64_t * up;
+    zbx_uint64_t * present;
+    int nb_ifs;
+    int max_ifs;
+    time_t time;
+};
+typedef struct if_status_struct if_status_t;
+static void if_status_new(if_status_t ** status, arena_t *arena);
+static void if_status_free(if_status_t *status, arena_t *arena);
+static int if_status_add(long ifindex, long oper_status, if_status_t *status, arena_t *arena);
+static int if_status_find(long ifindex, if_status_t *status);
+static short if_status_get(long ifindex, if_status_t *status);
+static int if_status_count_down(zbx_uint64_t *mask, if_status_t *status);
+static if_status_t * if_status_copy(if_status_t *status, arena_t *arena);
+static int if_status_assign(if_status_t **copy, if_status_t *status);
+
+/*  This structure is used by the lacp_monitoring function to represent an Aggregation*/
 struct agg_struct{
-    struct agg_struct * next;
     long index;
-    long ports[MAX_PORT_AGG];
+    int first_port;
     int nb_ports;
     short status;
 };
 typedef struct agg_struct agg_struct_t;
-static void agg_struct_new(agg_struct_t ** agg);
-static void agg_struct_free(agg_struct_t *agg);
 static void agg_struct_init(long index, agg_struct_t *agg);
-static agg_struct_t * agg_struct_exist(long index,agg_struct_t * agg);
-static agg_struct_t * agg_struct_add(long index, agg_struct_t ** agg);
-static void agg_struct_add_port(long port_index,agg_struct_t *agg);
+
+/*  This structure is used by the lacp_monitoring function to keep a port attached to an Aggregation during the walk*/
+struct agg_port_struct{
+    long port;
+    int agg;
+};
+typedef struct agg_port_struct agg_port_struct_t;
+
+/*  This structure is used by the lacp_monitoring function to represent the Aggregations of a switch*/
+/*  They are stored in an array in the order of the walk, and indexed by their ifIndex in an open-addressing hash table*/
+/*  The ports of all the Aggregations are stored in a single array, grouped by Aggregation at the end of the walk*/
+/*  The arrays are kept when the table is reset, so a table can be reused by the next walk*/
+struct agg_table_struct{
+    agg_struct_t * aggs;
+    int nb_aggs;
+    int max_aggs;
+    int * slots;
+    int nb_slots;
+    long * ports;
+    int max_ports;
+    agg_port_struct_t * walk_ports;
+    int nb_walk_ports;
+    int max_walk_ports;
+    arena_t * arena;
+};
+typedef struct agg_table_struct agg_table_t;
+static void agg_table_new(agg_table_t ** table, arena_t *arena);
+static void agg_table_free(agg_table_t *table);
+static void agg_table_reset(agg_table_t *table);
+static agg_struct_t * agg_table_exist(long index, agg_table_t * table);
+static agg_struct_t * agg_table_add(long index, agg_table_t ** table, arena_t *arena);
+static agg_struct_t * agg_table_next(agg_table_t * table, agg_struct_t *agg);
+static int agg_table_add_port(long port_index, agg_struct_t *agg, agg_table_t *table);
+static void agg_table_build_ports(agg_table_t *table);
+static int agg_table_eval_status(agg_table_t *table, if_status_t *status, arena_t *arena);
+
+
+/*  This structure is used by the lacp_monitoring function to walk the aggregations and their ports*/
+/*  The walk can be split over several calls, the last index reached is then kept between two calls*/
+/*  The table of a previous walk can be given as spare, its arrays are then reused by the next walk*/
+struct lacp_walk_struct{
+    agg_table_t * agg;
+    agg_table_t * spare;
+    short phase;
+    long last_index;
+    arena_t * arena;
+};
+typedef struct lacp_walk_struct lacp_walk_t;
+static void lacp_walk_init(lacp_walk_t *walk);
+
+
+/*  This structure is used by the irf monitoring functions to represent a member of an IRF stack with the count of its IRF ports*/
+struct irf_member_struct{
+    long member;
+    int nb_ports;
+    int nb_ports_up;
+    short status;
+};
+typedef struct irf_member_struct irf_member_t;
+
+/*  This structure is used by the irf monitoring functions to keep the members of an IRF stack in the order of the walk*/
+struct irf_table_struct{
+    irf_member_t * members;
+    int nb_members;
+    int max_members;
+    time_t time;
+    arena_t * arena;
+};
+typedef struct irf_table_struct irf_table_t;
+static void irf_table_new(irf_table_t ** table, arena_t *arena);
+static void irf_table_free(irf_table_t *table);
+static irf_member_t * irf_table_exist(long member, irf_table_t * table);
+static irf_member_t * irf_table_add_port(long member, long port_status, irf_table_t ** table, arena_t *arena);
+static irf_table_t * irf_table_copy(irf_table_t *table, arena_t *arena);
+static int irf_table_assign(irf_table_t **copy, irf_table_t *table);
 
 
-/*  This structure, that is a list, is used by the rrpp_monitoring function to represent a ring*/
+/*  This structure is used by the rrpp_monitoring function to represent a ring*/
 struct rrpp_struct{
-    struct rrpp_struct * next;
-    int domain;
-    int ring;
+    unsigned int key;
+    long domain;
+    long ring;
     long primary_port;
     short primary_port_status;
     long secondary_port;
     short secondary_port_status;
+    short status;
 };
 
 typedef struct rrpp_struct rrpp_struct_t;
-static void rrpp_struct_new(rrpp_struct_t ** rrpp);
-static void rrpp_struct_free(rrpp_struct_t *rrpp);
-static void rrpp_struct_init(short domain, short ring,rrpp_struct_t *rrpp);
-static rrpp_struct_t * rrpp_struct_exist(short domain,short ring,rrpp_struct_t * rrpp);
-static rrpp_struct_t * rrpp_struct_add(short domain, short ring, rrpp_struct_t ** rrpp);
+static void rrpp_struct_init(long domain, long ring,rrpp_struct_t *rrpp);
 static void rrpp_struct_set_port(long port_index, short selected_port, rrpp_struct_t *rrpp);
 static void rrpp_struct_set_port_status(short port_status, short selected_port, rrpp_struct_t *rrpp);
 static long rrpp_struct_get_port(short selected_port, rrpp_struct_t *rrpp);
 static short rrpp_struct_get_port_status(short selected_port, rrpp_struct_t *rrpp);
 
+/*  This structure is used by the rrpp_monitoring function to represent the rings of a switch*/
+/*  They are stored in an array in the order of the walk, and indexed by their packed (domain, ring) key in an open-addressing hash table*/
+struct rrpp_table_struct{
+    rrpp_struct_t * rings;
+    int nb_rings;
+    int max_rings;
+    int * slots;
+    int nb_slots;
+    time_t time;
+    arena_t * arena;
+};
+typedef struct rrpp_table_struct rrpp_table_t;
+static void rrpp_table_new(rrpp_table_t ** table, arena_t *arena);
+static void rrpp_table_free(rrpp_table_t *table);
+static unsigned int rrpp_table_key(long domain, long ring);
+static rrpp_struct_t * rrpp_table_exist(long domain, long ring, rrpp_table_t * table);
+static rrpp_struct_t * rrpp_table_add(long domain, long ring, rrpp_table_t ** table, arena_t *arena);
+static rrpp_struct_t * rrpp_table_next(rrpp_table_t * table, rrpp_struct_t *rrpp);
+static void rrpp_table_eval_status(rrpp_table_t *table, if_status_t *status);
+static rrpp_table_t * rrpp_table_copy(rrpp_table_t *table, arena_t *arena);
+static int rrpp_table_assign(rrpp_table_t **copy, rrpp_table_t *table);
+
+
+/*  This structure is used to keep the last transitions of the status of a port or a ring of a device*/
+/*  The times of the transitions are kept in a ring buffer, the oldest one is overwritten when it is full*/
+struct flap_struct{
+    unsigned long key;
+    short status;
+    time_t time;
+    time_t changes[FLAP_HISTORY_LEN];
+    int last_change;
+    int nb_changes;
+};
+typedef struct flap_struct flap_struct_t;
+
+/*  This structure is used to keep the histories of the ports or the rings of a device, indexed by their key in an open-addressing hash table*/
+struct flap_table_struct{
+    flap_struct_t * flaps;
+    int nb_flaps;
+    int max_flaps;
+    int * slots;
+    int nb_slots;
+};
+typedef struct flap_table_struct flap_table_t;
+static void flap_table_free(flap_table_t *table);
+static flap_struct_t * flap_table_exist(unsigned long key, flap_table_t * table);
+static int flap_table_update(unsigned long key, short status, time_t time, flap_table_t ** table);
+static int flap_table_count(unsigned long key, time_t since, flap_table_t * table);
+
+
+/*  This structure keeps the duration and the requests of a phase of the monitorings of a device*/
+struct trace_struct{
+    zbx_uint64_t calls;
+    zbx_uint64_t pdus;
+    zbx_uint64_t sum;
+    zbx_uint64_t max;
+};
+typedef struct trace_struct trace_t;
+
+
+/*  This structure keeps an SNMP exchange with a device, the oid is the one of the first varbind of the request*/
+struct flight_struct{
+    oid name[MAX_WALK_OID_LEN];
+    size_t name_length;
+    int command;
+    int nb_vars;
+    int nb_tries;
+    size_t request_bytes;
+    zbx_uint64_t request_time;
+    zbx_uint64_t response_time;
+    short status;
+    long errstat;
+    int response_vars;
+    size_t response_bytes;
+};
+typedef struct flight_struct flight_t;
+
+/*  This structure, that is a ring buffer, keeps the last SNMP exchanges with a device*/
+struct flight_recorder_struct{
+    flight_t flights[FLIGHT_RECORDER_LEN];
+    int next;
+    int nb_flights;
+};
+typedef struct flight_recorder_struct flight_recorder_t;
+static void flight_request(flight_t *flight, struct snmp_pdu *pdu, size_t bytes);
+static void flight_response(flight_t *flight, int status, struct snmp_pdu *response, size_t bytes);
+static zbx_uint64_t flight_clock(void);
+
+
+/*  This structure, that is a list, is used to keep the state of every monitored device between two calls*/
+struct device_struct{
+    struct device_struct * next;
+    char ip_address[IP_ADDRESS_LEN];
+    int nb_timeouts;
+    short breaker_state;
+    time_t breaker_retry;
+    int breaker_backoff;
+    agg_table_t * agg;
+    short agg_discovered;
+    time_t agg_time;
+    time_t agg_eval_time;
+    lacp_walk_t lacp_walk;
+    short lacp_busy;
+    if_status_t * if_status;
+    rrpp_table_t * rrpp;
+    irf_table_t * irf;
+    zbx_uint64_t fingerprint[MONITOR_TYPES];
+    short fingerprint_set[MONITOR_TYPES];
+    flap_table_t * port_flaps;
+    flap_table_t * ring_flaps;
+    trace_t * trace;
+    flight_recorder_t * recorder;
+};
+
+typedef struct device_struct device_struct_t;
+static void device_struct_new(device_struct_t ** device);
+static void device_struct_free(device_struct_t *device);
+static void device_struct_init(const char *ip_address, device_struct_t *device);
+static device_struct_t * device_struct_exist(const char *ip_address, device_struct_t * device);
+static device_struct_t * device_struct_add(const char *ip_address, device_struct_t ** device);
+static device_struct_t * device_struct_get(const char *ip_address);
+static int device_breaker_check(device_struct_t *device);
+static void device_breaker_probe(int status, device_struct_t *device);
+static void device_breaker_update(int status, device_struct_t *device);
+static int device_lacp_acquire(device_struct_t *device);
+static void device_lacp_release(device_struct_t *device);
+static if_status_t * device_if_status_get(device_struct_t *device, arena_t *arena);
+static void device_if_status_set(device_struct_t *device, if_status_t *status);
+static rrpp_table_t * device_rrpp_get(device_struct_t *device, arena_t *arena);
+static void device_rrpp_set(device_struct_t *device, rrpp_table_t *table);
+static irf_table_t * device_irf_get(device_struct_t *device, arena_t *arena);
+static void device_irf_set(device_struct_t *device, irf_table_t *table);
+static short device_fingerprint_swap(device_struct_t *device, short type, zbx_uint64_t fingerprint);
+static void device_lacp_flaps_update(device_struct_t *device, agg_table_t *table, if_status_t *status);
+static zbx_uint64_t device_lacp_flaps_count(device_struct_t *device, agg_table_t *table, long window);
+static void device_rrpp_flaps_update(device_struct_t *device, rrpp_table_t *table, time_t time);
+static zbx_uint64_t device_rrpp_flaps_count(device_struct_t *device, rrpp_table_t *table, long window);
+static void device_trace_add(device_struct_t *device, short type, long long *time, int *pdus);
+static short device_trace_get(device_struct_t *device, trace_t *trace);
+static void device_flight_add(device_struct_t *device, flight_t *flight);
+static int device_flight_get(device_struct_t *device, flight_t *flights);
+
+/* the list keeps the state of the devices monitored by this process */
+static device_struct_t *devices = NULL;
+static pthread_mutex_t devices_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/*  This structure is used by the lacp and rrpp monitoring functions to build their text result*/
+/*  The string grows as the messages are appended, up to MAX_RESULT_LEN characters*/
+struct text_struct{
+    char * str;
+    size_t len;
+    size_t size;
+    short full;
+    arena_t * arena;
+};
+typedef struct text_struct text_struct_t;
+static void text_struct_init(text_struct_t *text, arena_t *arena);
+static void text_struct_free(text_struct_t *text);
+static int text_struct_add(text_struct_t *text, const char *format, ...);
+static void text_struct_set_result(text_struct_t *text, AGENT_RESULT *result);
+static zbx_uint64_t text_fingerprint(const char *str);
+
+
+/*  This structure is used by the monitoring functions to walk one or more columns of a table in lockstep*/
+/*  Every request gets the next rows of all the columns, then every row is given to a callback with the value of each column*/
+struct monitor_struct;
+struct table_walk_struct{
+    oid columns[MAX_WALK_COLUMNS][MAX_WALK_OID_LEN];
+    size_t columns_len[MAX_WALK_COLUMNS];
+    int nb_columns;
+    int nb_index;
+    int max_repetitions;
+    long * last_index;
+    short (*row)(struct monitor_struct *, long *, struct variable_list **);
+};
+typedef struct table_walk_struct table_walk_t;
+
+
+/*  This structure is used to run the monitoring functions as state machines*/
+/*  Every step analyses the response of the last request and prepares the next one in pdu*/
+struct monitor_struct{
+    short type;
+    short phase;
+    short status;
+    int ret;
+    AGENT_RESULT *result;
+    device_struct_t * device;
+    arena_t * arena;
+    struct snmp_pdu *pdu;
+    short pdu_no_retry;
+    short aborted;
+    oid oid_table_tmp[MAX_OID_LEN];
+    size_t oid_len_tmp;
+    table_walk_t table_walk;
+    short mode;
+    short count_state;
+    long flap_window;
+    struct monitor_struct * chained;
+
+    //Tracing variables
+    long long trace_start;
+    long long trace_mark;
+    short trace_phase;
+    long long trace_time[TRACE_PHASES];
+    int trace_pdus[TRACE_PHASES];
+
+    //Interfaces variables
+    if_status_t * if_status;
+    long last_if_index;
+
+    //IRF variables
+    int nb_switches_monitored;
+    irf_table_t * irf;
+    long last_irf_index[2];
+    long irf_member;
+
+    //LACP variables
+    agg_table_t * agg;
+    agg_struct_t * agg_tmp;
+    lacp_walk_t walk;
+    lacp_walk_t * lacp_walk;
+    int walk_max_pdus;
+    int walk_pdus;
+    char ** agg_names;
+    int agg_pos;
+    long agg_index;
+
+    //RRPP variables
+    rrpp_table_t * rrpp;
+    long last_ring_index[2];
+    short rings_enabled;
+    long ring_domain;
+    long ring_id;
+
+    //Result of the LACP and RRPP monitoring
+    text_struct_t text;
+};
+
+typedef struct monitor_struct monitor_t;
+static int irf_monitoring_init(AGENT_REQUEST *request, AGENT_RESULT *result, struct snmp_session *session, monitor_t *monitor, arena_t *arena);
+static int irf_member_monitoring_init(AGENT_REQUEST *request, AGENT_RESULT *result, struct snmp_session *session, monitor_t *monitor, arena_t *arena, short mode);
+static int lacp_monitoring_init(AGENT_REQUEST *request, AGENT_RESULT *result, struct snmp_session *session, monitor_t *monitor, arena_t *arena);
+static int lacp_agg_monitoring_init(AGENT_REQUEST *request, AGENT_RESULT *result, struct snmp_session *session, monitor_t *monitor, arena_t *arena);
+static int rrpp_monitoring_init(AGENT_REQUEST *request, AGENT_RESULT *result, struct snmp_session *session, monitor_t *monitor, arena_t *arena);
+static int rrpp_ring_monitoring_init(AGENT_REQUEST *request, AGENT_RESULT *result, struct snmp_session *session, monitor_t *monitor, arena_t *arena);
+static int count_monitoring_init(AGENT_REQUEST *request, AGENT_RESULT *result, struct snmp_session *session, monitor_t *monitor, arena_t *arena, short type, short mode);
+static void monitor_init(short type, const char *ip_address, AGENT_RESULT *result, monitor_t *monitor, arena_t *arena);
+static void monitor_run(struct snmp_session session, monitor_t *monitor);
+static void monitor_step(monitor_t *monitor, int status, struct snmp_pdu *response);
+static void monitor_finish(monitor_t *monitor);
+static void monitor_fail(monitor_t *monitor, const char *msg);
+static short monitor_trace_phase(monitor_t *monitor);
+static void monitor_trace_request(monitor_t *monitor);
+static void monitor_trace_response(monitor_t *monitor);
+static void monitor_trace_end(monitor_t *monitor);
+static void monitor_request_get(monitor_t *monitor);
+static short monitor_check_oid(oid *oid_table, size_t oid_len, struct variable_list *vars);
+static void table_walk_init(table_walk_t *walk, int nb_index, long *last_index, short (*row)(monitor_t *, long *, struct variable_list **));
+static void table_walk_add_column(table_walk_t *walk, oid *oid_table, int oid_len);
+static void table_walk_request(monitor_t *monitor, table_walk_t *walk);
+static short table_walk_var(table_walk_t *walk, int column, struct variable_list *vars);
+static int table_walk_cmp(table_walk_t *walk, int column, struct variable_list *vars, long *index);
+static short table_walk_response(monitor_t *monitor, table_walk_t *walk, struct snmp_pdu *response);
+static short monitor_if_status_next(monitor_t *monitor);
+static short monitor_if_status_row(monitor_t *monitor, long *index, struct variable_list **values);
+static void monitor_if_status_step(monitor_t *monitor, struct snmp_pdu *response);
+static void irf_monitor_next(monitor_t *monitor);
+static void irf_monitor_step(monitor_t *monitor, struct snmp_pdu *response);
+static short irf_walk_row(monitor_t *monitor, long *index, struct variable_list **values);
+static void irf_discovery_result(monitor_t *monitor);
+static void lacp_monitor_next(monitor_t *monitor);
+static void lacp_monitor_step(monitor_t *monitor, struct snmp_pdu *response);
+static void lacp_walk_request(monitor_t *monitor);
+static short lacp_walk_agg_row(monitor_t *monitor, long *index, struct variable_list **values);
+static short lacp_walk_port_row(monitor_t *monitor, long *index, struct variable_list **values);
+static void lacp_walk_response(monitor_t *monitor, struct snmp_pdu *response);
+static void lacp_discovery_result(monitor_t *monitor);
+static void rrpp_monitor_next(monitor_t *monitor);
+static void rrpp_monitor_step(monitor_t *monitor, struct snmp_pdu *response);
+static short rrpp_walk_row(monitor_t *monitor, long *index, struct variable_list **values);
+static void rrpp_discovery_result(monitor_t *monitor);
+
+
+/*  This structure, that is a list, is used by the monitor_loop function to follow a monitoring waiting for a response*/
+struct loop_entry_struct{
+    struct loop_entry_struct * prev;
+    struct loop_entry_struct * next;
+    struct loop_struct * loop;
+    monitor_t * monitor;
+    void * sess_handle;
+    struct sockaddr_in peer;
+    long version;
+    u_char * community;
+    size_t community_len;
+    struct snmp_pdu * request;
+    int retries;
+    int tries_left;
+    long sess_timeout;
+    long long timeout;
+    long long deadline;
+    flight_t flight;
+};
+typedef struct loop_entry_struct loop_entry_t;
+
+/*  This structure is used by the monitor_loop function to keep the state of the event loop*/
+/*  Its sockets and its epoll instance are kept in a pool by the process for the next calls*/
+struct loop_struct{
+    struct loop_struct * next;
+    pid_t pid;
+    int epoll_fd;
+    void * sess_handles[MAX_LOOP_SOCKETS];
+    int fds[MAX_LOOP_SOCKETS];
+    int nb_sockets;
+    loop_entry_t queue;
+    loop_entry_t done;
+    netsnmp_large_fd_set fdset;
+};
+typedef struct loop_struct loop_t;
+static loop_t * loop_acquire(void);
+static loop_t * loop_open(void);
+static void loop_release(loop_t *loop);
+static void loop_close(loop_t *loop);
+static void loop_pool_free(void);
+static void monitor_loop(struct snmp_session *sessions, monitor_t *monitors, int nb_monitors, arena_t *arena);
+static void monitor_abort(monitor_t *monitor, int status);
+static int loop_entry_start(loop_entry_t *entry, struct snmp_session *session);
+static short loop_entry_next(loop_entry_t *entry);
+static void loop_entry_send(loop_entry_t *entry);
+static int loop_entry_transmit(loop_entry_t *entry, struct snmp_pdu *pdu);
+static int loop_entry_callback(int operation, struct snmp_session *session, int reqid, struct snmp_pdu *response, void *magic);
+static short loop_entry_peer(loop_entry_t *entry, struct snmp_pdu *response);
+static void loop_entry_append(loop_entry_t *entry, loop_entry_t *list);
+static void loop_entry_remove(loop_entry_t *entry);
+static long long loop_clock(void);
+
+/* the pool keeps the event loops released by the previous calls of the process */
+static loop_t *loops = NULL;
+static pthread_mutex_t loops_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int fleet_monitoring(AGENT_REQUEST *request, AGENT_RESULT *result, int (*function)(AGENT_REQUEST *, AGENT_RESULT *, struct snmp_session *, monitor_t *, arena_t *));
+static int fleet_hosts_load(const char *hosts_param, char ***hosts, arena_t *arena, const char **error);
+static int fleet_hosts_add(const char *token, char ***hosts, int nb_hosts, int *max_hosts, arena_t *arena);
+static void monitor_result_json(struct zbx_json *j, const char *name, AGENT_RESULT *result);
+static int fingerprint_monitoring(AGENT_REQUEST *request, AGENT_RESULT *result, int (*function)(AGENT_REQUEST *, AGENT_RESULT *, struct snmp_session *, monitor_t *, arena_t *), short changes);
+static void fleet_hosts_free(char **hosts, int nb_hosts, arena_t *arena);
+
+
+/*  This structure keeps the duration of the calls of an item key, in log-linear buckets of milliseconds*/
+/*  The first 4 buckets are 1ms wide, then every power of two is split in 4 buckets*/
+struct stats_latency_struct{
+    zbx_uint64_t calls;
+    zbx_uint64_t failures;
+    zbx_uint64_t sum;
+    zbx_uint64_t max;
+    zbx_uint64_t buckets[STATS_LATENCY_BUCKETS];
+};
+typedef struct stats_latency_struct stats_latency_t;
+
+/*  This structure keeps the counters of the activity of the module in the process that loaded it*/
+struct stats_struct{
+    zbx_uint64_t pdus_sent[STATS_PDU_TYPES];
+    zbx_uint64_t pdus_received[STATS_PDU_TYPES];
+    zbx_uint64_t bytes_sent;
+    zbx_uint64_t bytes_received;
+    zbx_uint64_t retries;
+    zbx_uint64_t timeouts;
+    zbx_uint64_t errors;
+    zbx_uint64_t breaker_skips;
+    zbx_uint64_t cache_hits[STATS_CACHES];
+    zbx_uint64_t cache_misses[STATS_CACHES];
+};
+typedef struct stats_struct stats_t;
+static void stats_add(zbx_uint64_t *counter);
+static void stats_cache(short cache, short hit);
+static size_t stats_pdu(struct snmp_pdu *pdu, short received);
+static short stats_pdu_type(int command);
+static size_t stats_pdu_bytes(struct snmp_pdu *pdu);
+static size_t stats_ber_len(size_t len);
+static size_t stats_ber_oid(oid *name, size_t name_length);
+static size_t stats_ber_int(long value);
+static int stats_latency_bucket(zbx_uint64_t duration);
+static zbx_uint64_t stats_latency_bound(int bucket);
+
+static stats_t stats;
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static long trace_threshold = TRACE_THRESHOLD;
+/* the directory of the files of devices of the fleet functions, read from ZBXMODHP_FLEET_DIR at the init of the module */
+/* the files are refused while it is empty */
+static char fleet_dir[PATH_MAX] = "";
+static const char *stats_pdu_names[STATS_PDU_TYPES] = {"get", "getnext", "getbulk", "response", "report", "other"};
+static const char *stats_cache_names[STATS_CACHES] = {"if_status", "agg", "rrpp", "irf"};
+static const char *trace_type_names[MONITOR_TYPES] = {"irf", "lacp", "rrpp"};
+static const char *trace_phase_names[MONITOR_TYPES][TRACE_PHASES] = {
+    {NULL, "probe", NULL, "stack", "result", NULL, NULL, NULL, NULL},
+    {NULL, "probe", NULL, "agg_list", "port_status", "if_desc", "discovery", "agg", "attached_id"},
+    {NULL, "probe", NULL, "enable", "rings", "port_status", "result", NULL, NULL}
+};
 
 static ZBX_METRIC keys[] =
 /*      KEY             FLAG            FUNCTION                    TEST PARAMETERS */
 {
     {"monitor.irf",     CF_HAVEPARAMS,  irf_monitoring,  "0,0"},
+    {"monitor.irf.discovery",   CF_HAVEPARAMS,  irf_discovery, "0,0"},
+    {"monitor.irf.member",  CF_HAVEPARAMS,  irf_member_monitoring, "0,0"},
     {"monitor.lacp",    CF_HAVEPARAMS,	lacp_monitoring, "0,0"},
+    {"monitor.lacp.discovery",  CF_HAVEPARAMS,  lacp_discovery, "0,0"},
+    {"monitor.lacp.agg",    CF_HAVEPARAMS,  lacp_agg_monitoring, "0,0"},
+    {"monitor.lacp.count",  CF_HAVEPARAMS,  lacp_count_monitoring, "0,0"},
+    {"monitor.lacp.flaps",  CF_HAVEPARAMS,  lacp_flaps_monitoring, "0,0"},
     {"monitor.rrpp",    CF_HAVEPARAMS,	rrpp_monitoring, "0,0"},
+    {"monitor.rrpp.discovery",  CF_HAVEPARAMS,  rrpp_discovery, "0,0"},
+    {"monitor.rrpp.ring",   CF_HAVEPARAMS,  rrpp_ring_monitoring, "0,0"},
+    {"monitor.rrpp.count",  CF_HAVEPARAMS,  rrpp_count_monitoring, "0,0"},
+    {"monitor.rrpp.flaps",  CF_HAVEPARAMS,  rrpp_flaps_monitoring, "0,0"},
+    {"monitor.fleet.irf",   CF_HAVEPARAMS,  irf_fleet_monitoring,  "0,0"},
+    {"monitor.fleet.lacp",  CF_HAVEPARAMS,  lacp_fleet_monitoring, "0,0"},
+    {"monitor.fleet.rrpp",  CF_HAVEPARAMS,  rrpp_fleet_monitoring, "0,0"},
+    {"monitor.hp.all",  CF_HAVEPARAMS,  hp_all_monitoring, "0,0"},
+    {"monitor.lacp.fingerprint",    CF_HAVEPARAMS,  lacp_fingerprint, "0,0"},
+    {"monitor.lacp.changes",    CF_HAVEPARAMS,  lacp_changes, "0,0"},
+    {"monitor.rrpp.fingerprint",    CF_HAVEPARAMS,  rrpp_fingerprint, "0,0"},
+    {"monitor.rrpp.changes",    CF_HAVEPARAMS,  rrpp_changes, "0,0"},
+    {"monitor.module.stats",    0,  module_stats, NULL},
+    {"monitor.module.trace",    CF_HAVEPARAMS,  module_trace, "0,0"},
+    {"monitor.module.recorder", CF_HAVEPARAMS,  module_recorder, "0,0"},
     {NULL}
 };
 
+/*  The keys given to Zabbix, they all call stats_item to time the function of the key*/
+static ZBX_METRIC timed_keys[sizeof(keys)/sizeof(ZBX_METRIC)];
+static stats_latency_t stats_latency[sizeof(keys)/sizeof(ZBX_METRIC)];
+
 /******************************************************************************
  *                                                                            *
  * Function: zbx_module_api_version                                           *
@@ -146,10 +793,57 @@ void	zbx_module_item_timeout(int timeout)
  *                                                                            *
  * Return value: list of item keys                                            *
  *                                                                            *
+ * Comment: Every key calls stats_item, which runs the function of the key    *
+ *          and keeps its duration for monitor.module.stats                   *
  ******************************************************************************/
 ZBX_METRIC	*zbx_module_item_list()
 {
-    return keys;
+    int i;
+
+    for(i=0;i<(int)(sizeof(keys)/sizeof(ZBX_METRIC));i++){
+        timed_keys[i] = keys[i];
+        if(keys[i].key != NULL)timed_keys[i].function = stats_item;
+    }
+    return timed_keys;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: stats_item                                                       *
+ *                                                                            *
+ * Purpose: Run the function of an item key and keep its duration             *
+ *                                                                            *
+ * Parameters: request - structure that contains item key and parameters      *
+ *             result - structure that will contain result                    *
+ *                                                                            *
+ * Return value: the return value of the function of the key                  *
+ *                                                                            *
+ ******************************************************************************/
+static int	stats_item(AGENT_REQUEST *request, AGENT_RESULT *result)
+{
+    long long start;
+    zbx_uint64_t duration;
+    int ret;
+    int i;
+
+    for(i=0;keys[i].key != NULL && strcmp(keys[i].key, request->key) != 0;i++);
+    if(keys[i].key == NULL){
+        SET_MSG_RESULT(result, strdup("Unsupported item key"));
+        return SYSINFO_RET_FAIL;
+    }
+
+    start = loop_clock();
+    ret = keys[i].function(request, result);
+    duration = (zbx_uint64_t)(loop_clock() - start);
+
+    pthread_mutex_lock(&stats_lock);
+    stats_latency[i].calls++;
+    if(ret != SYSINFO_RET_OK)stats_latency[i].failures++;
+    stats_latency[i].sum += duration;
+    if(duration > stats_latency[i].max)stats_latency[i].max = duration;
+    stats_latency[i].buckets[stats_latency_bucket(duration)]++;
+    pthread_mutex_unlock(&stats_lock);
+    return ret;
 }
 
 
@@ -194,18 +888,40 @@ ZBX_METRIC	*zbx_module_item_list()
  ******************************************************************************/
 static int	irf_monitoring(AGENT_REQUEST *request, AGENT_RESULT *result)
 {
-    /****************** Variables ******************/
-    //Structs needed for snmp request
     struct snmp_session session;
-    struct snmp_pdu *response;
-    struct variable_list *vars;
-    
-    
-    //Variables holding oid to check
-    oid oid_table_irf[] = {1,3,6,1,4,1,25506,2,91,4,1,3};
-    int oid_len_irf = 12 ;
-    
-    
+    monitor_t monitor;
+    arena_t *arena = arena_acquire();
+
+    if(irf_monitoring_init(request, result, &session, &monitor, arena) != SYSINFO_RET_OK){
+        arena_release(arena);
+        return SYSINFO_RET_FAIL;
+    }
+
+    //Run the monitoring until all the requests have been answered
+    monitor_run(session, &monitor);
+    arena_release(arena);
+    return monitor.ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: irf_monitoring_init                                              *
+ *                                                                            *
+ * Purpose: Check the parameters of monitor.irf and init its monitoring       *
+ *                                                                            *
+ * Parameters: request - structure that contains item key and parameters      *
+ *             result - structure that will contain the error message         *
+ *             session - the struct snmp_session to init                      *
+ *             monitor - the monitor_t to init                                *
+ *             arena - the arena of the transient data of the monitoring      *
+ *                                                                            *
+ * Return value: SYSINFO_RET_FAIL - the parameters are invalid                *
+ *               SYSINFO_RET_OK - the monitoring can be run                   *
+ *                                                                            *
+ ******************************************************************************/
+static int irf_monitoring_init(AGENT_REQUEST *request, AGENT_RESULT *result, struct snmp_session *session, monitor_t *monitor, arena_t *arena)
+{
+    /****************** Variables ******************/
     //Parameters (Not mandatory parameters are initialised)
     long version = SNMP_VERSION_2c;
     long timeout = 2000000;
@@ -214,26 +930,21 @@ static int	irf_monitoring(AGENT_REQUEST *request, AGENT_RESULT *result)
     size_t community_len;
     char *ip_address;
     int nb_switches_monitored;
-    int max_switches;
-    
-    
+
+
     //Others Variables
-    short status;
-    short nb_switches = 0;
-    short ring_open = 0;
     int ret = SYSINFO_RET_OK;
-    int i,flag;
-    
+
     /****************** Get parameters ******************/
     //Check if mandatory parameters are provided
     if(request->nparam <3){
         SET_MSG_RESULT(result, strdup("Parameters Missing"));
         ret =  SYSINFO_RET_FAIL;
     }
-    //Check IP address is valid
+    //Check IP address is valid
     ip_address = get_rparam(request, 0);
     if(is_valid_ip(ip_address)){
-        SET_MSG_RESULT(result, strdup("Invalid IP Address"));
+        SET_MSG_RESULT(result, strdup("Invalid IP Address"));
         ret = SYSINFO_RET_FAIL;
     }
     //Get Community
@@ -245,7 +956,6 @@ static int	irf_monitoring(AGENT_REQUEST *request, AGENT_RESULT *result)
         SET_MSG_RESULT(result, strdup("Number of monitored switches invalid"));
         ret = SYSINFO_RET_FAIL;
     }
-    max_switches = (nb_switches_monitored + 1)*2;
     //Get Timeout if provided
     if(request->nparam >3){
         timeout = atoi(get_rparam(request, 3))*1000000;
@@ -254,95 +964,239 @@ static int	irf_monitoring(AGENT_REQUEST *request, AGENT_RESULT *result)
     if(request->nparam >4){
         retries = atoi(get_rparam(request, 4));
     }
-    
+    if(ret != SYSINFO_RET_OK)return ret;
+
     /****************** Main code ******************/
-    //Init SNMP Session
-    snmp_sess_init( &session );
-    session.version = version;
-    session.timeout = timeout;
-    session.retries = retries;
-    session.community = community;
-    session.community_len = community_len;
-    session.peername = ip_address;
-    
-    //Send the request
-    status = snmpbulkget(session, &response, oid_table_irf, oid_len_irf, max_switches);
-    
-    //If success, analyse the data received
-    if (status == STAT_SUCCESS && response->errstat == SNMP_ERR_NOERROR) {
-        for(vars = response->variables; vars; vars = vars->next_variable) {
-            i = 0;
-            flag = 1;
-            while(i<oid_len_irf && flag){
-                //Compare the oid of the response with the oid to check
-                if(oid_table_irf[i]!=vars->name[i]){
-                    flag =  0;
+    //Init SNMP Session
+    snmp_sess_init(session);
+    session->version = version;
+    session->timeout = timeout;
+    session->retries = retries;
+    session->community = community;
+    session->community_len = community_len;
+    session->peername = ip_address;
+
+    //Init the monitoring of the device
+    monitor_init(MONITOR_IRF, ip_address, result, monitor, arena);
+    monitor->nb_switches_monitored = nb_switches_monitored;
+    return SYSINFO_RET_OK;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: irf_monitor_next                                                 *
+ *                                                                            *
+ * Purpose: Prepare the next request of the irf monitoring                    *
+ *                                                                            *
+ * Parameters: monitor - A monitor_t pointer                                  *
+ *                                                                            *
+ * Comment: The monitoring is finished when no request is prepared            *
+ ******************************************************************************/
+static void irf_monitor_next(monitor_t *monitor){
+    //Variables holding oid to check
+    oid oid_table_irf[] = {1,3,6,1,4,1,25506,2,91,4,1,3};
+    int oid_len_irf = 12 ;
+
+    irf_member_t *member;
+    int nb_switches;
+    short ring_open;
+    int i;
+
+    while(monitor->pdu == NULL && monitor->phase != MONITOR_PHASE_DONE){
+        switch(monitor->phase){
+            /********************************************************************
+             * The stack port table is walked until its end, its index is the   *
+             * member id and the port. The discovery and the member items use   *
+             * the members evaluated for the device if they are recent, they    *
+             * are only looked up before the first request of the walk since    *
+             * the rows of every response are added to monitor->irf             *
+             *******************************************************************/
+            case IRF_PHASE_STACK:
+                if(monitor->mode != MONITOR_MODE_STATUS && monitor->irf == NULL && monitor->last_irf_index[0] == 0 && monitor->last_irf_index[1] == 0){
+                    monitor->irf = device_irf_get(monitor->device, monitor->arena);
+                    if(monitor->irf != NULL){
+                        monitor->phase = IRF_PHASE_RESULT;
+                        break;
+                    }
                 }
-                i++;
-            }
-            //If it is the same oid, check the value
-            if(flag && vars->type == ASN_INTEGER){
-                nb_switches ++;
-                //If one of the value is not 1 (port status is UP) then the ring is open
-                if(*(vars->val.integer) != 1) ring_open = 1;
-            }
-        }
-        
-        //Set the return depending on the result
-        if(nb_switches%2 !=0){
-            SET_MSG_RESULT(result, strdup("Unknown error in SNMP session"));
-            ret = SYSINFO_RET_FAIL;
-        }
-        nb_switches=nb_switches/2;
-        
-        if(nb_switches == nb_switches_monitored && !ring_open){
-            SET_UI64_RESULT(result, 0);
-            ret = SYSINFO_RET_OK;
-        }
-        if(nb_switches == nb_switches_monitored && ring_open){
-            SET_UI64_RESULT(result, 1);
-            ret = SYSINFO_RET_OK;
-        }
-        if(nb_switches>nb_switches_monitored){
-            SET_UI64_RESULT(result, 2);
-            ret = SYSINFO_RET_OK;
-        }
-        if (nb_switches<nb_switches_monitored){
-            SET_UI64_RESULT(result, 3);
-            ret = SYSINFO_RET_OK;
-        }
-    } else {
-        //If failure, return the error message
-        if (status == STAT_SUCCESS){
-            SET_MSG_RESULT(result, strdup(snmp_errstring(response->errstat)));
-            ret = SYSINFO_RET_FAIL;
-        }else if (status == STAT_TIMEOUT){
-            SET_UI64_RESULT(result, 4);
-            ret = SYSINFO_RET_OK;
-        }
-        else{
-            SET_MSG_RESULT(result, strdup("Unknown error in SNMP session"));
-            ret = SYSINFO_RET_FAIL;
+                table_walk_init(&monitor->table_walk, 2, monitor->last_irf_index, irf_walk_row);
+                table_walk_add_column(&monitor->table_walk, oid_table_irf, oid_len_irf);
+                //Every switch has two IRF ports, one more switch is requested so the end of the table is in the first response
+                monitor->table_walk.max_repetitions = ((monitor->mode == MONITOR_MODE_STATUS ? monitor->nb_switches_monitored : MAX_IRF_SWITCHES) + 1)*2;
+                table_walk_request(monitor, &monitor->table_walk);
+                break;
+
+            /********************************************************************
+             * The members evaluated are cached for the other irf items of the  *
+             * device, then the result is set                                   *
+             *******************************************************************/
+            case IRF_PHASE_RESULT:
+                if(monitor->irf == NULL)irf_table_new(&monitor->irf, monitor->arena);
+                if(monitor->irf != NULL && monitor->irf->time == 0){
+                    monitor->irf->time = time(NULL);
+                    device_irf_set(monitor->device, monitor->irf);
+                }
+                if(monitor->mode == MONITOR_MODE_DISCOVERY){
+                    irf_discovery_result(monitor);
+                    monitor_finish(monitor);
+                    break;
+                }
+                if(monitor->mode == MONITOR_MODE_ENTITY){
+                    member = irf_table_exist(monitor->irf_member, monitor->irf);
+                    if(member == NULL){
+                        monitor_fail(monitor, "Unknown member");
+                        break;
+                    }
+                    SET_UI64_RESULT(monitor->result, member->status);
+                    monitor_finish(monitor);
+                    break;
+                }
+
+                //The ring is open if one of the ports of a member is not up
+                nb_switches = monitor->irf != NULL ? monitor->irf->nb_members : 0;
+                ring_open = 0;
+                for(i=0;i<nb_switches;i++){
+                    if(monitor->irf->members[i].status != IRF_MEMBER_OK)ring_open = 1;
+                }
+                if(nb_switches == monitor->nb_switches_monitored){
+                    SET_UI64_RESULT(monitor->result, ring_open ? 1 : 0);
+                }else if(nb_switches > monitor->nb_switches_monitored){
+                    SET_UI64_RESULT(monitor->result, 2);
+                }else{
+                    SET_UI64_RESULT(monitor->result, 3);
+                }
+                monitor_finish(monitor);
+                break;
+
+            default:
+                monitor_finish(monitor);
+                break;
         }
     }
-    //Free the used pdu structure
-    snmp_free_pdu(response);
-    return ret;
 }
 
 /******************************************************************************
  *                                                                            *
- * Function: lacp_monitoring                                                  *
+ * Function: irf_walk_row                                                     *
  *                                                                            *
- * Purpose: Item to monitor lacp protocol                                     *
+ * Purpose: Save a port of the walk of the irf stack port table               *
+ *                                                                            *
+ * Parameters: monitor - A monitor_t pointer                                  *
+ *             index - the member id and the port of the row                  *
+ *             values - the status of the port                                *
+ *                                                                            *
+ * Return value: 1 - the walk continues                                       *
+ *               0 - the member can not be added, the monitoring is failed    *
+ *                                                                            *
+ ******************************************************************************/
+static short irf_walk_row(monitor_t *monitor, long *index, struct variable_list **values){
+    if(irf_table_add_port(index[0], values[0]->type == ASN_INTEGER ? *values[0]->val.integer : 0, &monitor->irf, monitor->arena) == NULL){
+        monitor_fail(monitor, "Cannot allocate memory");
+        return 0;
+    }
+    return 1;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: irf_monitor_step                                                 *
+ *                                                                            *
+ * Purpose: Analyse the response of the last request of the irf monitoring    *
+ *          and prepare the next one                                          *
+ *                                                                            *
+ * Parameters: monitor - A monitor_t pointer                                  *
+ *             response - the response of the last request                    *
+ *                                                                            *
+ ******************************************************************************/
+static void irf_monitor_step(monitor_t *monitor, struct snmp_pdu *response){
+    switch(monitor->phase){
+        case IRF_PHASE_STACK:
+            //At the end of the table the result is set
+            if(table_walk_response(monitor, &monitor->table_walk, response) && monitor->phase != MONITOR_PHASE_DONE){
+                monitor->phase = IRF_PHASE_RESULT;
+            }
+            break;
+    }
+    irf_monitor_next(monitor);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: irf_discovery_result                                             *
+ *                                                                            *
+ * Purpose: Set the low level discovery JSON of the members as result         *
+ *                                                                            *
+ * Parameters: monitor - A monitor_t pointer                                  *
+ *                                                                            *
+ ******************************************************************************/
+static void irf_discovery_result(monitor_t *monitor){
+    struct zbx_json j;
+    char buf[21];
+    int i;
+
+    zbx_json_init(&j, ZBX_JSON_STAT_BUF_LEN);
+    zbx_json_addarray(&j, ZBX_PROTO_TAG_DATA);
+    for(i=0;monitor->irf != NULL && i<monitor->irf->nb_members;i++){
+        zbx_json_addobject(&j, NULL);
+        snprintf(buf, sizeof(buf), "%ld", monitor->irf->members[i].member);
+        zbx_json_addstring(&j, "{#MEMBER}", buf, ZBX_JSON_TYPE_STRING);
+        snprintf(buf, sizeof(buf), "%d", monitor->irf->members[i].nb_ports);
+        zbx_json_addstring(&j, "{#PORTS}", buf, ZBX_JSON_TYPE_STRING);
+        zbx_json_close(&j);
+    }
+    zbx_json_close(&j);
+    SET_STR_RESULT(monitor->result, strdup(j.buffer));
+    zbx_json_free(&j);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: irf_discovery                                                    *
+ *                                                                            *
+ * Purpose: Item to discover the members of an IRF stack                      *
  *                                                                            *
  * Parameters: request - structure that contains item key and parameters      *
- *              request->key - item key without parameters                    *
- *              request->nparam - number of parameters                        *
- *              request->timeout - processing should not take longer than     *
- *                                 this number of seconds                     *
- *              request->params[N-1] - pointers to item key parameters        *
+ *             result - structure that will contain result                    *
+ *                                                                            *
+ * Return value: SYSINFO_RET_FAIL - function failed, item will be marked      *
+ *                                 as not supported by zabbix                 *
+ *               SYSINFO_RET_OK - success                                     *
+ *                                                                            *
+ * Comment: The parameters of the request are (in order):                     *
+ *              - IP address of the snmp agent                                *
+ *              - SNMP read community of the snmp agent                       *
+ *              - The timeout request (in second) - 2s by default             *
+ *              - The number of retries - 0 by default                        *
+ *          The two last parameters are optional                              *
+ *                                                                            *
+ *          In case of success the result structure will contain the low      *
+ *          level discovery JSON of the members with the macros {#MEMBER}     *
+ *          and {#PORTS} (the number of IRF ports of the member)              *
+ ******************************************************************************/
+static int	irf_discovery(AGENT_REQUEST *request, AGENT_RESULT *result)
+{
+    struct snmp_session session;
+    monitor_t monitor;
+    arena_t *arena = arena_acquire();
+
+    if(irf_member_monitoring_init(request, result, &session, &monitor, arena, MONITOR_MODE_DISCOVERY) != SYSINFO_RET_OK){
+        arena_release(arena);
+        return SYSINFO_RET_FAIL;
+    }
+
+    //Run the monitoring until all the requests have been answered
+    monitor_run(session, &monitor);
+    arena_release(arena);
+    return monitor.ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: irf_member_monitoring                                            *
  *                                                                            *
+ * Purpose: Item to monitor a single member of an IRF stack                   *
+ *                                                                            *
+ * Parameters: request - structure that contains item key and parameters      *
  *             result - structure that will contain result                    *
  *                                                                            *
  * Return value: SYSINFO_RET_FAIL - function failed, item will be marked      *
@@ -352,48 +1206,58 @@ static int	irf_monitoring(AGENT_REQUEST *request, AGENT_RESULT *result)
  * Comment: The parameters of the request are (in order):                     *
  *              - IP address of the snmp agent                                *
  *              - SNMP read community of the snmp agent                       *
+ *              - The member id ({#MEMBER})                                   *
  *              - The timeout request (in second) - 2s by default             *
  *              - The number of retries - 0 by default                        *
  *          The two last parameters are optional                              *
  *                                                                            *
- *          In case of success the result structure will contain              *
- *          the following:                                                    *
- *               - No data if everything is OK                                *
- *               - The name of the aggregation that are partially or          *
- *                 totaly down
+ *          In case of success the result structure will contain an integer:  *
+ *               - 0 (IRF_MEMBER_OK) if all the IRF ports are up              *
+ *               - 1 (IRF_MEMBER_PORT_DOWN) if some IRF ports are down        *
+ *               - 2 (IRF_MEMBER_DOWN) if all the IRF ports are down          *
  *                                                                            *
- *          In case of failure, the result structure will contain an          *
- *          error message                                                     *
+ *          The members of a stack are evaluated once for all its items, then *
+ *          kept for IF_STATUS_MAX_AGE seconds                                *
  ******************************************************************************/
-static int	lacp_monitoring(AGENT_REQUEST *request, AGENT_RESULT *result)
+static int	irf_member_monitoring(AGENT_REQUEST *request, AGENT_RESULT *result)
 {
-    
-    
-    /****************** Variables ******************/
-    //Structs needed for snmp request
     struct snmp_session session;
-    struct snmp_pdu *response;
-    struct variable_list *vars;
-    oid oid_table_tmp[MAX_OID_LEN];
-    size_t oid_len_tmp = MAX_OID_LEN;
-    
-    
-    //Variables holding oid to check
-    oid oid_table_agg_port_list[] = {1,2,840,10006,300,43,1,1,2,1,1};
-    int oid_len_agg_port_list = 11 ;
-    
-    oid oid_table_agg_port_attached_id[] = {1,2,840,10006,300,43,1,2,1,1,13};
-    int oid_len_agg_port_attached_id = 11 ;
-    
-    
-    oid oid_table_if_oper_status[] = {1,3,6,1,2,1,2,2,1,8};
-    int oid_len_if_oper_status = 10 ;
-    
-    
-    oid oid_table_if_desc[] = {1,3,6,1,2,1,2,2,1,2};
-    int oid_len_if_desc = 10 ;
-    
-    
+    monitor_t monitor;
+    arena_t *arena = arena_acquire();
+
+    if(irf_member_monitoring_init(request, result, &session, &monitor, arena, MONITOR_MODE_ENTITY) != SYSINFO_RET_OK){
+        arena_release(arena);
+        return SYSINFO_RET_FAIL;
+    }
+
+    //Run the monitoring until all the requests have been answered
+    monitor_run(session, &monitor);
+    arena_release(arena);
+    return monitor.ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: irf_member_monitoring_init                                       *
+ *                                                                            *
+ * Purpose: Check the parameters of monitor.irf.discovery or                  *
+ *          monitor.irf.member and init its monitoring                        *
+ *                                                                            *
+ * Parameters: request - structure that contains item key and parameters      *
+ *             result - structure that will contain the error message         *
+ *             session - the struct snmp_session to init                      *
+ *             monitor - the monitor_t to init                                *
+ *             arena - the arena of the transient data of the monitoring      *
+ *             mode - MONITOR_MODE_DISCOVERY or MONITOR_MODE_ENTITY, the      *
+ *                    member id is the third parameter of the second one      *
+ *                                                                            *
+ * Return value: SYSINFO_RET_FAIL - the parameters are invalid                *
+ *               SYSINFO_RET_OK - the monitoring can be run                   *
+ *                                                                            *
+ ******************************************************************************/
+static int irf_member_monitoring_init(AGENT_REQUEST *request, AGENT_RESULT *result, struct snmp_session *session, monitor_t *monitor, arena_t *arena, short mode)
+{
+    /****************** Variables ******************/
     //Parameters (Not mandatory parameters are initialised)
     long version = SNMP_VERSION_2c;
     long timeout = 2000000;
@@ -401,373 +1265,72 @@ static int	lacp_monitoring(AGENT_REQUEST *request, AGENT_RESULT *result)
     char *community;
     size_t community_len;
     char *ip_address;
-    
-    //Aggregation structure variable
-    agg_struct_t *agg = NULL;
-    agg_struct_t * agg_tmp = NULL;
-    long last_index;
-    int link_down;
-    
-    
-    //Other Variables
-    short status;
-    short finish;
+    long member = 0;
+
+
+    //Others Variables
+    int first_optional = mode == MONITOR_MODE_ENTITY ? 3 : 2;
     int ret = SYSINFO_RET_OK;
-    int i;
-    char tmp_res[MAX_CHAR_RESULT];
-    char msg_is_down[]="is down\n";
-    short len_is_down = 9;
-    char msg_has_link_down[28]="has one or more links down\n";
-    short len_has_link_down = 28;
-    char msg_too_many[18]="Too many results\n";
-    short len_too_many = 18;
-    short already_written;
-    
-    
+
     /****************** Get parameters ******************/
-    //Get parameters
-    if(request->nparam <2){     //Check if mandatory parameters are provided
+    //Check if mandatory parameters are provided
+    if(request->nparam <first_optional){
         SET_MSG_RESULT(result, strdup("Parameters Missing"));
-        ret =  SYSINFO_RET_FAIL;
+        return SYSINFO_RET_FAIL;
+    }
+    if(request->nparam >first_optional+2){
+        SET_MSG_RESULT(result, strdup("Too many parameters"));
+        return SYSINFO_RET_FAIL;
     }
+    //Check IP address is valid
     ip_address = get_rparam(request, 0);
-    
     if(is_valid_ip(ip_address)){
         SET_MSG_RESULT(result, strdup("Invalid IP Address"));
         ret = SYSINFO_RET_FAIL;
     }
-    
+    //Get Community
     community = get_rparam(request, 1);
     community_len = strlen(community);
-    
-    if(request->nparam >2){
-        timeout = atoi(get_rparam(request, 2))*1000000;
-    }
-    if(request->nparam >3){
-        retries = atoi(get_rparam(request, 3));
-    }
-    //zabbix_log(LOG_LEVEL_INFORMATION, "IP:%s Com:%s",ip_address,community);
-    /****************** Main code ******************/
-    //Init SNMP Session
-    snmp_sess_init(&session);
-    session.version = version;
-    session.timeout = timeout;
-    session.retries = retries;
-    session.community = community;
-    session.community_len = community_len;
-    session.peername = ip_address;
-    
-    /********************************************************************
-     * The first step is to check if the switch has any aggregation.    *
-     * As the bulkrequest may not get all the subtree in one request,   *
-     * a loop is made until all the nodes have been retrieved           *
-     * If there is any aggregation then it is save in an aggregation    *
-     * structure.                                                       *
-     *******************************************************************/
-    
-    //Init the differents variables used for this step
-    for(i=0;i<oid_len_agg_port_list;i++)oid_table_tmp[i] = oid_table_agg_port_list[i];
-    oid_len_tmp = oid_len_agg_port_list;
-    finish = 1;
-    last_index = 0;
-    status = STAT_SUCCESS;
-    while(finish && !status){
-        //If more than one bulkrequest is necessery to get the all subtree
-        //then the next node to start the second request is the last index retrieve
-        oid_len_tmp = oid_len_agg_port_list;
-        if(last_index !=0){
-            oid_table_tmp[oid_len_tmp]=last_index;
-            oid_len_tmp++;
-        }
-        
-        //Send the request
-        status = snmpbulkget(session, &response, oid_table_tmp, oid_len_tmp, MAX_BULK_REPETITION);
-        
-        //If success, analyse the data received
-        if (status == STAT_SUCCESS && response->errstat == SNMP_ERR_NOERROR) {
-            vars = response->variables;
-            while(vars !=NULL && finish) {
-                i = 0;
-                while(i<oid_len_agg_port_list && finish){
-                    //Compare the oid of the response with the oid to check
-                    //If the subtstree is different then the loop stop
-                    if(oid_table_agg_port_list[i]!=vars->name[i]){
-                        finish=0;
-                    }
-                    i++;
-                }
-                //If it is the same oid then save the aggregation index in an aggregation structure
-                if(finish){
-                    agg_struct_add(vars->name[i], &agg);
-                    last_index = vars->name[i];
-                }
-                vars = vars->next_variable;
-            }
-            
-        } else {
-            //If failure, return the error message
-            if (status == STAT_SUCCESS){
-                SET_MSG_RESULT(result, strdup(snmp_errstring(response->errstat)));
-                ret = SYSINFO_RET_FAIL;
-            }
+    //Get the member id
+    if(mode == MONITOR_MODE_ENTITY){
+        member = atol(get_rparam(request, 2));
+        if(member<1){
+            SET_MSG_RESULT(result, strdup("Invalid member id"));
+            ret = SYSINFO_RET_FAIL;
         }
-        //Free the used structure
-        snmp_free_pdu(response);
     }
-    
-    /********************************************************************
-     * If the switch has no aggregation configured then it is not       *
-     * needed to continue.                                              *
-     * If it has aggregation then man need to get all the port attached *
-     * to this aggregation. Once again, as the bulkrequest may not get  *
-     * all the subtree in one request, a loop is made until all the     *
-     * nodes have been retrieved                                        *
-     *******************************************************************/
-    finish = 1;
-    if(agg != NULL && finish){
-        
-        //Init the differents variables used for this step
-        for(i=0;i<oid_len_agg_port_attached_id;i++)oid_table_tmp[i] = oid_table_agg_port_attached_id[i];
-        oid_len_tmp = oid_len_agg_port_attached_id;
-        finish = 1;
-        last_index = 0;
-        while(finish & !status){
-            //If more than one bulkrequest is necessery to get the all subtree
-            //then the next node to start the second request is the last index retrieve
-            oid_len_tmp = oid_len_agg_port_attached_id;
-            if(last_index !=0){
-                oid_table_tmp[oid_len_tmp]=last_index;
-                oid_len_tmp++;
-            }
-            //Send the request
-            status = snmpbulkget(session, &response, oid_table_tmp, oid_len_tmp, MAX_BULK_REPETITION);
-            //If success, analyse the data received
-            if (status == STAT_SUCCESS && response->errstat == SNMP_ERR_NOERROR) {
-                vars = response->variables;
-                while(vars !=NULL && finish){
-                    i = 0;
-                    while(i<oid_len_agg_port_attached_id && finish){
-                        //Compare the oid of the response with the oid to check
-                        //If the subtstree is different then the loop stop
-                        if(oid_table_agg_port_attached_id[i]!=vars->name[i]){
-                            finish=0;
-                        }
-                        i++;
-                    }
-                    //If it the same oid, check the value
-                    if(finish){
-                        last_index = vars->name[i];
-                        //If the value is different from zero then the port is attached to an aggregation
-                        if(vars->type == ASN_INTEGER && *vars->val.integer !=0){
-                            //If the aggregation has been retrieved at the previous step
-                            //then we had this port to the aggregation
-                            agg_tmp = agg_struct_exist(*vars->val.integer, agg);
-                            if(agg_tmp != NULL)agg_struct_add_port(vars->name[i], agg_tmp);
-                        }
-                    }
-                    vars = vars->next_variable;
-                }
-            } else {
-                //If failure, return the error message
-                if (status == STAT_SUCCESS){
-                    SET_MSG_RESULT(result, strdup(snmp_errstring(response->errstat)));
-                    ret = SYSINFO_RET_FAIL;
-                }
-                
-            }
-            //Free the used structure
-            snmp_free_pdu(response);
-        }
-        
-        /********************************************************************
-         * The next step is to get the status of every port attached        *
-         * to an aggregation and deduce the state of the aggregations       *
-         *******************************************************************/
-        agg_tmp = agg;
-        agg_tmp->status = AGG_STATUS_OK; //By default the status of an aggregation is OK
-        link_down = 0;
-        last_index = 0;
-        finish = 1;
-        while(agg_tmp !=NULL && finish && !status){
-            //If the aggregation has no port it is skipped
-            if(agg_tmp->nb_ports!=0){
-                //Set the oid of status of the port to retrieve
-                for(i=0;i<oid_len_if_oper_status;i++)oid_table_tmp[i] = oid_table_if_oper_status[i];
-                oid_len_tmp = oid_len_if_oper_status;
-                if(last_index<MAX_PORT_AGG)oid_table_tmp[oid_len_tmp++] = agg_tmp->ports[last_index++];
-                
-                //Send the request
-                status = snmpget(session, &response, oid_table_tmp, oid_len_tmp);
-                //If success, analyse the data received
-                if (status == STAT_SUCCESS && response->errstat == SNMP_ERR_NOERROR) {
-                    vars = response->variables;
-                    while(vars !=NULL && finish) {
-                        i = 0;
-                        while(i<oid_len_if_oper_status && finish){
-                            //Compare the oid of the response with the oid to check
-                            //If the subtstree is different, there is an error and the loop is stopped
-                            if(oid_table_tmp[i]!=vars->name[i]){
-                                SET_MSG_RESULT(result, strdup("Unknown error in SNMP session"));
-                                ret = SYSINFO_RET_FAIL;
-                                finish = 0;
-                            }
-                            i++;
-                        }
-                        //If a link is different from UP then one link is down in the aggregation
-                        if(finish && vars->type == ASN_INTEGER && *vars->val.integer!=PORT_UP){
-                            agg_tmp->status = AGG_STATUS_LINK_DOWN;
-                            link_down++; //Use to count the link down in the aggregation
-                        }
-                        vars = vars->next_variable;
-                    }
-                    
-                } else {
-                    //If failure, return the error message
-                    if (status == STAT_SUCCESS){
-                        SET_MSG_RESULT(result, strdup(snmp_errstring(response->errstat)));
-                        ret = SYSINFO_RET_FAIL;
-                    }            }
-                //Free the used structure
-                snmp_free_pdu(response);
-            }
-            //When the status of all the port of the aggregation have been retrieved
-            //the result are analysed to deduce is the aggregation is completly down
-            //Then the next aggregation is load
-            if(finish && agg_tmp->nb_ports<=last_index){
-                if(agg_tmp->nb_ports == link_down && agg_tmp->nb_ports != 0){
-                    agg_tmp->status = AGG_STATUS_DOWN;
-                }
-                link_down = 0;
-                agg_tmp = agg_tmp->next;
-                if(agg_tmp!=NULL)agg_tmp->status = AGG_STATUS_OK; //By default the status of an aggregation is OK
-                last_index = 0;
-            }
-            
-        }
-        
-        /********************************************************************
-         * The last step is to get the description of any aggregation       *
-         * that doesn't have a AGG_STATUS_OK                                *
-         *******************************************************************/
-        agg_tmp = agg;
-        already_written = 0;
-        while (agg_tmp!=NULL && !status && finish) {
-            //Get the description of the aggregation only if not OK
-            if(agg_tmp ->status !=AGG_STATUS_OK){
-                //Set the oid of the description of the interface to retrieved
-                for(i=0;i<oid_len_if_desc;i++)oid_table_tmp[i] = oid_table_if_desc[i];
-                oid_len_tmp = oid_len_if_desc;
-                oid_table_tmp[oid_len_tmp++] = agg_tmp->index;
-                
-                //Send the request
-                status = snmpget(session, &response, oid_table_tmp, oid_len_tmp);
-                if (status == STAT_SUCCESS && response->errstat == SNMP_ERR_NOERROR) {
-                    vars = response->variables;
-                    while(vars !=NULL && finish) {
-                        i = 0;
-                        while(i<oid_len_if_desc && finish){
-                            //Compare the oid of the response with the oid to check
-                            //If the subtstree is different, there is an error and the loop is stopped
-                            if(oid_table_tmp[i]!=vars->name[i]){
-                                SET_MSG_RESULT(result, strdup("Unknown error in SNMP session"));
-                                ret = SYSINFO_RET_FAIL;
-                                finish = 0;
-                            }
-                            i++;
-                        }
-                        if(vars->type == ASN_OCTET_STR & vars->val.string!=NULL && finish){
-                            //Set the result depending on the aggregation status (completely down or partially)
-                            if(agg_tmp->status == AGG_STATUS_DOWN){
-                                if(vars->val_len + len_is_down + len_too_many < MAX_CHAR_RESULT-already_written){
-                                    for(i=0;(i<vars->val_len) && (i + already_written <MAX_CHAR_RESULT);i++){
-                                        tmp_res[i+already_written]=vars->val.string[i];
-                                    }
-                                    already_written = already_written+i;
-                                    tmp_res[already_written++]=' ';
-                                    for(i=0;(i<len_is_down) && (i + already_written <MAX_CHAR_RESULT);i++){
-                                        tmp_res[i+already_written] = msg_is_down[i];
-                                    }
-                                    already_written = already_written+i-1;
-                                }
-                                else
-                                {
-                                    for(i=0;(i<len_too_many) && (i + already_written <MAX_CHAR_RESULT);i++){
-                                        tmp_res[i+already_written] = msg_too_many[i];
-                                    }
-                                    already_written = already_written+i-1;
-                                    finish = 0;
-                                }
-                            }
-                            if(agg_tmp->status == AGG_STATUS_LINK_DOWN){
-                                if(vars->val_len+len_has_link_down+len_too_many<MAX_CHAR_RESULT-already_written){
-                                    if(vars->val_len + len_has_link_down + len_too_many < MAX_CHAR_RESULT-already_written){
-                                        for(i=0;(i<vars->val_len) && (i + already_written <MAX_CHAR_RESULT);i++){
-                                            tmp_res[i+already_written]=vars->val.string[i];
-                                        }
-                                        already_written = already_written+i;
-                                        tmp_res[already_written++]=' ';
-                                        for(i=0;(i<len_has_link_down) && (i + already_written <MAX_CHAR_RESULT);i++){
-                                            tmp_res[i+already_written] = msg_has_link_down[i];
-                                        }
-                                        already_written = already_written+i-1;
-                                    }
-                                    else
-                                    {
-                                        for(i=0;(i<len_too_many) && (i + already_written <MAX_CHAR_RESULT);i++){
-                                            tmp_res[i+already_written] = msg_too_many[i];
-                                        }
-                                        already_written = already_written+i-1;
-                                        finish = 0;
-                                    }
-                                }
-                            }
-                            vars = vars->next_variable;
-                        }
-                    }
-                    
-                } else {
-                    //If failure, return the error message
-                    if (status == STAT_SUCCESS){
-                        SET_MSG_RESULT(result, strdup(snmp_errstring(response->errstat)));
-                        ret = SYSINFO_RET_FAIL;
-                    }
-                }
-                //Free the used structure
-                snmp_free_pdu(response);
-            }
-            agg_tmp = agg_tmp->next;
-        }
-        if(already_written !=0){
-            SET_STR_RESULT(result, strdup(tmp_res));
-            ret = SYSINFO_RET_OK;
-        }
-    }else{
-        ret = SYSINFO_RET_OK;
+    //Get Timeout if provided
+    if(request->nparam >first_optional){
+        timeout = atoi(get_rparam(request, first_optional))*1000000;
     }
-    if(status !=STAT_SUCCESS){
-        
-        if (status == STAT_TIMEOUT){
-            SET_STR_RESULT(result, strdup("Request timeout"));
-            ret = SYSINFO_RET_OK;
-        }else if(status == STAT_ERR_INIT){
-            SET_MSG_RESULT(result, strdup("Error when Initializing SNMP session"));
-            ret = SYSINFO_RET_FAIL;
-        }
-        else{
-            SET_MSG_RESULT(result, strdup("Unknown error in SNMP session"));
-            ret = SYSINFO_RET_FAIL;
-        }
+    //Get Retries if provided
+    if(request->nparam >first_optional+1){
+        retries = atoi(get_rparam(request, first_optional+1));
     }
-    //Free the aggregation structures
-    agg_struct_free(agg);
-    return ret;
+    if(ret != SYSINFO_RET_OK)return ret;
+
+    /****************** Main code ******************/
+    //Init SNMP Session
+    snmp_sess_init(session);
+    session->version = version;
+    session->timeout = timeout;
+    session->retries = retries;
+    session->community = community;
+    session->community_len = community_len;
+    session->peername = ip_address;
+
+    //Init the monitoring of the device
+    monitor_init(MONITOR_IRF, ip_address, result, monitor, arena);
+    monitor->mode = mode;
+    monitor->irf_member = member;
+    return SYSINFO_RET_OK;
 }
 
 /******************************************************************************
  *                                                                            *
- * Function: rrpp_monitoring                                        *
+ * Function: lacp_monitoring                                                  *
  *                                                                            *
- * Purpose: Item to monitor RRPP protocol                                    *
+ * Purpose: Item to monitor lacp protocol                                     *
  *                                                                            *
  * Parameters: request - structure that contains item key and parameters      *
  *              request->key - item key without parameters                    *
@@ -787,44 +1350,112 @@ static int	lacp_monitoring(AGENT_REQUEST *request, AGENT_RESULT *result)
  *              - SNMP read community of the snmp agent                       *
  *              - The timeout request (in second) - 2s by default             *
  *              - The number of retries - 0 by default                        *
- *          The two last parameters are optional                              *
+ *              - The max number of requests of the aggregation walk per      *
+ *                call - 0 by default (the whole walk is done at every call)  *
+ *          The three last parameters are optional                            *
+ *                                                                            *
+ *          When the number of requests is limited, the walk is resumed at    *
+ *          the next call and the aggregations found by the previous walk     *
+ *          are used until the new one is complete. Until the first walk is   *
+ *          complete the item fails with "Aggregation walk in progress"       *
  *                                                                            *
  *          In case of success the result structure will contain              *
  *          the following:                                                    *
  *               - No data if everything is OK                                *
- *               - The name of the rings that have failure                    *
+ *               - The name of the aggregation that are partially or          *
+ *                 totaly down
  *                                                                            *
  *          In case of failure, the result structure will contain an          *
  *          error message                                                     *
  ******************************************************************************/
-static int	rrpp_monitoring(AGENT_REQUEST *request, AGENT_RESULT *result)
+static int	lacp_monitoring(AGENT_REQUEST *request, AGENT_RESULT *result)
 {
-    /****************** Variables ******************/
-    //Structs needed for snmp request
     struct snmp_session session;
-    struct snmp_pdu *response;
-    struct variable_list *vars;
-    oid oid_table_tmp[MAX_OID_LEN];
-    size_t oid_len_tmp = MAX_OID_LEN;
-    
-    
-    //Variables holding oid to check
-    oid oid_table_rrpp_enable[] = {1,3,6,1,4,1,25506,2,45,1,1,0};
-    int oid_len_rrpp_enable = 12 ;
-    
-    oid oid_table_rrpp_ring_status[] = {1,3,6,1,4,1,25506,2,45,2,2,1,2};
-    int oid_len_rrpp_ring_status = 13 ;
-    
-    oid oid_table_rrpp_ring_primary_port[] = {1,3,6,1,4,1,25506,2,45,2,2,1,6};
-    int oid_len_rrpp_ring_primary_port = 13 ;
-    
-    oid oid_table_rrpp_ring_secondary_port[] = {1,3,6,1,4,1,25506,2,45,2,2,1,7};
-    int oid_len_rrpp_ring_secondary_port = 13 ;
-    
-    oid oid_table_if_oper_status[] = {1,3,6,1,2,1,2,2,1,8};
-    int oid_len_if_oper_status = 10 ;
-    
-    
+    monitor_t monitor;
+    arena_t *arena = arena_acquire();
+
+    if(lacp_monitoring_init(request, result, &session, &monitor, arena) != SYSINFO_RET_OK){
+        arena_release(arena);
+        return SYSINFO_RET_FAIL;
+    }
+
+    //Run the monitoring until all the requests have been answered
+    monitor_run(session, &monitor);
+    arena_release(arena);
+    return monitor.ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: lacp_discovery                                                   *
+ *                                                                            *
+ * Purpose: Item to discover the aggregations of a switch                     *
+ *                                                                            *
+ * Parameters: request - structure that contains item key and parameters      *
+ *             result - structure that will contain result                    *
+ *                                                                            *
+ * Return value: SYSINFO_RET_FAIL - function failed, item will be marked      *
+ *                                 as not supported by zabbix                 *
+ *               SYSINFO_RET_OK - success                                     *
+ *                                                                            *
+ * Comment: The parameters of the request are (in order):                     *
+ *              - IP address of the snmp agent                                *
+ *              - SNMP read community of the snmp agent                       *
+ *              - The timeout request (in second) - 2s by default             *
+ *              - The number of retries - 0 by default                        *
+ *          The two last parameters are optional                              *
+ *                                                                            *
+ *          In case of success the result structure will contain the low      *
+ *          level discovery JSON of the aggregations with the macros          *
+ *          {#AGGINDEX}, {#AGGNAME} and {#MEMBERS} (the ifIndex of the ports  *
+ *          separated by commas)                                              *
+ *                                                                            *
+ *          The aggregations found by the last complete walk of the lacp      *
+ *          monitoring of the switch are used, the aggregations are only      *
+ *          walked when there is none                                         *
+ ******************************************************************************/
+static int	lacp_discovery(AGENT_REQUEST *request, AGENT_RESULT *result)
+{
+    struct snmp_session session;
+    monitor_t monitor;
+    arena_t *arena = arena_acquire();
+
+    if(request->nparam >4){
+        SET_MSG_RESULT(result, strdup("Too many parameters"));
+        arena_release(arena);
+        return SYSINFO_RET_FAIL;
+    }
+    if(lacp_monitoring_init(request, result, &session, &monitor, arena) != SYSINFO_RET_OK){
+        arena_release(arena);
+        return SYSINFO_RET_FAIL;
+    }
+    monitor.mode = MONITOR_MODE_DISCOVERY;
+
+    //Run the monitoring until all the requests have been answered
+    monitor_run(session, &monitor);
+    arena_release(arena);
+    return monitor.ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: lacp_monitoring_init                                             *
+ *                                                                            *
+ * Purpose: Check the parameters of monitor.lacp and init its monitoring      *
+ *                                                                            *
+ * Parameters: request - structure that contains item key and parameters      *
+ *             result - structure that will contain the error message         *
+ *             session - the struct snmp_session to init                      *
+ *             monitor - the monitor_t to init                                *
+ *             arena - the arena of the transient data of the monitoring      *
+ *                                                                            *
+ * Return value: SYSINFO_RET_FAIL - the parameters are invalid                *
+ *               SYSINFO_RET_OK - the monitoring can be run                   *
+ *                                                                            *
+ ******************************************************************************/
+static int lacp_monitoring_init(AGENT_REQUEST *request, AGENT_RESULT *result, struct snmp_session *session, monitor_t *monitor, arena_t *arena)
+{
+    /****************** Variables ******************/
     //Parameters (Not mandatory parameters are initialised)
     long version = SNMP_VERSION_2c;
     long timeout = 2000000;
@@ -832,31 +1463,13 @@ static int	rrpp_monitoring(AGENT_REQUEST *request, AGENT_RESULT *result)
     char *community;
     size_t community_len;
     char *ip_address;
-    
-    //Aggregation structure variable
-    rrpp_struct_t * rrpp = NULL;
-    rrpp_struct_t * rrpp_tmp = NULL;
-    short last_domain;
-    short last_ring;
-    short current_port;
-    
-    
+    int walk_max_pdus = 0;
+
+
     //Other Variables
-    short status;
-    short finish;
-    short rings_enabled = 0;
-    short ret = SYSINFO_RET_FAIL;
-    short already_written;
-    char tmp_res[MAX_CHAR_RESULT];
-    char msg_ring_failed[31]="Ring    in domain    is failed\n";
-    short len_ring_failed = 31;
-    short pos_ring = 5;
-    short pos_domain = 19;
-    char msg_buf[2];
-    char msg_too_many[18]="Too many results\n";
-    short len_too_many = 18;
-    int i;
-    
+    int ret = SYSINFO_RET_OK;
+
+
     /****************** Get parameters ******************/
     //Get parameters
     if(request->nparam <2){     //Check if mandatory parameters are provided
@@ -864,873 +1477,6217 @@ static int	rrpp_monitoring(AGENT_REQUEST *request, AGENT_RESULT *result)
         ret =  SYSINFO_RET_FAIL;
     }
     ip_address = get_rparam(request, 0);
-    
+
     if(is_valid_ip(ip_address)){
         SET_MSG_RESULT(result, strdup("Invalid IP Address"));
         ret = SYSINFO_RET_FAIL;
     }
-    
+
     community = get_rparam(request, 1);
     community_len = strlen(community);
-    
+
     if(request->nparam >2){
         timeout = atoi(get_rparam(request, 2))*1000000;
     }
     if(request->nparam >3){
         retries = atoi(get_rparam(request, 3));
     }
-    
-    /****************** Main code ******************/
-    //Init SNMP Session
-    snmp_sess_init(&session);
-    session.version = version;
-    session.timeout = timeout;
-    session.retries = retries;
-    session.community = community;
-    session.community_len = community_len;
-    session.peername = ip_address;
-    
-    /********************************************************************
-     * The first step is to check if the switch has RRPP enable.        *
-     *******************************************************************/
-    finish = 1;
-    status = STAT_SUCCESS;
-    //Send the request
-    status = snmpget(session, &response, oid_table_rrpp_enable, oid_len_rrpp_enable);
-    
-    //If success, analyse the data received
-    if (status == STAT_SUCCESS && response->errstat == SNMP_ERR_NOERROR) {
-        vars = response->variables;
-        i=0;
-        while(i<oid_len_rrpp_enable && finish){
-            //Compare the oid of the response with the oid to check
-            //If the subtstree is different, there is an error and the loop is stopped
-            if(oid_table_rrpp_enable[i]!=vars->name[i]){
-                SET_MSG_RESULT(result, strdup("Unknown error in SNMP session"));
-                ret = SYSINFO_RET_FAIL;
-                finish = 0;
-            }
-            i++;
-        }
-        if(vars->type !=ASN_INTEGER){
-            SET_MSG_RESULT(result, strdup("Unknown error in SNMP session"));
-            ret = SYSINFO_RET_FAIL;
-            finish = 0;
-        }
-        else if(*vars->val.integer==2){
-            finish = 0;
-            ret = SYSINFO_RET_OK;
-        }
-    } else {
-        //If failure, return the error message
-        if (status == STAT_SUCCESS){
-            SET_MSG_RESULT(result, strdup(snmp_errstring(response->errstat)));
+    if(request->nparam >4){
+        walk_max_pdus = atoi(get_rparam(request, 4));
+        if(walk_max_pdus<0){
+            SET_MSG_RESULT(result, strdup("Invalid number of walk requests"));
             ret = SYSINFO_RET_FAIL;
         }
     }
-    //Free the used structure
-    snmp_free_pdu(response);
-    
-    
-    /********************************************************************
-     * If the switch has no rrpp enable configured then it is not       *
-     * needed to continue.                                              *
-     * If it has rrpp enable then man need to get all the domain and    *
-     * enabled rings                                                    *
-     *******************************************************************/
-    if(finish && !status){
-        //Init the differents variables used for this step
-        for(i=0;i<oid_len_rrpp_ring_status;i++)oid_table_tmp[i] = oid_table_rrpp_ring_status[i];
-        oid_len_tmp = oid_len_rrpp_ring_status;
-        finish = 1;
-        last_domain = 0;
-        last_ring = 0;
-        while(finish & !status){
-            //If more than one bulkrequest is necessery to get the all subtree
-            //then the next node to start the second request is the last domain and ring retrieved
-            oid_len_tmp = oid_len_rrpp_ring_status;
-            if(last_domain !=0 && last_ring !=0){
-                oid_table_tmp[oid_len_tmp++]=last_domain;
-                oid_table_tmp[oid_len_tmp++]=last_ring;
-            }
-            //Send the request
-            status = snmpbulkget(session, &response, oid_table_tmp, oid_len_tmp, MAX_BULK_REPETITION);
-            //If success, analyse the data received
-            if (status == STAT_SUCCESS && response->errstat == SNMP_ERR_NOERROR) {
-                vars = response->variables;
-                while(vars !=NULL && finish){
-                    i = 0;
-                    while(i<oid_len_rrpp_ring_status && finish){
-                        //Compare the oid of the response with the oid to check
-                        //If the subtstree is different then the loop stop
-                        if(oid_table_rrpp_ring_status[i]!=vars->name[i]){
-                            finish=0;
-                        }
-                        i++;
-                    }
-                    //If it the same oid, check the value
-                    if(finish){
-                        last_domain = vars->name[i];
-                        last_ring = vars->name[i+1];
-                        //Save the ring if it is enable
-                        if(vars->type == ASN_INTEGER && *vars->val.integer == 1){
-                            rrpp_tmp = rrpp_struct_add(last_domain, last_ring, &rrpp);
-                            rings_enabled = 1;
-                        }
-                    }
-                    vars = vars->next_variable;
-                }
-            } else {
-                //If failure, return the error message
-                if (status == STAT_SUCCESS){
-                    SET_MSG_RESULT(result, strdup(snmp_errstring(response->errstat)));
-                    ret = SYSINFO_RET_FAIL;
-                }
-                
-            }
-            //Free the used structure
-            snmp_free_pdu(response);
-        }
-        /*******************************************************************
-         * The next step is to get the primary port of every enabled ring *
-         *******************************************************************/
-        for(i=0;i<oid_len_rrpp_ring_primary_port;i++)oid_table_tmp[i] = oid_table_rrpp_ring_primary_port[i];
-        oid_len_tmp = oid_len_rrpp_ring_primary_port;
-        finish = 1;
-        last_domain = 0;
-        last_ring = 0;
-        while(finish & !status && rings_enabled){
-            //If more than one bulkrequest is necessery to get the all subtree
-            //then the next node to start the second request is the last domain and ring retrieved
-            oid_len_tmp = oid_len_rrpp_ring_primary_port;
-            if(last_domain !=0 && last_ring !=0){
-                oid_table_tmp[oid_len_tmp++]=last_domain;
-                oid_table_tmp[oid_len_tmp++]=last_ring;
-            }
-            //Send the request
-            status = snmpbulkget(session, &response, oid_table_tmp, oid_len_tmp, MAX_BULK_REPETITION);
-            //If success, analyse the data received
-            if (status == STAT_SUCCESS && response->errstat == SNMP_ERR_NOERROR) {
-                vars = response->variables;
-                while(vars !=NULL && finish){
-                    i = 0;
-                    while(i<oid_len_rrpp_ring_primary_port && finish){
-                        //Compare the oid of the response with the oid to check
-                        //If the subtstree is different then the loop stop
-                        if(oid_table_rrpp_ring_primary_port[i]!=vars->name[i]){
-                            finish=0;
-                        }
-                        i++;
-                    }
-                    //If it the same oid, check the value
-                    if(finish){
-                        last_domain = vars->name[i];
-                        last_ring = vars->name[i+1];
-                        //Save the primary-port index
-                        if(vars->type == ASN_INTEGER ){
-                            rrpp_tmp = rrpp_struct_exist(last_domain, last_ring, rrpp);
-                            if(rrpp_tmp!=NULL)rrpp_struct_set_port(*vars->val.integer, RRPP_PRIMARY_PORT, rrpp_tmp);
-                        }
-                    }
-                    vars = vars->next_variable;
-                }
-            } else {
-                //If failure, return the error message
-                if (status == STAT_SUCCESS){
-                    SET_MSG_RESULT(result, strdup(snmp_errstring(response->errstat)));
-                    ret = SYSINFO_RET_FAIL;
-                }
-                
-            }
-            //Free the used structure
-            snmp_free_pdu(response);
-            
-        }
-        
-        /*******************************************************************
-         * The next step is to get the secondary port of every enable ring *
-         *******************************************************************/
-        for(i=0;i<oid_len_rrpp_ring_secondary_port;i++)oid_table_tmp[i] = oid_table_rrpp_ring_secondary_port[i];
-        oid_len_tmp = oid_len_rrpp_ring_secondary_port;
-        finish = 1;
-        last_domain = 0;
-        last_ring = 0;
-        while(rings_enabled && finish & !status ){
-            //If more than one bulkrequest is necessery to get the all subtree
-            //then the next node to start the second request is the last domain and ring retrieved
-            oid_len_tmp = oid_len_rrpp_ring_secondary_port;
-            if(last_domain !=0 && last_ring !=0){
-                oid_table_tmp[oid_len_tmp++]=last_domain;
-                oid_table_tmp[oid_len_tmp++]=last_ring;
-            }
-            //Send the request
-            status = snmpbulkget(session, &response, oid_table_tmp, oid_len_tmp, MAX_BULK_REPETITION);
-            //If success, analyse the data received
-            if (status == STAT_SUCCESS && response->errstat == SNMP_ERR_NOERROR) {
-                vars = response->variables;
-                while(vars !=NULL && finish){
-                    i = 0;
-                    while(i<oid_len_rrpp_ring_secondary_port && finish){
-                        //Compare the oid of the response with the oid to check
-                        //If the subtstree is different then the loop stop
-                        if(oid_table_rrpp_ring_secondary_port[i]!=vars->name[i]){
-                            finish=0;
-                        }
-                        i++;
-                    }
-                    //If it the same oid, check the value
-                    if(finish){
-                        last_domain = vars->name[i];
-                        last_ring = vars->name[i+1];
-                        //Save the secondary-port index
-                        if(vars->type == ASN_INTEGER ){
-                            rrpp_tmp = rrpp_struct_exist(last_domain, last_ring, rrpp);
-                            if(rrpp_tmp!=NULL)rrpp_struct_set_port(*vars->val.integer, RRPP_SECONDARY_PORT, rrpp_tmp);
-                        }
-                    }
-                    vars = vars->next_variable;
-                }
-            } else {
-                //If failure, return the error message
-                if (status == STAT_SUCCESS){
-                    SET_MSG_RESULT(result, strdup(snmp_errstring(response->errstat)));
-                    ret = SYSINFO_RET_FAIL;
-                }
-                
-            }
-            //Free the used structure
-            snmp_free_pdu(response);
-        }
-        
-        /********************************************************************
-         * The next step is to get the status of every primary and          *
-         * secondary port                                                   *
-         *******************************************************************/
-        rrpp_tmp = rrpp;
-        finish = 1;
-        current_port = RRPP_PRIMARY_PORT;
-        while(finish && !status && rings_enabled && rrpp_tmp !=NULL){
-            //If the port of the ring has 0 as index it is skipped
-            if(rrpp_struct_get_port(current_port, rrpp_tmp)!=0){
-                //Set the oid of status of the port to retrieve
-                for(i=0;i<oid_len_if_oper_status;i++)oid_table_tmp[i] = oid_table_if_oper_status[i];
-                oid_len_tmp = oid_len_if_oper_status;
-                oid_table_tmp[oid_len_tmp++] = rrpp_struct_get_port(current_port, rrpp_tmp);
-                
-                //Send the request
-                status = snmpget(session, &response, oid_table_tmp, oid_len_tmp);
-                //If success, analyse the data received
-                if (status == STAT_SUCCESS && response->errstat == SNMP_ERR_NOERROR) {
-                    vars = response->variables;
-                    i = 0;
-                    while(i<oid_len_if_oper_status && finish){
-                        //Compare the oid of the response with the oid to check
-                        //If the subtstree is different, there is an error and the loop is stopped
-                        if(oid_table_tmp[i]!=vars->name[i]){
-                            SET_MSG_RESULT(result, strdup("Unknown error in SNMP session"));
-                            ret = SYSINFO_RET_FAIL;
-                            finish = 0;
-                        }
-                        i++;
-                    }
-                    //Set the port status
-                    if(finish && vars->type == ASN_INTEGER){
-                        if(*vars->val.integer == PORT_UP){
-                            rrpp_struct_set_port_status(PORT_UP, current_port, rrpp_tmp);
-                        }else{
-                            rrpp_struct_set_port_status(PORT_DOWN, current_port, rrpp_tmp);
-                        }
-                    }
-                } else {
-                    //If failure, return the error message
-                    if (status == STAT_SUCCESS){
-                        SET_MSG_RESULT(result, strdup(snmp_errstring(response->errstat)));
-                        ret = SYSINFO_RET_FAIL;
-                    }            }
-                //Free the used structure
-                snmp_free_pdu(response);
-            }
-            else{
-                //If the index of the port is 0 then is status is set to UP
-                rrpp_struct_set_port_status(PORT_UP, current_port, rrpp_tmp);
-            }
-            //Set the index of the next port to retrieved
-            if(finish){
-                if(current_port == RRPP_PRIMARY_PORT){
-                    current_port = RRPP_SECONDARY_PORT;
-                }
-                //When the status of all the primary and the secondary ports have been retrieved
-                //the the next ring is load
-                else{
-                    current_port = RRPP_PRIMARY_PORT;
-                    rrpp_tmp = rrpp_tmp->next;
-                }
-            }
-        }
-        
-        /********************************************************************
-         * The last step is to deduce the state of every ring               *
-         *******************************************************************/
-        rrpp_tmp = rrpp;
-        already_written = 0;
-        while (rings_enabled && !status && finish && rrpp_tmp!=NULL ){
-            if(rrpp_struct_get_port_status(RRPP_PRIMARY_PORT, rrpp_tmp)== PORT_DOWN || rrpp_struct_get_port_status(RRPP_SECONDARY_PORT, rrpp_tmp)==PORT_DOWN){
-                if(len_ring_failed + len_too_many<MAX_CHAR_RESULT-already_written){
-                    for(i=0;(i<len_ring_failed) && (i + already_written <MAX_CHAR_RESULT);i++){
-                        tmp_res[i+already_written] = msg_ring_failed[i];
-                    }
-                    if(rrpp_tmp->domain<100 && rrpp_tmp->domain>0){
-                        msg_buf[0] = ' '; msg_buf[1] = ' ';
-                        itoa(rrpp_tmp->domain,msg_buf);
-                        tmp_res[pos_domain+already_written] = msg_buf[0];
-                        tmp_res[pos_domain+1+already_written] = msg_buf[1];
-                    }
-                    if(rrpp_tmp->ring<100 && rrpp_tmp->ring>0 ){
-                        msg_buf[0] = ' '; msg_buf[1] = ' ';
-                        itoa(rrpp_tmp->ring,msg_buf);
-                        tmp_res[pos_ring+already_written] = msg_buf[0];
-                        tmp_res[pos_ring+1+already_written] = msg_buf[1];
-                    }
-                    already_written = already_written+i;
-                    
-                }
-                else{
-                    for(i=0;(i<len_too_many) && (i + already_written <MAX_CHAR_RESULT);i++){
-                        tmp_res[i+already_written] = msg_too_many[i];
-                    }
-                    already_written = already_written+i-1;
-                    finish = 0;
-                }
-                
-            }
-            rrpp_tmp = rrpp_tmp->next;
-        }
-        if(already_written !=0){
-            SET_STR_RESULT(result, strdup(tmp_res));
+    if(ret != SYSINFO_RET_OK)return ret;
+
+    /****************** Main code ******************/
+    //Init SNMP Session
+    snmp_sess_init(session);
+    session->version = version;
+    session->timeout = timeout;
+    session->retries = retries;
+    session->community = community;
+    session->community_len = community_len;
+    session->peername = ip_address;
+
+    //The walk kept by the device is used so the aggregations found are cached for the next calls
+    //In incremental mode the walk is resumed at the next call
+    //If another thread is polling the same device, a whole walk is done instead
+    monitor_init(MONITOR_LACP, ip_address, result, monitor, arena);
+    if(device_lacp_acquire(monitor->device)){
+        monitor->lacp_walk = &monitor->device->lacp_walk;
+        monitor->walk_max_pdus = walk_max_pdus;
+    }
+
+    return SYSINFO_RET_OK;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: lacp_agg_monitoring                                              *
+ *                                                                            *
+ * Purpose: Item to monitor a single aggregation of a switch                  *
+ *                                                                            *
+ * Parameters: request - structure that contains item key and parameters      *
+ *             result - structure that will contain result                    *
+ *                                                                            *
+ * Return value: SYSINFO_RET_FAIL - function failed, item will be marked      *
+ *                                 as not supported by zabbix                 *
+ *               SYSINFO_RET_OK - success                                     *
+ *                                                                            *
+ * Comment: The parameters of the request are (in order):                     *
+ *              - IP address of the snmp agent                                *
+ *              - SNMP read community of the snmp agent                       *
+ *              - The ifIndex of the aggregation ({#AGGINDEX})                *
+ *              - The timeout request (in second) - 2s by default             *
+ *              - The number of retries - 0 by default                        *
+ *          The two last parameters are optional                              *
+ *                                                                            *
+ *          In case of success the result structure will contain an integer:  *
+ *               - 0 (AGG_STATUS_OK) if all the ports are up                  *
+ *               - 1 (AGG_STATUS_LINK_DOWN) if some ports are down            *
+ *               - 2 (AGG_STATUS_DOWN) if all the ports are down              *
+ *                                                                            *
+ *          The status of the aggregations of a switch is evaluated once for  *
+ *          all its items, then kept for IF_STATUS_MAX_AGE seconds. The       *
+ *          aggregations cached by the device are used while they are younger *
+ *          than AGG_TOPOLOGY_MAX_AGE seconds                                 *
+ ******************************************************************************/
+static int	lacp_agg_monitoring(AGENT_REQUEST *request, AGENT_RESULT *result)
+{
+    struct snmp_session session;
+    monitor_t monitor;
+    arena_t *arena = arena_acquire();
+
+    if(lacp_agg_monitoring_init(request, result, &session, &monitor, arena) != SYSINFO_RET_OK){
+        arena_release(arena);
+        return SYSINFO_RET_FAIL;
+    }
+
+    //Run the monitoring until all the requests have been answered
+    monitor_run(session, &monitor);
+    arena_release(arena);
+    return monitor.ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: lacp_agg_monitoring_init                                         *
+ *                                                                            *
+ * Purpose: Check the parameters of monitor.lacp.agg and init its monitoring  *
+ *                                                                            *
+ * Parameters: request - structure that contains item key and parameters      *
+ *             result - structure that will contain the error message         *
+ *             session - the struct snmp_session to init                      *
+ *             monitor - the monitor_t to init                                *
+ *             arena - the arena of the transient data of the monitoring      *
+ *                                                                            *
+ * Return value: SYSINFO_RET_FAIL - the parameters are invalid                *
+ *               SYSINFO_RET_OK - the monitoring can be run                   *
+ *                                                                            *
+ ******************************************************************************/
+static int lacp_agg_monitoring_init(AGENT_REQUEST *request, AGENT_RESULT *result, struct snmp_session *session, monitor_t *monitor, arena_t *arena)
+{
+    /****************** Variables ******************/
+    //Parameters (Not mandatory parameters are initialised)
+    long version = SNMP_VERSION_2c;
+    long timeout = 2000000;
+    int retries = 0;
+    char *community;
+    size_t community_len;
+    char *ip_address;
+    long agg_index;
+
+
+    //Other Variables
+    int ret = SYSINFO_RET_OK;
+
+
+    /****************** Get parameters ******************/
+    //Get parameters
+    if(request->nparam <3){     //Check if mandatory parameters are provided
+        SET_MSG_RESULT(result, strdup("Parameters Missing"));
+        return SYSINFO_RET_FAIL;
+    }
+    if(request->nparam >5){
+        SET_MSG_RESULT(result, strdup("Too many parameters"));
+        return SYSINFO_RET_FAIL;
+    }
+    ip_address = get_rparam(request, 0);
+
+    if(is_valid_ip(ip_address)){
+        SET_MSG_RESULT(result, strdup("Invalid IP Address"));
+        ret = SYSINFO_RET_FAIL;
+    }
+
+    community = get_rparam(request, 1);
+    community_len = strlen(community);
+
+    agg_index = atol(get_rparam(request, 2));
+    if(agg_index<1){
+        SET_MSG_RESULT(result, strdup("Invalid aggregation index"));
+        ret = SYSINFO_RET_FAIL;
+    }
+    if(request->nparam >3){
+        timeout = atoi(get_rparam(request, 3))*1000000;
+    }
+    if(request->nparam >4){
+        retries = atoi(get_rparam(request, 4));
+    }
+    if(ret != SYSINFO_RET_OK)return ret;
+
+    /****************** Main code ******************/
+    //Init SNMP Session
+    snmp_sess_init(session);
+    session->version = version;
+    session->timeout = timeout;
+    session->retries = retries;
+    session->community = community;
+    session->community_len = community_len;
+    session->peername = ip_address;
+
+    //The aggregations and their status are shared with the other lacp items of the device
+    //If another thread is polling the same device, a whole walk is done instead
+    monitor_init(MONITOR_LACP, ip_address, result, monitor, arena);
+    monitor->mode = MONITOR_MODE_ENTITY;
+    monitor->agg_index = agg_index;
+    if(device_lacp_acquire(monitor->device)){
+        monitor->lacp_walk = &monitor->device->lacp_walk;
+    }
+
+    return SYSINFO_RET_OK;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: lacp_count_monitoring                                            *
+ *                                                                            *
+ * Purpose: Item to count the aggregations of a switch in a given state       *
+ *                                                                            *
+ * Parameters: request - structure that contains item key and parameters      *
+ *             result - structure that will contain result                    *
+ *                                                                            *
+ * Return value: SYSINFO_RET_FAIL - function failed, item will be marked      *
+ *                                 as not supported by zabbix                 *
+ *               SYSINFO_RET_OK - success                                     *
+ *                                                                            *
+ * Comment: The parameters of the request are (in order):                     *
+ *              - IP address of the snmp agent                                *
+ *              - SNMP read community of the snmp agent                       *
+ *              - The state counted:                                          *
+ *                  - down - the aggregations with all their ports down       *
+ *                  - degraded - the aggregations with some ports down        *
+ *              - The timeout request (in second) - 2s by default             *
+ *              - The number of retries - 0 by default                        *
+ *          The two last parameters are optional                              *
+ *                                                                            *
+ *          In case of success the result structure will contain the number   *
+ *          of aggregations in the state. It is computed from the same        *
+ *          evaluation as monitor.lacp.agg                                    *
+ ******************************************************************************/
+static int	lacp_count_monitoring(AGENT_REQUEST *request, AGENT_RESULT *result)
+{
+    struct snmp_session session;
+    monitor_t monitor;
+    arena_t *arena = arena_acquire();
+
+    if(count_monitoring_init(request, result, &session, &monitor, arena, MONITOR_LACP, MONITOR_MODE_COUNT) != SYSINFO_RET_OK){
+        arena_release(arena);
+        return SYSINFO_RET_FAIL;
+    }
+
+    //Run the monitoring until all the requests have been answered
+    monitor_run(session, &monitor);
+    arena_release(arena);
+    return monitor.ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: lacp_monitor_next                                                *
+ *                                                                            *
+ * Purpose: Prepare the next request of the lacp monitoring                   *
+ *                                                                            *
+ * Parameters: monitor - A monitor_t pointer                                  *
+ *                                                                            *
+ * Comment: The monitoring is finished when no request is prepared            *
+ ******************************************************************************/
+static void lacp_monitor_next(monitor_t *monitor){
+    //Variables holding oid to check
+    oid oid_table_if_desc[] = {1,3,6,1,2,1,2,2,1,2};
+    int oid_len_if_desc = 10 ;
+
+    device_struct_t *device = monitor->device;
+    agg_struct_t *agg_tmp;
+    zbx_uint64_t nb;
+    short walk;
+    int i;
+
+    while(monitor->pdu == NULL && monitor->phase != MONITOR_PHASE_DONE){
+        switch(monitor->phase){
+            /********************************************************************
+             * The first step is to get the aggregations of the switch and the  *
+             * ports attached to them.                                          *
+             * In incremental mode, only a part of the walk is done at each     *
+             * call and the topology of the previous walk is used until the     *
+             * new one is complete.                                             *
+             *******************************************************************/
+            case LACP_PHASE_WALK:
+                walk = monitor->lacp_walk->phase != LACP_WALK_DONE && (monitor->walk_max_pdus == 0 || monitor->walk_pdus < monitor->walk_max_pdus);
+                //The discovery and the aggregation items use the aggregations cached by the device while they are recent
+                if(monitor->mode != MONITOR_MODE_STATUS && monitor->lacp_walk != &monitor->walk && device->agg_discovered && time(NULL) - device->agg_time < AGG_TOPOLOGY_MAX_AGE)walk = 0;
+                if(monitor->mode != MONITOR_MODE_STATUS && monitor->lacp_walk != &monitor->walk && monitor->walk_pdus == 0)stats_cache(STATS_CACHE_AGG, !walk);
+                if(walk){
+                    lacp_walk_request(monitor);
+                    monitor->walk_pdus++;
+                    break;
+                }
+                if(monitor->lacp_walk == &monitor->walk){
+                    monitor->agg = monitor->walk.agg;
+                }else{
+                    if(device->lacp_walk.phase == LACP_WALK_DONE){
+                        //Swap the cached topology with the new one, the previous one is reused by the next walk
+                        agg_table_reset(device->agg);
+                        agg_table_free(device->lacp_walk.spare);
+                        device->lacp_walk.spare = device->agg;
+                        device->agg = device->lacp_walk.agg;
+                        device->agg_discovered = 1;
+                        device->agg_time = time(NULL);
+                        device->agg_eval_time = 0;
+                        lacp_walk_init(&device->lacp_walk);
+                    }
+                    monitor->agg = device->agg;
+                    //Until the first walk is complete the aggregations are not known, so no value can be returned
+                    if(!device->agg_discovered){
+                        zabbix_log(LOG_LEVEL_DEBUG, "zbxmodHP: %s first aggregation walk in progress", device->ip_address);
+                        monitor_fail(monitor, "Aggregation walk in progress");
+                        break;
+                    }
+                }
+
+                if(monitor->mode == MONITOR_MODE_DISCOVERY){
+                    monitor->agg_pos = 0;
+                    monitor->phase = LACP_PHASE_DISCOVERY;
+                    break;
+                }
+                if(monitor->mode == MONITOR_MODE_ENTITY || monitor->mode == MONITOR_MODE_COUNT || monitor->mode == MONITOR_MODE_FLAPS){
+                    monitor->phase = LACP_PHASE_AGG;
+                    break;
+                }
+
+                /********************************************************************
+                 * If the switch has no aggregation configured then it is not       *
+                 * needed to continue.                                              *
+                 *******************************************************************/
+                if(agg_table_next(monitor->agg, NULL) == NULL){
+                    monitor_finish(monitor);
+                    break;
+                }
+                monitor->phase = LACP_PHASE_PORT_STATUS;
+                break;
+
+            /********************************************************************
+             * The next step is to get the status of every interface of the     *
+             * switch and deduce the state of all the aggregations from the     *
+             * status of their ports                                            *
+             *******************************************************************/
+            case LACP_PHASE_PORT_STATUS:
+                if(monitor_if_status_next(monitor))break;
+                if(agg_table_eval_status(monitor->agg, monitor->if_status, monitor->arena) != SUCCEED){
+                    monitor_fail(monitor, "Cannot allocate memory");
+                    break;
+                }
+                //The status of the aggregations cached by the device is kept as long as the bitmap
+                if(monitor->lacp_walk != &monitor->walk)device->agg_eval_time = monitor->if_status->time;
+                device_lacp_flaps_update(device, monitor->agg, monitor->if_status);
+                if(monitor->mode != MONITOR_MODE_STATUS){
+                    monitor->phase = LACP_PHASE_AGG;
+                    break;
+                }
+                monitor->agg_tmp = agg_table_next(monitor->agg, NULL);
+                monitor->phase = LACP_PHASE_IF_DESC;
+                break;
+
+            /********************************************************************
+             * The last step is to get the description of any aggregation       *
+             * that doesn't have a AGG_STATUS_OK                                *
+             *******************************************************************/
+            case LACP_PHASE_IF_DESC:
+                while(monitor->agg_tmp != NULL && monitor->agg_tmp->status == AGG_STATUS_OK){
+                    monitor->agg_tmp = agg_table_next(monitor->agg, monitor->agg_tmp);
+                }
+                if(monitor->agg_tmp == NULL){
+                    text_struct_set_result(&monitor->text, monitor->result);
+                    monitor_finish(monitor);
+                    break;
+                }
+                //Set the oid of the description of the interface to retrieved
+                for(i=0;i<oid_len_if_desc;i++)monitor->oid_table_tmp[i] = oid_table_if_desc[i];
+                monitor->oid_len_tmp = oid_len_if_desc;
+                monitor->oid_table_tmp[monitor->oid_len_tmp++] = monitor->agg_tmp->index;
+                monitor_request_get(monitor);
+                break;
+
+            /********************************************************************
+             * For the discovery, the description of all the aggregations is    *
+             * retrieved, several aggregations at a time                        *
+             *******************************************************************/
+            case LACP_PHASE_DISCOVERY:
+                if(monitor->agg == NULL || monitor->agg_pos >= monitor->agg->nb_aggs){
+                    lacp_discovery_result(monitor);
+                    monitor_finish(monitor);
+                    break;
+                }
+                if(monitor->agg_names == NULL){
+                    monitor->agg_names = (char **)arena_alloc(monitor->arena, sizeof(char *)*monitor->agg->nb_aggs);
+                    if(monitor->agg_names == NULL){
+                        monitor_fail(monitor, "Cannot allocate memory");
+                        break;
+                    }
+                    memset(monitor->agg_names, 0, sizeof(char *)*monitor->agg->nb_aggs);
+                }
+                monitor->pdu = snmp_pdu_create(SNMP_MSG_GET);
+                monitor->pdu_no_retry = 0;
+                for(i=0;i<oid_len_if_desc;i++)monitor->oid_table_tmp[i] = oid_table_if_desc[i];
+                monitor->oid_len_tmp = oid_len_if_desc+1;
+                for(i=monitor->agg_pos;i<monitor->agg->nb_aggs && i<monitor->agg_pos+MAX_GET_VARS;i++){
+                    monitor->oid_table_tmp[oid_len_if_desc] = monitor->agg->aggs[i].index;
+                    snmp_add_null_var(monitor->pdu, monitor->oid_table_tmp, monitor->oid_len_tmp);
+                }
+                break;
+
+            /********************************************************************
+             * For a single aggregation, a count or the flaps, the status of    *
+             * the aggregations is the one evaluated for the device if it is    *
+             * recent enough                                                    *
+             *******************************************************************/
+            case LACP_PHASE_AGG:
+                if(monitor->mode == MONITOR_MODE_ENTITY){
+                    monitor->agg_tmp = agg_table_exist(monitor->agg_index, monitor->agg);
+                    if(monitor->agg_tmp == NULL){
+                        monitor_fail(monitor, "Unknown aggregation");
+                        break;
+                    }
+                }
+                if(monitor->if_status == NULL && agg_table_next(monitor->agg, NULL) != NULL && (monitor->lacp_walk == &monitor->walk || device->agg_eval_time == 0 || time(NULL) - device->agg_eval_time >= IF_STATUS_MAX_AGE)){
+                    monitor->phase = LACP_PHASE_PORT_STATUS;
+                    break;
+                }
+                if(monitor->mode == MONITOR_MODE_ENTITY){
+                    SET_UI64_RESULT(monitor->result, monitor->agg_tmp->status);
+                    monitor_finish(monitor);
+                    break;
+                }
+                if(monitor->mode == MONITOR_MODE_FLAPS){
+                    SET_UI64_RESULT(monitor->result, device_lacp_flaps_count(device, monitor->agg, monitor->flap_window));
+                    monitor_finish(monitor);
+                    break;
+                }
+                nb = 0;
+                for(agg_tmp = agg_table_next(monitor->agg, NULL); agg_tmp != NULL; agg_tmp = agg_table_next(monitor->agg, agg_tmp)){
+                    if(agg_tmp->status == (monitor->count_state == COUNT_STATE_DOWN ? AGG_STATUS_DOWN : AGG_STATUS_LINK_DOWN))nb++;
+                }
+                SET_UI64_RESULT(monitor->result, nb);
+                monitor_finish(monitor);
+                break;
+
+            default:
+                monitor_finish(monitor);
+                break;
+        }
+    }
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: lacp_monitor_step                                                *
+ *                                                                            *
+ * Purpose: Analyse the response of the last request of the lacp monitoring   *
+ *          and prepare the next one                                          *
+ *                                                                            *
+ * Parameters: monitor - A monitor_t pointer                                  *
+ *             response - the response of the last request                    *
+ *                                                                            *
+ ******************************************************************************/
+static void lacp_monitor_step(monitor_t *monitor, struct snmp_pdu *response){
+    struct variable_list *vars;
+    agg_struct_t *agg_tmp;
+    const char *msg;
+    char *name;
+
+    switch(monitor->phase){
+        case LACP_PHASE_WALK:
+            lacp_walk_response(monitor, response);
+            break;
+
+        case LACP_PHASE_PORT_STATUS:
+            monitor_if_status_step(monitor, response);
+            break;
+
+        case LACP_PHASE_IF_DESC:
+            //Set the result depending on the aggregation status (completely down or partially)
+            if(monitor->agg_tmp->status == AGG_STATUS_DOWN){
+                msg = "is down";
+            }else{
+                msg = "has one or more links down";
+            }
+            for(vars = response->variables; vars; vars = vars->next_variable){
+                if(!monitor_check_oid(monitor->oid_table_tmp, monitor->oid_len_tmp, vars)){
+                    monitor_fail(monitor, "Unknown error in SNMP session");
+                    return;
+                }
+                if(vars->type == ASN_OCTET_STR && vars->val.string!=NULL && monitor->agg_tmp != NULL){
+                    //When the result is full no more aggregation can be written
+                    if(text_struct_add(&monitor->text, "%.*s %s\n", (int)vars->val_len, vars->val.string, msg) != SUCCEED){
+                        monitor->agg_tmp = NULL;
+                    }
+                }
+            }
+            if(monitor->agg_tmp != NULL)monitor->agg_tmp = agg_table_next(monitor->agg, monitor->agg_tmp);
+            break;
+
+        case LACP_PHASE_DISCOVERY:
+            //Save the description of the aggregations, the missing ones are left empty
+            for(vars = response->variables; vars; vars = vars->next_variable){
+                if(vars->type != ASN_OCTET_STR || vars->name_length != monitor->oid_len_tmp || !monitor_check_oid(monitor->oid_table_tmp, monitor->oid_len_tmp-1, vars))continue;
+                agg_tmp = agg_table_exist(vars->name[monitor->oid_len_tmp-1], monitor->agg);
+                if(agg_tmp == NULL)continue;
+                name = (char *)arena_alloc(monitor->arena, vars->val_len+1);
+                if(name == NULL)continue;
+                memcpy(name, vars->val.string, vars->val_len);
+                name[vars->val_len] = '\0';
+                monitor->agg_names[agg_tmp - monitor->agg->aggs] = name;
+            }
+            monitor->agg_pos = monitor->agg_pos+MAX_GET_VARS;
+            break;
+    }
+    lacp_monitor_next(monitor);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: lacp_walk_init                                                   *
+ *                                                                            *
+ * Purpose: Init a lacp_walk_t to start a new walk                            *
+ *                                                                            *
+ * Parameters: walk - A lacp_walk_t pointer                                   *
+ *                                                                            *
+ * Comment: The spare table is kept, it must be set by the caller of the      *
+ *          first init                                                        *
+ ******************************************************************************/
+static void lacp_walk_init(lacp_walk_t *walk){
+    if(walk !=NULL){
+        walk->agg = NULL;
+        walk->arena = NULL;
+        walk->phase = LACP_WALK_AGG_LIST;
+        walk->last_index = 0;
+    }
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: lacp_walk_agg_row                                                *
+ *                                                                            *
+ * Purpose: Save an aggregation of the walk of the aggregator table           *
+ *                                                                            *
+ * Parameters: monitor - A monitor_t pointer                                  *
+ *             index - the index of the row                                   *
+ *             values - the variables of the row                              *
+ *                                                                            *
+ * Return value: 1 - the walk continues                                       *
+ *               0 - the aggregation can not be saved, the monitoring is      *
+ *                   failed                                                   *
+ *                                                                            *
+ ******************************************************************************/
+static short lacp_walk_agg_row(monitor_t *monitor, long *index, struct variable_list **values){
+    lacp_walk_t *walk = monitor->lacp_walk;
+
+    //The first aggregation is saved in the spare table if there is one
+    if(walk->agg == NULL && walk->spare != NULL){
+        walk->agg = walk->spare;
+        walk->spare = NULL;
+    }
+    //Save the aggregation index in an aggregation structure
+    if(agg_table_add(index[0], &walk->agg, walk->arena) == NULL){
+        monitor_fail(monitor, "Cannot allocate memory");
+        return 0;
+    }
+    return 1;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: lacp_walk_port_row                                               *
+ *                                                                            *
+ * Purpose: Save a port of the walk of the aggregation port table             *
+ *                                                                            *
+ * Parameters: monitor - A monitor_t pointer                                  *
+ *             index - the index of the row                                   *
+ *             values - the variables of the row                              *
+ *                                                                            *
+ * Return value: 1 - the walk continues                                       *
+ *               0 - the port can not be saved, the monitoring is failed      *
+ *                                                                            *
+ ******************************************************************************/
+static short lacp_walk_port_row(monitor_t *monitor, long *index, struct variable_list **values){
+    lacp_walk_t *walk = monitor->lacp_walk;
+    agg_struct_t * agg_tmp;
+
+    //If the value is different from zero then the port is attached to an aggregation
+    //If the aggregation has been retrieved at the first phase then we had this port to the aggregation
+    if(values[0]->type == ASN_INTEGER && *values[0]->val.integer !=0){
+        agg_tmp = agg_table_exist(*values[0]->val.integer, walk->agg);
+        if(agg_tmp != NULL && agg_table_add_port(index[0], agg_tmp, walk->agg) != SUCCEED){
+            monitor_fail(monitor, "Cannot allocate memory");
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: lacp_walk_request                                                *
+ *                                                                            *
+ * Purpose: Prepare the next request of the walk of the aggregations          *
+ *                                                                            *
+ * Parameters: monitor - A monitor_t pointer                                  *
+ *                                                                            *
+ * Comment: The walk is resumed from monitor->lacp_walk->last_index           *
+ ******************************************************************************/
+static void lacp_walk_request(monitor_t *monitor){
+    //Variables holding oid to check
+    oid oid_table_agg_port_list[] = {1,2,840,10006,300,43,1,1,2,1,1};
+    int oid_len_agg_port_list = 11 ;
+
+    oid oid_table_agg_port_attached_id[] = {1,2,840,10006,300,43,1,2,1,1,13};
+    int oid_len_agg_port_attached_id = 11 ;
+
+    /********************************************************************
+     * The first phase is to check if the switch has any aggregation.   *
+     * If there is any aggregation then it is save in an aggregation    *
+     * structure.                                                       *
+     * The second phase is to get all the port attached to these        *
+     * aggregations.                                                    *
+     *******************************************************************/
+    if(monitor->lacp_walk->phase == LACP_WALK_AGG_LIST){
+        table_walk_init(&monitor->table_walk, 1, &monitor->lacp_walk->last_index, lacp_walk_agg_row);
+        table_walk_add_column(&monitor->table_walk, oid_table_agg_port_list, oid_len_agg_port_list);
+    }else{
+        table_walk_init(&monitor->table_walk, 1, &monitor->lacp_walk->last_index, lacp_walk_port_row);
+        table_walk_add_column(&monitor->table_walk, oid_table_agg_port_attached_id, oid_len_agg_port_attached_id);
+    }
+    table_walk_request(monitor, &monitor->table_walk);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: lacp_walk_response                                               *
+ *                                                                            *
+ * Purpose: Save the aggregations and the ports of a response of the walk     *
+ *                                                                            *
+ * Parameters: monitor - A monitor_t pointer                                  *
+ *             response - the response of the last request                    *
+ *                                                                            *
+ * Comment: The walk is complete when walk->phase is LACP_WALK_DONE           *
+ *          Otherwise it can be resumed from walk->last_index by another call *
+ ******************************************************************************/
+static void lacp_walk_response(monitor_t *monitor, struct snmp_pdu *response){
+    lacp_walk_t *walk = monitor->lacp_walk;
+
+    //At the end of the table the next phase is started
+    //If the switch has no aggregation, the ports are not needed
+    if(table_walk_response(monitor, &monitor->table_walk, response)){
+        if(walk->phase == LACP_WALK_AGG_LIST && walk->agg != NULL){
+            walk->phase = LACP_WALK_ATTACHED_ID;
+        }else{
+            agg_table_build_ports(walk->agg);
+            walk->phase = LACP_WALK_DONE;
+        }
+    }
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: lacp_discovery_result                                            *
+ *                                                                            *
+ * Purpose: Set the low level discovery JSON of the aggregations as result    *
+ *                                                                            *
+ * Parameters: monitor - A monitor_t pointer                                  *
+ *                                                                            *
+ ******************************************************************************/
+static void lacp_discovery_result(monitor_t *monitor){
+    struct zbx_json j;
+    text_struct_t members;
+    agg_struct_t *agg_tmp;
+    char index_buf[21];
+    int i;
+
+    zbx_json_init(&j, ZBX_JSON_STAT_BUF_LEN);
+    zbx_json_addarray(&j, ZBX_PROTO_TAG_DATA);
+    for(agg_tmp = agg_table_next(monitor->agg, NULL); agg_tmp != NULL; agg_tmp = agg_table_next(monitor->agg, agg_tmp)){
+        //The members are the ifIndex of the ports separated by commas
+        text_struct_init(&members, monitor->arena);
+        for(i=0;i<agg_tmp->nb_ports;i++){
+            text_struct_add(&members, i ? ",%ld" : "%ld", monitor->agg->ports[agg_tmp->first_port+i]);
+        }
+        snprintf(index_buf, sizeof(index_buf), "%ld", agg_tmp->index);
+        zbx_json_addobject(&j, NULL);
+        zbx_json_addstring(&j, "{#AGGINDEX}", index_buf, ZBX_JSON_TYPE_STRING);
+        zbx_json_addstring(&j, "{#AGGNAME}", monitor->agg_names[agg_tmp - monitor->agg->aggs] != NULL ? monitor->agg_names[agg_tmp - monitor->agg->aggs] : "", ZBX_JSON_TYPE_STRING);
+        zbx_json_addstring(&j, "{#MEMBERS}", members.str != NULL ? members.str : "", ZBX_JSON_TYPE_STRING);
+        zbx_json_close(&j);
+        text_struct_free(&members);
+    }
+    zbx_json_close(&j);
+    SET_STR_RESULT(monitor->result, strdup(j.buffer));
+    zbx_json_free(&j);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: rrpp_monitoring                                        *
+ *                                                                            *
+ * Purpose: Item to monitor RRPP protocol                                    *
+ *                                                                            *
+ * Parameters: request - structure that contains item key and parameters      *
+ *              request->key - item key without parameters                    *
+ *              request->nparam - number of parameters                        *
+ *              request->timeout - processing should not take longer than     *
+ *                                 this number of seconds                     *
+ *              request->params[N-1] - pointers to item key parameters        *
+ *                                                                            *
+ *             result - structure that will contain result                    *
+ *                                                                            *
+ * Return value: SYSINFO_RET_FAIL - function failed, item will be marked      *
+ *                                 as not supported by zabbix                 *
+ *               SYSINFO_RET_OK - success                                     *
+ *                                                                            *
+ * Comment: The parameters of the request are (in order):                     *
+ *              - IP address of the snmp agent                                *
+ *              - SNMP read community of the snmp agent                       *
+ *              - The timeout request (in second) - 2s by default             *
+ *              - The number of retries - 0 by default                        *
+ *          The two last parameters are optional                              *
+ *                                                                            *
+ *          In case of success the result structure will contain              *
+ *          the following:                                                    *
+ *               - No data if everything is OK                                *
+ *               - The name of the rings that have failure                    *
+ *                                                                            *
+ *          In case of failure, the result structure will contain an          *
+ *          error message                                                     *
+ ******************************************************************************/
+static int	rrpp_monitoring(AGENT_REQUEST *request, AGENT_RESULT *result)
+{
+    struct snmp_session session;
+    monitor_t monitor;
+    arena_t *arena = arena_acquire();
+
+    if(rrpp_monitoring_init(request, result, &session, &monitor, arena) != SYSINFO_RET_OK){
+        arena_release(arena);
+        return SYSINFO_RET_FAIL;
+    }
+
+    //Run the monitoring until all the requests have been answered
+    monitor_run(session, &monitor);
+    arena_release(arena);
+    return monitor.ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: rrpp_discovery                                                   *
+ *                                                                            *
+ * Purpose: Item to discover the RRPP rings of a switch                       *
+ *                                                                            *
+ * Parameters: request - structure that contains item key and parameters      *
+ *             result - structure that will contain result                    *
+ *                                                                            *
+ * Return value: SYSINFO_RET_FAIL - function failed, item will be marked      *
+ *                                 as not supported by zabbix                 *
+ *               SYSINFO_RET_OK - success                                     *
+ *                                                                            *
+ * Comment: The parameters of the request are (in order):                     *
+ *              - IP address of the snmp agent                                *
+ *              - SNMP read community of the snmp agent                       *
+ *              - The timeout request (in second) - 2s by default             *
+ *              - The number of retries - 0 by default                        *
+ *          The two last parameters are optional                              *
+ *                                                                            *
+ *          In case of success the result structure will contain the low      *
+ *          level discovery JSON of the enabled rings with the macros         *
+ *          {#DOMAIN}, {#RING}, {#PRIMARYPORT} and {#SECONDARYPORT} (the      *
+ *          ifIndex of the ports)                                             *
+ ******************************************************************************/
+static int	rrpp_discovery(AGENT_REQUEST *request, AGENT_RESULT *result)
+{
+    struct snmp_session session;
+    monitor_t monitor;
+    arena_t *arena = arena_acquire();
+
+    if(request->nparam >4){
+        SET_MSG_RESULT(result, strdup("Too many parameters"));
+        arena_release(arena);
+        return SYSINFO_RET_FAIL;
+    }
+    if(rrpp_monitoring_init(request, result, &session, &monitor, arena) != SYSINFO_RET_OK){
+        arena_release(arena);
+        return SYSINFO_RET_FAIL;
+    }
+    monitor.mode = MONITOR_MODE_DISCOVERY;
+
+    //Run the monitoring until all the requests have been answered
+    monitor_run(session, &monitor);
+    arena_release(arena);
+    return monitor.ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: rrpp_ring_monitoring                                             *
+ *                                                                            *
+ * Purpose: Item to monitor a single RRPP ring of a switch                    *
+ *                                                                            *
+ * Parameters: request - structure that contains item key and parameters      *
+ *             result - structure that will contain result                    *
+ *                                                                            *
+ * Return value: SYSINFO_RET_FAIL - function failed, item will be marked      *
+ *                                 as not supported by zabbix                 *
+ *               SYSINFO_RET_OK - success                                     *
+ *                                                                            *
+ * Comment: The parameters of the request are (in order):                     *
+ *              - IP address of the snmp agent                                *
+ *              - SNMP read community of the snmp agent                       *
+ *              - The domain id of the ring ({#DOMAIN})                       *
+ *              - The ring id ({#RING})                                       *
+ *              - The timeout request (in second) - 2s by default             *
+ *              - The number of retries - 0 by default                        *
+ *          The two last parameters are optional                              *
+ *                                                                            *
+ *          In case of success the result structure will contain an integer:  *
+ *               - 0 (RING_STATUS_OK) if both ports are up                    *
+ *               - 1 (RING_STATUS_PRIMARY_DOWN) if the primary port is down   *
+ *               - 2 (RING_STATUS_SECONDARY_DOWN) if the secondary port is    *
+ *                 down                                                       *
+ *               - 3 (RING_STATUS_DOWN) if both ports are down                *
+ *                                                                            *
+ *          The rings of a switch are evaluated once for all its items, then  *
+ *          kept for IF_STATUS_MAX_AGE seconds                                *
+ ******************************************************************************/
+static int	rrpp_ring_monitoring(AGENT_REQUEST *request, AGENT_RESULT *result)
+{
+    struct snmp_session session;
+    monitor_t monitor;
+    arena_t *arena = arena_acquire();
+
+    if(rrpp_ring_monitoring_init(request, result, &session, &monitor, arena) != SYSINFO_RET_OK){
+        arena_release(arena);
+        return SYSINFO_RET_FAIL;
+    }
+
+    //Run the monitoring until all the requests have been answered
+    monitor_run(session, &monitor);
+    arena_release(arena);
+    return monitor.ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: rrpp_ring_monitoring_init                                        *
+ *                                                                            *
+ * Purpose: Check the parameters of monitor.rrpp.ring and init its monitoring *
+ *                                                                            *
+ * Parameters: request - structure that contains item key and parameters      *
+ *             result - structure that will contain the error message         *
+ *             session - the struct snmp_session to init                      *
+ *             monitor - the monitor_t to init                                *
+ *             arena - the arena of the transient data of the monitoring      *
+ *                                                                            *
+ * Return value: SYSINFO_RET_FAIL - the parameters are invalid                *
+ *               SYSINFO_RET_OK - the monitoring can be run                   *
+ *                                                                            *
+ ******************************************************************************/
+static int rrpp_ring_monitoring_init(AGENT_REQUEST *request, AGENT_RESULT *result, struct snmp_session *session, monitor_t *monitor, arena_t *arena)
+{
+    /****************** Variables ******************/
+    //Parameters (Not mandatory parameters are initialised)
+    long version = SNMP_VERSION_2c;
+    long timeout = 2000000;
+    int retries = 0;
+    char *community;
+    size_t community_len;
+    char *ip_address;
+    long domain;
+    long ring;
+
+
+    //Other Variables
+    int ret = SYSINFO_RET_OK;
+
+    /****************** Get parameters ******************/
+    //Get parameters
+    if(request->nparam <4){     //Check if mandatory parameters are provided
+        SET_MSG_RESULT(result, strdup("Parameters Missing"));
+        return SYSINFO_RET_FAIL;
+    }
+    if(request->nparam >6){
+        SET_MSG_RESULT(result, strdup("Too many parameters"));
+        return SYSINFO_RET_FAIL;
+    }
+    ip_address = get_rparam(request, 0);
+
+    if(is_valid_ip(ip_address)){
+        SET_MSG_RESULT(result, strdup("Invalid IP Address"));
+        ret = SYSINFO_RET_FAIL;
+    }
+
+    community = get_rparam(request, 1);
+    community_len = strlen(community);
+
+    domain = atol(get_rparam(request, 2));
+    ring = atol(get_rparam(request, 3));
+    if(domain<1 || ring<1){
+        SET_MSG_RESULT(result, strdup("Invalid domain or ring id"));
+        ret = SYSINFO_RET_FAIL;
+    }
+    if(request->nparam >4){
+        timeout = atoi(get_rparam(request, 4))*1000000;
+    }
+    if(request->nparam >5){
+        retries = atoi(get_rparam(request, 5));
+    }
+    if(ret != SYSINFO_RET_OK)return ret;
+
+    /****************** Main code ******************/
+    //Init SNMP Session
+    snmp_sess_init(session);
+    session->version = version;
+    session->timeout = timeout;
+    session->retries = retries;
+    session->community = community;
+    session->community_len = community_len;
+    session->peername = ip_address;
+
+    //Init the monitoring of the ring
+    monitor_init(MONITOR_RRPP, ip_address, result, monitor, arena);
+    monitor->mode = MONITOR_MODE_ENTITY;
+    monitor->ring_domain = domain;
+    monitor->ring_id = ring;
+    return SYSINFO_RET_OK;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: rrpp_count_monitoring                                            *
+ *                                                                            *
+ * Purpose: Item to count the RRPP rings of a switch in a given state         *
+ *                                                                            *
+ * Parameters: request - structure that contains item key and parameters      *
+ *             result - structure that will contain result                    *
+ *                                                                            *
+ * Return value: SYSINFO_RET_FAIL - function failed, item will be marked      *
+ *                                 as not supported by zabbix                 *
+ *               SYSINFO_RET_OK - success                                     *
+ *                                                                            *
+ * Comment: The parameters of the request are (in order):                     *
+ *              - IP address of the snmp agent                                *
+ *              - SNMP read community of the snmp agent                       *
+ *              - The state counted:                                          *
+ *                  - down - the rings with both ports down                   *
+ *                  - degraded - the rings with one port down                 *
+ *              - The timeout request (in second) - 2s by default             *
+ *              - The number of retries - 0 by default                        *
+ *          The two last parameters are optional                              *
+ *                                                                            *
+ *          In case of success the result structure will contain the number   *
+ *          of rings in the state. It is computed from the same evaluation as *
+ *          monitor.rrpp.ring                                                 *
+ ******************************************************************************/
+static int	rrpp_count_monitoring(AGENT_REQUEST *request, AGENT_RESULT *result)
+{
+    struct snmp_session session;
+    monitor_t monitor;
+    arena_t *arena = arena_acquire();
+
+    if(count_monitoring_init(request, result, &session, &monitor, arena, MONITOR_RRPP, MONITOR_MODE_COUNT) != SYSINFO_RET_OK){
+        arena_release(arena);
+        return SYSINFO_RET_FAIL;
+    }
+
+    //Run the monitoring until all the requests have been answered
+    monitor_run(session, &monitor);
+    arena_release(arena);
+    return monitor.ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: count_monitoring_init                                            *
+ *                                                                            *
+ * Purpose: Check the parameters of the count and flaps items of LACP and     *
+ *          RRPP and init their monitoring                                    *
+ *                                                                            *
+ * Parameters: request - structure that contains item key and parameters      *
+ *             result - structure that will contain the error message         *
+ *             session - the struct snmp_session to init                      *
+ *             monitor - the monitor_t to init                                *
+ *             arena - the arena of the transient data of the monitoring      *
+ *             type - MONITOR_LACP or MONITOR_RRPP                            *
+ *             mode - MONITOR_MODE_COUNT or MONITOR_MODE_FLAPS, the third     *
+ *                    parameter is the state counted or the window            *
+ *                                                                            *
+ * Return value: SYSINFO_RET_FAIL - the parameters are invalid                *
+ *               SYSINFO_RET_OK - the monitoring can be run                   *
+ *                                                                            *
+ ******************************************************************************/
+static int count_monitoring_init(AGENT_REQUEST *request, AGENT_RESULT *result, struct snmp_session *session, monitor_t *monitor, arena_t *arena, short type, short mode)
+{
+    /****************** Variables ******************/
+    //Parameters (Not mandatory parameters are initialised)
+    long version = SNMP_VERSION_2c;
+    long timeout = 2000000;
+    int retries = 0;
+    char *community;
+    size_t community_len;
+    char *ip_address;
+    char *state;
+    short count_state = COUNT_STATE_DOWN;
+    long window = 0;
+
+
+    //Other Variables
+    int ret = SYSINFO_RET_OK;
+
+    /****************** Get parameters ******************/
+    //Get parameters
+    if(request->nparam <3){     //Check if mandatory parameters are provided
+        SET_MSG_RESULT(result, strdup("Parameters Missing"));
+        return SYSINFO_RET_FAIL;
+    }
+    if(request->nparam >5){
+        SET_MSG_RESULT(result, strdup("Too many parameters"));
+        return SYSINFO_RET_FAIL;
+    }
+    ip_address = get_rparam(request, 0);
+
+    if(is_valid_ip(ip_address)){
+        SET_MSG_RESULT(result, strdup("Invalid IP Address"));
+        ret = SYSINFO_RET_FAIL;
+    }
+
+    community = get_rparam(request, 1);
+    community_len = strlen(community);
+
+    state = get_rparam(request, 2);
+    if(mode == MONITOR_MODE_FLAPS){
+        window = atol(state);
+        if(window<1){
+            SET_MSG_RESULT(result, strdup("Invalid window"));
+            ret = SYSINFO_RET_FAIL;
+        }
+    }else if(strcmp(state, "down") == 0){
+        count_state = COUNT_STATE_DOWN;
+    }else if(strcmp(state, "degraded") == 0){
+        count_state = COUNT_STATE_DEGRADED;
+    }else{
+        SET_MSG_RESULT(result, strdup("Invalid state"));
+        ret = SYSINFO_RET_FAIL;
+    }
+    if(request->nparam >3){
+        timeout = atoi(get_rparam(request, 3))*1000000;
+    }
+    if(request->nparam >4){
+        retries = atoi(get_rparam(request, 4));
+    }
+    if(ret != SYSINFO_RET_OK)return ret;
+
+    /****************** Main code ******************/
+    //Init SNMP Session
+    snmp_sess_init(session);
+    session->version = version;
+    session->timeout = timeout;
+    session->retries = retries;
+    session->community = community;
+    session->community_len = community_len;
+    session->peername = ip_address;
+
+    //The evaluation of the device is shared with the other items, as for a single aggregation or ring
+    monitor_init(type, ip_address, result, monitor, arena);
+    monitor->mode = mode;
+    monitor->count_state = count_state;
+    monitor->flap_window = window;
+    if(type == MONITOR_LACP && device_lacp_acquire(monitor->device)){
+        monitor->lacp_walk = &monitor->device->lacp_walk;
+    }
+
+    return SYSINFO_RET_OK;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: lacp_flaps_monitoring                                            *
+ *                                                                            *
+ * Purpose: Item to count the transitions of the aggregated ports of a switch *
+ *                                                                            *
+ * Parameters: request - structure that contains item key and parameters      *
+ *             result - structure that will contain result                    *
+ *                                                                            *
+ * Return value: SYSINFO_RET_FAIL - function failed, item will be marked      *
+ *                                 as not supported by zabbix                 *
+ *               SYSINFO_RET_OK - success                                     *
+ *                                                                            *
+ * Comment: The parameters of the request are (in order):                     *
+ *              - IP address of the snmp agent                                *
+ *              - SNMP read community of the snmp agent                       *
+ *              - The window (in second)                                      *
+ *              - The timeout request (in second) - 2s by default             *
+ *              - The number of retries - 0 by default                        *
+ *          The two last parameters are optional                              *
+ *                                                                            *
+ *          In case of success the result structure will contain the number   *
+ *          of times the ports of the aggregations went up or down during the *
+ *          window. The transitions are recorded by every evaluation of the   *
+ *          aggregations of the switch, the last FLAP_HISTORY_LEN of every    *
+ *          port are kept                                                     *
+ ******************************************************************************/
+static int	lacp_flaps_monitoring(AGENT_REQUEST *request, AGENT_RESULT *result)
+{
+    struct snmp_session session;
+    monitor_t monitor;
+    arena_t *arena = arena_acquire();
+
+    if(count_monitoring_init(request, result, &session, &monitor, arena, MONITOR_LACP, MONITOR_MODE_FLAPS) != SYSINFO_RET_OK){
+        arena_release(arena);
+        return SYSINFO_RET_FAIL;
+    }
+
+    //Run the monitoring until all the requests have been answered
+    monitor_run(session, &monitor);
+    arena_release(arena);
+    return monitor.ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: rrpp_flaps_monitoring                                            *
+ *                                                                            *
+ * Purpose: Item to count the transitions of the RRPP rings of a switch       *
+ *                                                                            *
+ * Parameters: request - structure that contains item key and parameters      *
+ *             result - structure that will contain result                    *
+ *                                                                            *
+ * Return value: SYSINFO_RET_FAIL - function failed, item will be marked      *
+ *                                 as not supported by zabbix                 *
+ *               SYSINFO_RET_OK - success                                     *
+ *                                                                            *
+ * Comment: The parameters of the request are (in order):                     *
+ *              - IP address of the snmp agent                                *
+ *              - SNMP read community of the snmp agent                       *
+ *              - The window (in second)                                      *
+ *              - The timeout request (in second) - 2s by default             *
+ *              - The number of retries - 0 by default                        *
+ *          The two last parameters are optional                              *
+ *                                                                            *
+ *          In case of success the result structure will contain the number   *
+ *          of times the status of the rings changed during the window. The   *
+ *          transitions are recorded by every evaluation of the rings of the  *
+ *          switch, the last FLAP_HISTORY_LEN of every ring are kept          *
+ ******************************************************************************/
+static int	rrpp_flaps_monitoring(AGENT_REQUEST *request, AGENT_RESULT *result)
+{
+    struct snmp_session session;
+    monitor_t monitor;
+    arena_t *arena = arena_acquire();
+
+    if(count_monitoring_init(request, result, &session, &monitor, arena, MONITOR_RRPP, MONITOR_MODE_FLAPS) != SYSINFO_RET_OK){
+        arena_release(arena);
+        return SYSINFO_RET_FAIL;
+    }
+
+    //Run the monitoring until all the requests have been answered
+    monitor_run(session, &monitor);
+    arena_release(arena);
+    return monitor.ret;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: rrpp_monitoring_init                                             *
+ *                                                                            *
+ * Purpose: Check the parameters of monitor.rrpp and init its monitoring      *
+ *                                                                            *
+ * Parameters: request - structure that contains item key and parameters      *
+ *             result - structure that will contain the error message         *
+ *             session - the struct snmp_session to init                      *
+ *             monitor - the monitor_t to init                                *
+ *             arena - the arena of the transient data of the monitoring      *
+ *                                                                            *
+ * Return value: SYSINFO_RET_FAIL - the parameters are invalid                *
+ *               SYSINFO_RET_OK - the monitoring can be run                   *
+ *                                                                            *
+ ******************************************************************************/
+static int rrpp_monitoring_init(AGENT_REQUEST *request, AGENT_RESULT *result, struct snmp_session *session, monitor_t *monitor, arena_t *arena)
+{
+    /****************** Variables ******************/
+    //Parameters (Not mandatory parameters are initialised)
+    long version = SNMP_VERSION_2c;
+    long timeout = 2000000;
+    int retries = 0;
+    char *community;
+    size_t community_len;
+    char *ip_address;
+
+
+    //Other Variables
+    int ret = SYSINFO_RET_OK;
+
+    /****************** Get parameters ******************/
+    //Get parameters
+    if(request->nparam <2){     //Check if mandatory parameters are provided
+        SET_MSG_RESULT(result, strdup("Parameters Missing"));
+        ret =  SYSINFO_RET_FAIL;
+    }
+    ip_address = get_rparam(request, 0);
+
+    if(is_valid_ip(ip_address)){
+        SET_MSG_RESULT(result, strdup("Invalid IP Address"));
+        ret = SYSINFO_RET_FAIL;
+    }
+
+    community = get_rparam(request, 1);
+    community_len = strlen(community);
+
+    if(request->nparam >2){
+        timeout = atoi(get_rparam(request, 2))*1000000;
+    }
+    if(request->nparam >3){
+        retries = atoi(get_rparam(request, 3));
+    }
+    if(ret != SYSINFO_RET_OK)return ret;
+
+    /****************** Main code ******************/
+    //Init SNMP Session
+    snmp_sess_init(session);
+    session->version = version;
+    session->timeout = timeout;
+    session->retries = retries;
+    session->community = community;
+    session->community_len = community_len;
+    session->peername = ip_address;
+
+    //Init the monitoring of the device
+    monitor_init(MONITOR_RRPP, ip_address, result, monitor, arena);
+    return SYSINFO_RET_OK;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: rrpp_monitor_next                                                *
+ *                                                                            *
+ * Purpose: Prepare the next request of the rrpp monitoring                   *
+ *                                                                            *
+ * Parameters: monitor - A monitor_t pointer                                  *
+ *                                                                            *
+ * Comment: The monitoring is finished when no request is prepared            *
+ ******************************************************************************/
+static void rrpp_monitor_next(monitor_t *monitor){
+    //Variables holding oid to check
+    oid oid_table_rrpp_enable[] = {1,3,6,1,4,1,25506,2,45,1,1,0};
+    int oid_len_rrpp_enable = 12 ;
+
+    oid oid_table_rrpp_ring_enable[] = {1,3,6,1,4,1,25506,2,45,2,2,1,2};
+    int oid_len_rrpp_ring_enable = 13 ;
+
+    oid oid_table_rrpp_ring_primary_port[] = {1,3,6,1,4,1,25506,2,45,2,2,1,6};
+    int oid_len_rrpp_ring_primary_port = 13 ;
+
+    oid oid_table_rrpp_ring_secondary_port[] = {1,3,6,1,4,1,25506,2,45,2,2,1,7};
+    int oid_len_rrpp_ring_secondary_port = 13 ;
+
+    rrpp_struct_t * rrpp_tmp;
+    char ring_buf[21];
+    char domain_buf[21];
+    zbx_uint64_t nb;
+    int i;
+
+    while(monitor->pdu == NULL && monitor->phase != MONITOR_PHASE_DONE){
+        switch(monitor->phase){
+            /********************************************************************
+             * The first step is to check if the switch has RRPP enable.        *
+             *******************************************************************/
+            case RRPP_PHASE_ENABLE:
+                //The discovery and the ring items use the rings evaluated for the device if they are recent
+                if(monitor->mode != MONITOR_MODE_STATUS){
+                    monitor->rrpp = device_rrpp_get(monitor->device, monitor->arena);
+                    if(monitor->rrpp != NULL){
+                        monitor->phase = RRPP_PHASE_RESULT;
+                        break;
+                    }
+                }
+                for(i=0;i<oid_len_rrpp_enable;i++)monitor->oid_table_tmp[i] = oid_table_rrpp_enable[i];
+                monitor->oid_len_tmp = oid_len_rrpp_enable;
+                monitor_request_get(monitor);
+                break;
+
+            /********************************************************************
+             * If it has rrpp enable then man need to get all the domain and    *
+             * enabled rings with the primary and the secondary port of every   *
+             * ring, the three columns are walked together                      *
+             *******************************************************************/
+            case RRPP_PHASE_RINGS:
+                table_walk_init(&monitor->table_walk, 2, monitor->last_ring_index, rrpp_walk_row);
+                table_walk_add_column(&monitor->table_walk, oid_table_rrpp_ring_enable, oid_len_rrpp_ring_enable);
+                table_walk_add_column(&monitor->table_walk, oid_table_rrpp_ring_primary_port, oid_len_rrpp_ring_primary_port);
+                table_walk_add_column(&monitor->table_walk, oid_table_rrpp_ring_secondary_port, oid_len_rrpp_ring_secondary_port);
+                table_walk_request(monitor, &monitor->table_walk);
+                break;
+
+            /********************************************************************
+             * The next step is to get the status of every interface of the     *
+             * switch and deduce the status of every primary and secondary port *
+             *******************************************************************/
+            case RRPP_PHASE_PORT_STATUS:
+                if(monitor_if_status_next(monitor))break;
+                rrpp_table_eval_status(monitor->rrpp, monitor->if_status);
+                device_rrpp_flaps_update(monitor->device, monitor->rrpp, monitor->if_status->time);
+                monitor->phase = RRPP_PHASE_RESULT;
+                break;
+
+            /********************************************************************
+             * The last step is to give the state of the rings, the rings       *
+             * evaluated are cached for the other rrpp items of the device      *
+             *******************************************************************/
+            case RRPP_PHASE_RESULT:
+                //A switch without ring is cached with an empty table
+                if(monitor->rrpp == NULL)rrpp_table_new(&monitor->rrpp, monitor->arena);
+                if(monitor->rrpp != NULL && monitor->rrpp->time == 0){
+                    monitor->rrpp->time = monitor->if_status != NULL ? monitor->if_status->time : time(NULL);
+                    device_rrpp_set(monitor->device, monitor->rrpp);
+                }
+                if(monitor->mode == MONITOR_MODE_DISCOVERY){
+                    rrpp_discovery_result(monitor);
+                    monitor_finish(monitor);
+                    break;
+                }
+                if(monitor->mode == MONITOR_MODE_ENTITY){
+                    rrpp_tmp = rrpp_table_exist(monitor->ring_domain, monitor->ring_id, monitor->rrpp);
+                    if(rrpp_tmp == NULL){
+                        monitor_fail(monitor, "Unknown ring");
+                        break;
+                    }
+                    SET_UI64_RESULT(monitor->result, rrpp_tmp->status);
+                    monitor_finish(monitor);
+                    break;
+                }
+                if(monitor->mode == MONITOR_MODE_FLAPS){
+                    SET_UI64_RESULT(monitor->result, device_rrpp_flaps_count(monitor->device, monitor->rrpp, monitor->flap_window));
+                    monitor_finish(monitor);
+                    break;
+                }
+                if(monitor->mode == MONITOR_MODE_COUNT){
+                    nb = 0;
+                    for(rrpp_tmp = rrpp_table_next(monitor->rrpp, NULL); rrpp_tmp != NULL; rrpp_tmp = rrpp_table_next(monitor->rrpp, rrpp_tmp)){
+                        if(monitor->count_state == COUNT_STATE_DOWN ? rrpp_tmp->status == RING_STATUS_DOWN : rrpp_tmp->status == RING_STATUS_PRIMARY_DOWN || rrpp_tmp->status == RING_STATUS_SECONDARY_DOWN)nb++;
+                    }
+                    SET_UI64_RESULT(monitor->result, nb);
+                    monitor_finish(monitor);
+                    break;
+                }
+                rrpp_tmp = rrpp_table_next(monitor->rrpp, NULL);
+                while (rrpp_tmp!=NULL ){
+                    if(rrpp_tmp->status != RING_STATUS_OK){
+                        //The ids are left blank if they are not valid
+                        ring_buf[0] = '\0';
+                        domain_buf[0] = '\0';
+                        if(rrpp_tmp->ring>0)snprintf(ring_buf, sizeof(ring_buf), "%ld", rrpp_tmp->ring);
+                        if(rrpp_tmp->domain>0)snprintf(domain_buf, sizeof(domain_buf), "%ld", rrpp_tmp->domain);
+                        //A space is added after the domain when it fills its two characters
+                        //When the result is full no more ring can be written
+                        if(text_struct_add(&monitor->text, "Ring %-2s in domain  %-2s%sis failed\n", ring_buf, domain_buf, strlen(domain_buf) > 1 ? " " : "") != SUCCEED)break;
+                    }
+                    rrpp_tmp = rrpp_table_next(monitor->rrpp, rrpp_tmp);
+                }
+                text_struct_set_result(&monitor->text, monitor->result);
+                monitor_finish(monitor);
+                break;
+
+            default:
+                monitor_finish(monitor);
+                break;
+        }
+    }
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: rrpp_walk_row                                                    *
+ *                                                                            *
+ * Purpose: Save a ring of the walk of the rrpp ring table                    *
+ *                                                                            *
+ * Parameters: monitor - A monitor_t pointer                                  *
+ *             index - the domain and the ring id of the row                  *
+ *             values - the status, the primary port and the secondary port   *
+ *                      of the ring                                           *
+ *                                                                            *
+ * Return value: 1 - the walk continues                                       *
+ *                                                                            *
+ ******************************************************************************/
+static short rrpp_walk_row(monitor_t *monitor, long *index, struct variable_list **values){
+    rrpp_struct_t * rrpp_tmp;
+
+    //Save the ring if it is enable
+    if(values[0]->type != ASN_INTEGER || *values[0]->val.integer != 1)return 1;
+    rrpp_tmp = rrpp_table_add(index[0], index[1], &monitor->rrpp, monitor->arena);
+    monitor->rings_enabled = 1;
+    if(rrpp_tmp == NULL)return 1;
+
+    //Save the primary-port and secondary-port index
+    if(values[1] != NULL && values[1]->type == ASN_INTEGER)rrpp_struct_set_port(*values[1]->val.integer, RRPP_PRIMARY_PORT, rrpp_tmp);
+    if(values[2] != NULL && values[2]->type == ASN_INTEGER)rrpp_struct_set_port(*values[2]->val.integer, RRPP_SECONDARY_PORT, rrpp_tmp);
+    return 1;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: rrpp_monitor_step                                                *
+ *                                                                            *
+ * Purpose: Analyse the response of the last request of the rrpp monitoring   *
+ *          and prepare the next one                                          *
+ *                                                                            *
+ * Parameters: monitor - A monitor_t pointer                                  *
+ *             response - the response of the last request                    *
+ *                                                                            *
+ ******************************************************************************/
+static void rrpp_monitor_step(monitor_t *monitor, struct snmp_pdu *response){
+    struct variable_list *vars;
+
+    switch(monitor->phase){
+        case RRPP_PHASE_ENABLE:
+            vars = response->variables;
+            //If the oid is different or the value is not an integer, there is an error
+            if(vars == NULL || !monitor_check_oid(monitor->oid_table_tmp, monitor->oid_len_tmp, vars) || vars->type !=ASN_INTEGER){
+                monitor_fail(monitor, "Unknown error in SNMP session");
+                return;
+            }
+            //If the switch has no rrpp enable configured then it is not needed to continue
+            if(*vars->val.integer==RRPP_DISABLE){
+                monitor->phase = RRPP_PHASE_RESULT;
+                break;
+            }
+            monitor->phase = RRPP_PHASE_RINGS;
+            break;
+
+        case RRPP_PHASE_RINGS:
+            //At the end of the table the status of the ports is retrieved
+            if(table_walk_response(monitor, &monitor->table_walk, response)){
+                if(!monitor->rings_enabled){
+                    monitor->phase = RRPP_PHASE_RESULT;
+                    break;
+                }
+                monitor->phase = RRPP_PHASE_PORT_STATUS;
+            }
+            break;
+
+        case RRPP_PHASE_PORT_STATUS:
+            monitor_if_status_step(monitor, response);
+            break;
+    }
+    rrpp_monitor_next(monitor);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: rrpp_discovery_result                                            *
+ *                                                                            *
+ * Purpose: Set the low level discovery JSON of the rings as result           *
+ *                                                                            *
+ * Parameters: monitor - A monitor_t pointer                                  *
+ *                                                                            *
+ ******************************************************************************/
+static void rrpp_discovery_result(monitor_t *monitor){
+    struct zbx_json j;
+    rrpp_struct_t *rrpp_tmp;
+    char buf[21];
+
+    zbx_json_init(&j, ZBX_JSON_STAT_BUF_LEN);
+    zbx_json_addarray(&j, ZBX_PROTO_TAG_DATA);
+    for(rrpp_tmp = rrpp_table_next(monitor->rrpp, NULL); rrpp_tmp != NULL; rrpp_tmp = rrpp_table_next(monitor->rrpp, rrpp_tmp)){
+        zbx_json_addobject(&j, NULL);
+        snprintf(buf, sizeof(buf), "%ld", rrpp_tmp->domain);
+        zbx_json_addstring(&j, "{#DOMAIN}", buf, ZBX_JSON_TYPE_STRING);
+        snprintf(buf, sizeof(buf), "%ld", rrpp_tmp->ring);
+        zbx_json_addstring(&j, "{#RING}", buf, ZBX_JSON_TYPE_STRING);
+        snprintf(buf, sizeof(buf), "%ld", rrpp_tmp->primary_port);
+        zbx_json_addstring(&j, "{#PRIMARYPORT}", buf, ZBX_JSON_TYPE_STRING);
+        snprintf(buf, sizeof(buf), "%ld", rrpp_tmp->secondary_port);
+        zbx_json_addstring(&j, "{#SECONDARYPORT}", buf, ZBX_JSON_TYPE_STRING);
+        zbx_json_close(&j);
+    }
+    zbx_json_close(&j);
+    SET_STR_RESULT(monitor->result, strdup(j.buffer));
+    zbx_json_free(&j);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: monitor_init                                                     *
+ *                                                                            *
+ * Purpose: Init a monitor_t to start a new monitoring                        *
+ *                                                                            *
+ * Parameters: type - MONITOR_IRF, MONITOR_LACP or MONITOR_RRPP               *
+ *             ip_address - the IP address of the device monitored            *
+ *             result - structure that will contain result                    *
+ *             monitor - A monitor_t pointer                                  *
+ *             arena - the arena of the transient data, NULL to use malloc    *
+ *                                                                            *
+ ******************************************************************************/
+static void monitor_init(short type, const char *ip_address, AGENT_RESULT *result, monitor_t *monitor, arena_t *arena){
+    memset(monitor, 0, sizeof(monitor_t));
+    monitor->type = type;
+    monitor->phase = MONITOR_PHASE_START;
+    monitor->status = STAT_SUCCESS;
+    monitor->ret = SYSINFO_RET_OK;
+    monitor->result = result;
+    monitor->device = device_struct_get(ip_address);
+    monitor->arena = arena;
+    lacp_walk_init(&monitor->walk);
+    monitor->walk.spare = NULL;
+    monitor->walk.arena = arena;
+    monitor->lacp_walk = &monitor->walk;
+    text_struct_init(&monitor->text, arena);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: monitor_run                                                      *
+ *                                                                            *
+ * Purpose: Run a monitoring until all its requests have been answered        *
+ *                                                                            *
+ * Parameters: session - an init struct snmp_session                          *
+ *             monitor - A monitor_t pointer initialised by monitor_init      *
+ *                                                                            *
+ * Comment: The result is set in monitor->result and monitor->ret             *
+ ******************************************************************************/
+static void monitor_run(struct snmp_session session, monitor_t *monitor){
+    monitor_loop(&session, monitor, 1, monitor->arena);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: monitor_loop                                                     *
+ *                                                                            *
+ * Purpose: Run many monitorings at the same time from an event loop          *
+ *                                                                            *
+ * Parameters: sessions - the init struct snmp_session of every monitoring    *
+ *             monitors - the monitor_t initialised by monitor_init, the ones *
+ *                        with a MONITOR_PHASE_DONE phase are skipped         *
+ *             nb_monitors - the number of monitorings                        *
+ *             arena - the arena of the transient data, NULL to use malloc    *
+ *                                                                            *
+ * Comment: All the requests are sent from MAX_LOOP_SOCKETS sockets          *
+ *          registered on an epoll instance, whatever the number of devices.  *
+ *          They are taken from the pool of the process, so they are only     *
+ *          opened by its first call, or when several threads call it at the  *
+ *          same time.                                                        *
+ *          The sessions given only hold the parameters of every device, a    *
+ *          response is routed to its monitoring by its request id and        *
+ *          checked against the address of the device.                        *
+ *          At most MAX_LOOP_MONITORS monitorings are running at the same     *
+ *          time                                                              *
+ ******************************************************************************/
+static void monitor_loop(struct snmp_session *sessions, monitor_t *monitors, int nb_monitors, arena_t *arena){
+    loop_t *loop;
+    loop_entry_t *entries;
+    loop_entry_t *entry;
+    struct epoll_event events[MAX_LOOP_EVENTS];
+    int nb_events;
+    int nb_active = 0;
+    int next_monitor = 0;
+    long long wait;
+    int i;
+
+    entries = (loop_entry_t *)arena_alloc(arena, sizeof(loop_entry_t)*nb_monitors);
+    if(entries != NULL)memset(entries, 0, sizeof(loop_entry_t)*nb_monitors);
+    loop = entries != NULL ? loop_acquire() : NULL;
+    if(loop == NULL){
+        zabbix_log(LOG_LEVEL_WARNING, "zbxmodHP: cannot create the event loop");
+        for(i=0;i<nb_monitors;i++)monitor_abort(&monitors[i], STAT_ERR_INIT);
+        arena_free(arena, entries);
+        return;
+    }
+    loop->queue.prev = loop->queue.next = &loop->queue;
+    loop->done.prev = loop->done.next = &loop->done;
+
+    while(next_monitor < nb_monitors || nb_active > 0){
+        //Start the next monitorings
+        while(next_monitor < nb_monitors && nb_active < MAX_LOOP_MONITORS){
+            entry = &entries[next_monitor];
+            entry->loop = loop;
+            entry->monitor = &monitors[next_monitor];
+            entry->sess_handle = loop->sess_handles[next_monitor % loop->nb_sockets];
+            if(loop_entry_start(entry, &sessions[next_monitor]) == FAIL){
+                monitor_abort(entry->monitor, STAT_ERR_INIT);
+            }
+            else if(entry->next != NULL){
+                nb_active++;
+            }
+            next_monitor++;
+        }
+
+        //Wait for a response until the first request expires
+        if(loop->queue.next != &loop->queue){
+            wait = loop->queue.next->deadline - loop_clock();
+            if(wait < 0)wait = 0;
+            nb_events = epoll_wait(loop->epoll_fd, events, MAX_LOOP_EVENTS, (int)wait);
+            for(i=0;i<nb_events;i++){
+                NETSNMP_LARGE_FD_SET(loop->fds[events[i].data.u32], &loop->fdset);
+                snmp_sess_read2(loop->sess_handles[events[i].data.u32], &loop->fdset);
+                NETSNMP_LARGE_FD_CLR(loop->fds[events[i].data.u32], &loop->fdset);
+            }
+        }
+
+        //Let net-snmp time out the expired requests
+        while(loop->queue.next != &loop->queue && loop->queue.next->deadline <= loop_clock()){
+            entry = loop->queue.next;
+            loop_entry_remove(entry);
+            snmp_sess_timeout(entry->sess_handle);
+            //If the request is not expired yet for net-snmp, wait for its new deadline
+            if(entry->next == NULL){
+                entry->deadline = loop_clock() + entry->timeout;
+                loop_entry_append(entry, &loop->queue);
+            }
+        }
+
+        //Forget the finished monitorings
+        while(loop->done.next != &loop->done){
+            loop_entry_remove(loop->done.next);
+            nb_active--;
+        }
+    }
+
+    loop_release(loop);
+    arena_free(arena, entries);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: loop_acquire                                                     *
+ *                                                                            *
+ * Purpose: Get an event loop with its sockets opened                         *
+ *                                                                            *
+ * Return value:    an idle loop_t                                            *
+ *                  NULL if no socket can be opened                           *
+ *                                                                            *
+ * Comment: The loops released by the previous calls of the process are       *
+ *          reused. The ones inherited from another process by a fork are     *
+ *          closed, as their sockets are shared with that process             *
+ ******************************************************************************/
+static loop_t * loop_acquire(void){
+    loop_t *loop;
+    pid_t pid = getpid();
+
+    pthread_mutex_lock(&loops_lock);
+    while((loop = loops) != NULL){
+        loops = loop->next;
+        if(loop->pid == pid)break;
+        loop_close(loop);
+    }
+    pthread_mutex_unlock(&loops_lock);
+    if(loop != NULL)return loop;
+    return loop_open();
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: loop_open                                                        *
+ *                                                                            *
+ * Purpose: Create an event loop and open the sockets shared by its devices   *
+ *                                                                            *
+ * Return value:    a new loop_t                                              *
+ *                  NULL if failure                                           *
+ *                                                                            *
+ ******************************************************************************/
+static loop_t * loop_open(void){
+    loop_t *loop;
+    struct snmp_session session;
+    netsnmp_transport *transport;
+    struct epoll_event event;
+
+    loop = (loop_t *)calloc(1, sizeof(loop_t));
+    if(loop == NULL)return NULL;
+    loop->pid = getpid();
+    loop->epoll_fd = epoll_create1(0);
+    if(loop->epoll_fd >= 0){
+        //Open the sockets shared by all the devices
+        snmp_sess_init(&session);
+        session.version = SNMP_VERSION_2c;
+        session.peername = "0.0.0.0";
+        session.retries = 0;
+        while(loop->nb_sockets < MAX_LOOP_SOCKETS){
+            loop->sess_handles[loop->nb_sockets] = snmp_sess_open(&session);
+            if(!loop->sess_handles[loop->nb_sockets])break;
+            transport = snmp_sess_transport(loop->sess_handles[loop->nb_sockets]);
+            memset(&event, 0, sizeof(event));
+            event.events = EPOLLIN;
+            event.data.u32 = loop->nb_sockets;
+            if(transport == NULL || epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, transport->sock, &event) !=0){
+                snmp_sess_close(loop->sess_handles[loop->nb_sockets]);
+                break;
+            }
+            loop->fds[loop->nb_sockets++] = transport->sock;
+        }
+    }
+    if(loop->nb_sockets == 0){
+        if(loop->epoll_fd >= 0)close(loop->epoll_fd);
+        free(loop);
+        return NULL;
+    }
+    netsnmp_large_fd_set_init(&loop->fdset, FD_SETSIZE);
+    return loop;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: loop_release                                                     *
+ *                                                                            *
+ * Purpose: Give an event loop back to the pool of the process                *
+ *                                                                            *
+ * Parameters: loop - A loop_t pointer, its monitorings are all finished      *
+ *                                                                            *
+ ******************************************************************************/
+static void loop_release(loop_t *loop){
+    if(loop == NULL)return;
+
+    pthread_mutex_lock(&loops_lock);
+    loop->next = loops;
+    loops = loop;
+    pthread_mutex_unlock(&loops_lock);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: loop_close                                                       *
+ *                                                                            *
+ * Purpose: Close the sockets and the epoll instance of an event loop         *
+ *                                                                            *
+ * Parameters: loop - A loop_t pointer, it is freed                           *
+ *                                                                            *
+ ******************************************************************************/
+static void loop_close(loop_t *loop){
+    int i;
+
+    netsnmp_large_fd_set_cleanup(&loop->fdset);
+    for(i=0;i<loop->nb_sockets;i++)snmp_sess_close(loop->sess_handles[i]);
+    close(loop->epoll_fd);
+    free(loop);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: loop_pool_free                                                   *
+ *                                                                            *
+ * Purpose: Close the event loops of the pool                                 *
+ *                                                                            *
+ ******************************************************************************/
+static void loop_pool_free(void){
+    loop_t *loop;
+
+    pthread_mutex_lock(&loops_lock);
+    while(loops != NULL){
+        loop = loops;
+        loops = loop->next;
+        loop_close(loop);
+    }
+    pthread_mutex_unlock(&loops_lock);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: monitor_abort                                                    *
+ *                                                                            *
+ * Purpose: Finish a monitoring when its requests can not be sent             *
+ *                                                                            *
+ * Parameters: monitor - A monitor_t pointer                                  *
+ *             status - the status given for every request                    *
+ *                                                                            *
+ * Comment: The monitorings chained to it are finished the same way. The      *
+ *          circuit breaker of the device is neither checked nor updated,     *
+ *          no request of an aborted monitoring reached the device            *
+ ******************************************************************************/
+static void monitor_abort(monitor_t *monitor, int status){
+    monitor->aborted = 1;
+    if(monitor->phase == MONITOR_PHASE_START)monitor_step(monitor, STAT_SUCCESS, NULL);
+    while(monitor->pdu != NULL){
+        snmp_free_pdu(monitor->pdu);
+        monitor_step(monitor, status, NULL);
+    }
+    if(monitor->chained != NULL)monitor_abort(monitor->chained, status);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: loop_entry_start                                                 *
+ *                                                                            *
+ * Purpose: Start a monitoring in the event loop                              *
+ *                                                                            *
+ * Parameters: entry - A loop_entry_t pointer                                 *
+ *             session - the init struct snmp_session of the monitoring       *
+ *                                                                            *
+ * Return value:    SUCCEED - the monitoring is started or already finished   *
+ *                  FAIL - the address of the device is invalid, the first    *
+ *                         request of the monitoring is kept in monitor->pdu  *
+ *                                                                            *
+ ******************************************************************************/
+static int loop_entry_start(loop_entry_t *entry, struct snmp_session *session){
+    //Get the first request of the monitoring
+    if(!loop_entry_next(entry))return SUCCEED;
+
+    //Keep the parameters of the device, they are given to every request
+    memset(&entry->peer, 0, sizeof(entry->peer));
+    entry->peer.sin_family = AF_INET;
+    entry->peer.sin_port = htons(SNMP_PORT);
+    if(inet_aton(session->peername, &entry->peer.sin_addr) == 0)return FAIL;
+    entry->version = session->version;
+    entry->community = session->community;
+    entry->community_len = session->community_len;
+    entry->retries = session->retries < 0 ? 0 : session->retries;
+    entry->sess_timeout = session->timeout < 0 ? 1000000 : session->timeout;
+    //The deadline is a bit later than the one of net-snmp to be sure the request is expired
+    entry->timeout = entry->sess_timeout/1000 + 10;
+
+    loop_entry_send(entry);
+    return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: loop_entry_next                                                  *
+ *                                                                            *
+ * Purpose: Get the next request to send for an entry of the event loop       *
+ *                                                                            *
+ * Parameters: entry - A loop_entry_t pointer                                 *
+ *                                                                            *
+ * Return value:    1 - the request is in entry->monitor->pdu                 *
+ *                  0 - the monitoring and the ones chained to it are         *
+ *                      finished                                              *
+ *                                                                            *
+ * Comment: When a monitoring is finished, the one chained to it is started   *
+ *          on the same entry, so it reuses the data cached for the device    *
+ *          by the previous one (as the ifOperStatus of the interfaces).      *
+ *          If the device did not answer, the chained monitorings are         *
+ *          finished with a timeout without sending any request               *
+ ******************************************************************************/
+static short loop_entry_next(loop_entry_t *entry){
+    while(1){
+        if(entry->monitor->phase == MONITOR_PHASE_START)monitor_step(entry->monitor, STAT_SUCCESS, NULL);
+        if(entry->monitor->pdu != NULL)return 1;
+        if(entry->monitor->chained == NULL)return 0;
+        if(entry->monitor->status == STAT_TIMEOUT){
+            monitor_abort(entry->monitor->chained, STAT_TIMEOUT);
+            return 0;
+        }
+        entry->monitor = entry->monitor->chained;
+    }
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: loop_entry_send                                                  *
+ *                                                                            *
+ * Purpose: Send the pending request of a monitoring                          *
+ *                                                                            *
+ * Parameters: entry - A loop_entry_t pointer                                 *
+ *                                                                            *
+ * Comment: A copy of the request is kept while it can be sent again, the     *
+ *          entry is put in the done list if the monitoring is finished       *
+ ******************************************************************************/
+static void loop_entry_send(loop_entry_t *entry){
+    monitor_t *monitor;
+    struct snmp_pdu *pdu;
+    netsnmp_indexed_addr_pair *addr_pair;
+
+    while(loop_entry_next(entry)){
+        monitor = entry->monitor;
+        pdu = monitor->pdu;
+        monitor->pdu = NULL;
+        //Address the request to the device, it is sent from a shared socket
+        addr_pair = (netsnmp_indexed_addr_pair *)calloc(1, sizeof(netsnmp_indexed_addr_pair));
+        pdu->community = (u_char *)malloc(entry->community_len+1);
+        if(addr_pair == NULL || pdu->community == NULL){
+            free(addr_pair);
+            snmp_free_pdu(pdu);
+            monitor_step(monitor, STAT_ERROR, NULL);
+            continue;
+        }
+        memcpy(&addr_pair->remote_addr, &entry->peer, sizeof(entry->peer));
+        pdu->transport_data = addr_pair;
+        pdu->transport_data_length = sizeof(netsnmp_indexed_addr_pair);
+        memcpy(pdu->community, entry->community, entry->community_len);
+        pdu->community_len = entry->community_len;
+        pdu->version = entry->version;
+
+        //The retries are done by the loop as the socket is shared
+        entry->tries_left = monitor->pdu_no_retry ? 0 : entry->retries;
+        entry->request = entry->tries_left > 0 ? snmp_clone_pdu(pdu) : NULL;
+        entry->flight.nb_tries = 0;
+        if(loop_entry_transmit(entry, pdu) == SUCCEED){
+            monitor_trace_request(monitor);
+            return;
+        }
+
+        //If failure, the monitoring is given the error
+        snmp_free_pdu(entry->request);
+        entry->request = NULL;
+        stats_add(&stats.errors);
+        monitor_step(monitor, STAT_ERROR, NULL);
+    }
+    loop_entry_append(entry, &entry->loop->done);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: loop_entry_transmit                                              *
+ *                                                                            *
+ * Purpose: Send a request and wait for its response                          *
+ *                                                                            *
+ * Parameters: entry - A loop_entry_t pointer                                 *
+ *             pdu - the request addressed to the device, it is freed by the  *
+ *                   function if failure                                      *
+ *                                                                            *
+ * Return value:    SUCCEED - the request is sent                             *
+ *                  FAIL - the request can not be sent                        *
+ *                                                                            *
+ ******************************************************************************/
+static int loop_entry_transmit(loop_entry_t *entry, struct snmp_pdu *pdu){
+    snmp_sess_session(entry->sess_handle)->timeout = entry->sess_timeout;
+    if(snmp_sess_async_send(entry->sess_handle, pdu, loop_entry_callback, entry)){
+        flight_request(&entry->flight, pdu, stats_pdu(pdu, 0));
+        entry->deadline = loop_clock() + entry->timeout;
+        loop_entry_append(entry, &entry->loop->queue);
+        return SUCCEED;
+    }
+    snmp_free_pdu(pdu);
+    return FAIL;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: loop_entry_callback                                              *
+ *                                                                            *
+ * Purpose: Give the response of a request to its monitoring and send the     *
+ *          next request                                                      *
+ *                                                                            *
+ * Parameters: operation - the net-snmp callback operation                    *
+ *             session - the session of the request                           *
+ *             reqid - the id of the request                                  *
+ *             response - the response received                               *
+ *             magic - the loop_entry_t of the monitoring                     *
+ *                                                                            *
+ * Return value: 1 - the response has been handled                            *
+ *                                                                            *
+ * Comment: A response coming from another address than the one of the        *
+ *          device is dropped like a lost response                            *
+ ******************************************************************************/
+static int loop_entry_callback(int operation, struct snmp_session *session, int reqid, struct snmp_pdu *response, void *magic){
+    loop_entry_t *entry = (loop_entry_t *)magic;
+    struct snmp_pdu *pdu;
+    size_t bytes = 0;
+    int status;
+
+    if(entry->next != NULL)loop_entry_remove(entry);
+    if(operation == NETSNMP_CALLBACK_OP_RECEIVED_MESSAGE && response != NULL)bytes = stats_pdu(response, 1);
+    if(operation == NETSNMP_CALLBACK_OP_RECEIVED_MESSAGE && loop_entry_peer(entry, response)){
+        status = STAT_SUCCESS;
+    }else if(operation == NETSNMP_CALLBACK_OP_RECEIVED_MESSAGE || operation == NETSNMP_CALLBACK_OP_TIMED_OUT){
+        status = STAT_TIMEOUT;
+    }else{
+        status = STAT_ERROR;
+    }
+
+    //Send the request again while retries are left
+    if(status == STAT_TIMEOUT && entry->tries_left > 0){
+        entry->tries_left--;
+        stats_add(&stats.retries);
+        pdu = snmp_clone_pdu(entry->request);
+        if(pdu != NULL){
+            pdu->reqid = snmp_get_next_reqid();
+            if(loop_entry_transmit(entry, pdu) == SUCCEED)return 1;
+        }
+        status = STAT_ERROR;
+    }
+    snmp_free_pdu(entry->request);
+    entry->request = NULL;
+    if(status == STAT_TIMEOUT)stats_add(&stats.timeouts);
+    else if(status == STAT_ERROR)stats_add(&stats.errors);
+    monitor_trace_response(entry->monitor);
+    flight_response(&entry->flight, status, response, bytes);
+    device_flight_add(entry->monitor->device, &entry->flight);
+
+    monitor_step(entry->monitor, status, status == STAT_SUCCESS ? response : NULL);
+    loop_entry_send(entry);
+    return 1;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: loop_entry_peer                                                  *
+ *                                                                            *
+ * Purpose: Check if a response comes from the device of a monitoring         *
+ *                                                                            *
+ * Parameters: entry - A loop_entry_t pointer                                 *
+ *             response - the response received                               *
+ *                                                                            *
+ * Return value:    1 - the response comes from the device or its source is   *
+ *                      unknown                                               *
+ *                  0 - otherwise                                             *
+ *                                                                            *
+ ******************************************************************************/
+static short loop_entry_peer(loop_entry_t *entry, struct snmp_pdu *response){
+    struct sockaddr_in *from;
+
+    if(response == NULL || response->transport_data == NULL || response->transport_data_length < (int)sizeof(struct sockaddr_in))return 1;
+    from = (struct sockaddr_in *)response->transport_data;
+    if(from->sin_family != AF_INET)return 1;
+    if(from->sin_addr.s_addr != entry->peer.sin_addr.s_addr || from->sin_port != entry->peer.sin_port){
+        zabbix_log(LOG_LEVEL_DEBUG, "zbxmodHP: response from %s dropped, it is not the device polled", inet_ntoa(from->sin_addr));
+        return 0;
+    }
+    return 1;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: loop_entry_append                                                *
+ *                                                                            *
+ * Purpose: Add an entry at the end of a list of the event loop               *
+ *                                                                            *
+ * Parameters: entry - A loop_entry_t pointer                                 *
+ *             list - the head of the list                                    *
+ *                                                                            *
+ * Comment: As all the requests of a monitoring have the same timeout, the    *
+ *          queue stays sorted by deadline                                    *
+ ******************************************************************************/
+static void loop_entry_append(loop_entry_t *entry, loop_entry_t *list){
+    entry->prev = list->prev;
+    entry->next = list;
+    list->prev->next = entry;
+    list->prev = entry;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: loop_entry_remove                                                *
+ *                                                                            *
+ * Purpose: Remove an entry from its list                                     *
+ *                                                                            *
+ * Parameters: entry - A loop_entry_t pointer                                 *
+ *                                                                            *
+ ******************************************************************************/
+static void loop_entry_remove(loop_entry_t *entry){
+    entry->prev->next = entry->next;
+    entry->next->prev = entry->prev;
+    entry->prev = NULL;
+    entry->next = NULL;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: loop_clock                                                       *
+ *                                                                            *
+ * Purpose: Get the time used for the deadlines of the event loop             *
+ *                                                                            *
+ * Return value: the time of a monotonic clock in milliseconds                *
+ *                                                                            *
+ ******************************************************************************/
+static long long loop_clock(void){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec*1000 + ts.tv_nsec/1000000;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: monitor_step                                                     *
+ *                                                                            *
+ * Purpose: Give the response of the last request to a monitoring and         *
+ *          prepare its next request                                          *
+ *                                                                            *
+ * Parameters: monitor - A monitor_t pointer                                  *
+ *             status - the status of the last request                        *
+ *             response - the response of the last request                    *
+ *                                                                            *
+ * Comment: The next request is set in monitor->pdu, it is NULL when the      *
+ *          monitoring is finished                                            *
+ ******************************************************************************/
+static void monitor_step(monitor_t *monitor, int status, struct snmp_pdu *response){
+    oid oid_table_sys_uptime[] = {1,3,6,1,2,1,1,3,0};
+    int oid_len_sys_uptime = 9;
+    int i;
+
+    monitor->pdu = NULL;
+    switch(monitor->phase){
+        case MONITOR_PHASE_DONE:
+            return;
+
+        case MONITOR_PHASE_START:
+            if(trace_threshold > 0)monitor->trace_start = loop_clock();
+            //Check the circuit breaker of the device before sending any request
+            if(monitor->aborted)break;
+            switch(device_breaker_check(monitor->device)){
+                case BREAKER_OPEN:
+                    stats_add(&stats.breaker_skips);
+                    monitor->status = STAT_TIMEOUT;
+                    monitor_finish(monitor);
+                    return;
+                case BREAKER_HALF_OPEN:
+                    //Send a single probe without retry to check if the device answers again
+                    for(i=0;i<oid_len_sys_uptime;i++)monitor->oid_table_tmp[i] = oid_table_sys_uptime[i];
+                    monitor->oid_len_tmp = oid_len_sys_uptime;
+                    monitor_request_get(monitor);
+                    monitor->pdu_no_retry = 1;
+                    monitor->phase = MONITOR_PHASE_PROBE;
+                    return;
+            }
+            break;
+
+        case MONITOR_PHASE_PROBE:
+            if(monitor->aborted){
+                monitor->status = status;
+                monitor_finish(monitor);
+                return;
+            }
+            device_breaker_probe(status, monitor->device);
+            if(status == STAT_TIMEOUT){
+                monitor->status = STAT_TIMEOUT;
+                monitor_finish(monitor);
+                return;
+            }
+            break;
+
+        default:
+            //If failure, stop the monitoring with the error message
+            if(status != STAT_SUCCESS){
+                monitor->status = status;
+                monitor_finish(monitor);
+            }else if(response->errstat != SNMP_ERR_NOERROR){
+                monitor_fail(monitor, snmp_errstring(response->errstat));
+            }else if(monitor->type == MONITOR_IRF){
+                irf_monitor_step(monitor, response);
+            }else if(monitor->type == MONITOR_LACP){
+                lacp_monitor_step(monitor, response);
+            }else{
+                rrpp_monitor_step(monitor, response);
+            }
+            return;
+    }
+
+    //Start the monitoring
+    if(monitor->type == MONITOR_IRF){
+        monitor->phase = IRF_PHASE_STACK;
+        irf_monitor_next(monitor);
+    }else if(monitor->type == MONITOR_LACP){
+        monitor->phase = LACP_PHASE_WALK;
+        lacp_monitor_next(monitor);
+    }else{
+        monitor->phase = RRPP_PHASE_ENABLE;
+        rrpp_monitor_next(monitor);
+    }
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: monitor_finish                                                   *
+ *                                                                            *
+ * Purpose: Finish a monitoring and set its result depending on its status    *
+ *                                                                            *
+ * Parameters: monitor - A monitor_t pointer                                  *
+ *                                                                            *
+ ******************************************************************************/
+static void monitor_finish(monitor_t *monitor){
+    AGENT_RESULT *result = monitor->result;
+
+    monitor->phase = MONITOR_PHASE_DONE;
+    monitor->pdu = NULL;
+    if(!monitor->aborted)device_breaker_update(monitor->status, monitor->device);
+    monitor_trace_end(monitor);
+    if(monitor->status !=STAT_SUCCESS){
+
+        if (monitor->status == STAT_TIMEOUT){
+            if(monitor->mode != MONITOR_MODE_STATUS){
+                //The discovery keeps the entities discovered by the previous calls, the status of an entity has no timeout value
+                SET_MSG_RESULT(result, strdup("Request timeout"));
+                monitor->ret = SYSINFO_RET_FAIL;
+            }else if(monitor->type == MONITOR_IRF){
+                SET_UI64_RESULT(result, 4);
+                monitor->ret = SYSINFO_RET_OK;
+            }else{
+                SET_STR_RESULT(result, strdup("Request timeout"));
+                monitor->ret = SYSINFO_RET_OK;
+            }
+        }else if(monitor->status == STAT_ERR_INIT && monitor->type != MONITOR_IRF){
+            SET_MSG_RESULT(result, strdup("Error when Initializing SNMP session"));
+            monitor->ret = SYSINFO_RET_FAIL;
+        }
+        else if(monitor->ret == SYSINFO_RET_OK){
+            SET_MSG_RESULT(result, strdup("Unknown error in SNMP session"));
+            monitor->ret = SYSINFO_RET_FAIL;
+        }
+    }
+    //Free the structures, the aggregations cached by the device are kept for the next call
+    if(monitor->lacp_walk == &monitor->walk)agg_table_free(monitor->walk.agg);
+    else device_lacp_release(monitor->device);
+    monitor->walk.agg = NULL;
+    monitor->agg = NULL;
+    rrpp_table_free(monitor->rrpp);
+    monitor->rrpp = NULL;
+    irf_table_free(monitor->irf);
+    monitor->irf = NULL;
+    if_status_free(monitor->if_status, monitor->arena);
+    monitor->if_status = NULL;
+    text_struct_free(&monitor->text);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: monitor_fail                                                     *
+ *                                                                            *
+ * Purpose: Finish a monitoring with an error message                         *
+ *                                                                            *
+ * Parameters: monitor - A monitor_t pointer                                  *
+ *             msg - the error message                                        *
+ *                                                                            *
+ ******************************************************************************/
+static void monitor_fail(monitor_t *monitor, const char *msg){
+    SET_MSG_RESULT(monitor->result, strdup(msg));
+    monitor->ret = SYSINFO_RET_FAIL;
+    monitor->status = STAT_ERROR;
+    monitor_finish(monitor);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: monitor_trace_phase                                              *
+ *                                                                            *
+ * Purpose: Get the phase of a monitoring to which its request is accounted   *
+ *                                                                            *
+ * Parameters: monitor - A monitor_t pointer                                  *
+ *                                                                            *
+ * Return value: the phase, the walk of the ports attached to the             *
+ *               aggregations is TRACE_PHASE_ATTACHED_ID                      *
+ *                                                                            *
+ ******************************************************************************/
+static short monitor_trace_phase(monitor_t *monitor){
+    if(monitor->type == MONITOR_LACP && monitor->phase == LACP_PHASE_WALK && monitor->lacp_walk->phase == LACP_WALK_ATTACHED_ID){
+        return TRACE_PHASE_ATTACHED_ID;
+    }
+    return monitor->phase < TRACE_PHASES ? monitor->phase : 0;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: monitor_trace_request                                            *
+ *                                                                            *
+ * Purpose: Account a request sent to the phase of a monitoring               *
+ *                                                                            *
+ * Parameters: monitor - A monitor_t pointer                                  *
+ *                                                                            *
+ ******************************************************************************/
+static void monitor_trace_request(monitor_t *monitor){
+    if(trace_threshold <= 0)return;
+
+    monitor->trace_phase = monitor_trace_phase(monitor);
+    monitor->trace_pdus[monitor->trace_phase]++;
+    monitor->trace_mark = loop_clock();
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: monitor_trace_response                                           *
+ *                                                                            *
+ * Purpose: Account the time waited for a response to the phase of a          *
+ *          monitoring                                                        *
+ *                                                                            *
+ * Parameters: monitor - A monitor_t pointer                                  *
+ *                                                                            *
+ * Comment: The time of the retries of the request is included                *
+ ******************************************************************************/
+static void monitor_trace_response(monitor_t *monitor){
+    if(trace_threshold <= 0)return;
+
+    monitor->trace_time[monitor->trace_phase] += loop_clock() - monitor->trace_mark;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: monitor_trace_end                                                *
+ *                                                                            *
+ * Purpose: Add the phases of a finished monitoring to its device and log     *
+ *          them if the monitoring was too long                               *
+ *                                                                            *
+ * Parameters: monitor - A monitor_t pointer                                  *
+ *                                                                            *
+ * Comment: A monitoring that sent no request is not traced                   *
+ ******************************************************************************/
+static void monitor_trace_end(monitor_t *monitor){
+    char buf[256];
+    const char *name;
+    long long total;
+    size_t len = 0;
+    int nb_pdus = 0;
+    int i;
+
+    if(trace_threshold <= 0 || monitor->device == NULL)return;
+
+    for(i=0;i<TRACE_PHASES;i++)nb_pdus += monitor->trace_pdus[i];
+    if(nb_pdus == 0)return;
+    device_trace_add(monitor->device, monitor->type, monitor->trace_time, monitor->trace_pdus);
+
+    total = loop_clock() - monitor->trace_start;
+    if(total < trace_threshold)return;
+    buf[0] = '\0';
+    for(i=0;i<TRACE_PHASES && len < sizeof(buf);i++){
+        if(monitor->trace_pdus[i] == 0)continue;
+        name = trace_phase_names[monitor->type][i] != NULL ? trace_phase_names[monitor->type][i] : "unknown";
+        len += snprintf(buf + len, sizeof(buf) - len, "%s%s %lldms %d pdus", len == 0 ? "" : ", ", name, monitor->trace_time[i], monitor->trace_pdus[i]);
+    }
+    zabbix_log(LOG_LEVEL_DEBUG, "zbxmodHP: %s %s monitoring took %lldms (%s)", monitor->device->ip_address, trace_type_names[monitor->type], total, buf);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: monitor_request_get                                              *
+ *                                                                            *
+ * Purpose: Prepare an snmpget request of monitor->oid_table_tmp              *
+ *                                                                            *
+ * Parameters: monitor - A monitor_t pointer                                  *
+ *                                                                            *
+ ******************************************************************************/
+static void monitor_request_get(monitor_t *monitor){
+    monitor->pdu = snmp_pdu_create(SNMP_MSG_GET);
+    snmp_add_null_var(monitor->pdu, monitor->oid_table_tmp, monitor->oid_len_tmp);
+    monitor->pdu_no_retry = 0;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: monitor_check_oid                                                *
+ *                                                                            *
+ * Purpose: Check if the oid of a variable starts with a given oid            *
+ *                                                                            *
+ * Parameters: oid_table - the oid to check                                   *
+ *             oid_len - the lenght of the oid to check                       *
+ *             vars - the variable received                                   *
+ *                                                                            *
+ * Return value:    1 - the oid of the variable starts with the oid to check  *
+ *                  0 - otherwise                                             *
+ *                                                                            *
+ ******************************************************************************/
+static short monitor_check_oid(oid *oid_table, size_t oid_len, struct variable_list *vars){
+    size_t i;
+
+    if(vars->name_length < oid_len)return 0;
+    for(i=0;i<oid_len;i++){
+        //Compare the oid of the response with the oid to check
+        if(oid_table[i]!=vars->name[i])return 0;
+    }
+    return 1;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: table_walk_init                                                  *
+ *                                                                            *
+ * Purpose: Init a table_walk_t to walk the columns of a table                *
+ *                                                                            *
+ * Parameters: walk - A table_walk_t pointer                                  *
+ *             nb_index - the number of sub-identifiers of the index of the   *
+ *                        table                                               *
+ *             last_index - the index of the last row walked, 0 at the start. *
+ *                          It is kept by the caller so the walk can be       *
+ *                          resumed by another call                           *
+ *             row - the function called for every row, it returns 0 to stop  *
+ *                   the walk                                                 *
+ *                                                                            *
+ ******************************************************************************/
+static void table_walk_init(table_walk_t *walk, int nb_index, long *last_index, short (*row)(monitor_t *, long *, struct variable_list **)){
+    walk->nb_columns = 0;
+    walk->nb_index = nb_index;
+    walk->max_repetitions = MAX_BULK_REPETITION;
+    walk->last_index = last_index;
+    walk->row = row;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: table_walk_add_column                                            *
+ *                                                                            *
+ * Purpose: Add a column to the columns walked                                *
+ *                                                                            *
+ * Parameters: walk - A table_walk_t pointer                                  *
+ *             oid_table - the oid of the column                              *
+ *             oid_len - the lenght of the oid of the column                  *
+ *                                                                            *
+ * Comment: The rows of the walk are the ones of the first column, the other  *
+ *          columns are given as NULL for the rows they do not have           *
+ ******************************************************************************/
+static void table_walk_add_column(table_walk_t *walk, oid *oid_table, int oid_len){
+    if(walk->nb_columns >= MAX_WALK_COLUMNS || oid_len > MAX_WALK_OID_LEN)return;
+    memcpy(walk->columns[walk->nb_columns], oid_table, oid_len*sizeof(oid));
+    walk->columns_len[walk->nb_columns] = oid_len;
+    walk->nb_columns++;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: table_walk_request                                               *
+ *                                                                            *
+ * Purpose: Prepare the snmpbulkget request of the next rows of a walk        *
+ *                                                                            *
+ * Parameters: monitor - A monitor_t pointer                                  *
+ *             walk - A table_walk_t pointer                                  *
+ *                                                                            *
+ * Comment: The columns are requested together, so the max_repetitions of     *
+ *          the walk are shared between them                                  *
+ ******************************************************************************/
+static void table_walk_request(monitor_t *monitor, table_walk_t *walk){
+    oid oid_table[MAX_WALK_OID_LEN + MAX_WALK_INDEX];
+    size_t oid_len;
+    int i;
+    int j;
+
+    monitor->pdu = snmp_pdu_create(SNMP_MSG_GETBULK);
+    monitor->pdu->errstat = 0;   //Set getbulk non repeater
+    monitor->pdu->errindex = walk->max_repetitions/(walk->nb_columns ? walk->nb_columns : 1); //Set getbulk max repetition
+    monitor->pdu_no_retry = 0;
+    for(j=0;j<walk->nb_columns;j++){
+        memcpy(oid_table, walk->columns[j], walk->columns_len[j]*sizeof(oid));
+        oid_len = walk->columns_len[j];
+        //If more than one bulkrequest is necessery to get the all table
+        //then the next node to start the next request is the last index retrieve
+        if(walk->last_index[0] != 0){
+            for(i=0;i<walk->nb_index;i++)oid_table[oid_len++] = walk->last_index[i];
+        }
+        snmp_add_null_var(monitor->pdu, oid_table, oid_len);
+    }
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: table_walk_var                                                   *
+ *                                                                            *
+ * Purpose: Check if a variable received belongs to a column of a walk        *
+ *                                                                            *
+ * Parameters: walk - A table_walk_t pointer                                  *
+ *             column - the position of the column                            *
+ *             vars - the variable received                                   *
+ *                                                                            *
+ * Return value:    1 - the variable belongs to the column                    *
+ *                  0 - the end of the column is reached                      *
+ *                                                                            *
+ ******************************************************************************/
+static short table_walk_var(table_walk_t *walk, int column, struct variable_list *vars){
+    if(vars->type == SNMP_ENDOFMIBVIEW || vars->type == SNMP_NOSUCHOBJECT || vars->type == SNMP_NOSUCHINSTANCE)return 0;
+    if(vars->name_length < walk->columns_len[column] + walk->nb_index)return 0;
+    return memcmp(vars->name, walk->columns[column], walk->columns_len[column]*sizeof(oid)) == 0;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: table_walk_cmp                                                   *
+ *                                                                            *
+ * Purpose: Compare the index of a variable of a column with a row index      *
+ *                                                                            *
+ * Parameters: walk - A table_walk_t pointer                                  *
+ *             column - the position of the column                            *
+ *             vars - a variable of the column                                *
+ *             index - the index of the row                                   *
+ *                                                                            *
+ * Return value: a negative, zero or positive value if the index of the       *
+ *               variable is lower, equal or greater than the row index       *
+ *                                                                            *
+ ******************************************************************************/
+static int table_walk_cmp(table_walk_t *walk, int column, struct variable_list *vars, long *index){
+    int i;
+
+    for(i=0;i<walk->nb_index;i++){
+        if((long)vars->name[walk->columns_len[column]+i] != index[i])return (long)vars->name[walk->columns_len[column]+i] < index[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: table_walk_response                                              *
+ *                                                                            *
+ * Purpose: Give the rows of a response of a walk to its callback             *
+ *                                                                            *
+ * Parameters: monitor - A monitor_t pointer                                  *
+ *             walk - A table_walk_t pointer                                  *
+ *             response - the response of the last request                    *
+ *                                                                            *
+ * Return value:    1 - the walk is finished (end of the first column, or     *
+ *                      stopped by the callback), last_index is reset to 0    *
+ *                  0 - the next rows have to be requested                    *
+ *                                                                            *
+ * Comment: The variables of the response are interleaved, the one at the     *
+ *          position i belongs to the column i modulo the number of columns.  *
+ *          A row is only given when the other columns have been received up  *
+ *          to its index, otherwise it is requested again with the next rows  *
+ ******************************************************************************/
+static short table_walk_response(monitor_t *monitor, table_walk_t *walk, struct snmp_pdu *response){
+    struct variable_list *vars_table[MAX_BULK_REPETITION];
+    struct variable_list *values[MAX_WALK_COLUMNS];
+    struct variable_list *last[MAX_WALK_COLUMNS];
+    struct variable_list *vars;
+    long index[MAX_WALK_INDEX];
+    int cursor[MAX_WALK_COLUMNS];
+    int nb_columns = walk->nb_columns;
+    int nb_vars = 0;
+    int nb_rows = 0;
+    short finish = 0;
+    int i;
+    int j;
+
+    for(vars = response->variables; vars && nb_vars < MAX_BULK_REPETITION; vars = vars->next_variable)vars_table[nb_vars++] = vars;
+    if(nb_vars == 0 || nb_columns == 0)finish = 1;
+
+    //Get the last variable received for every other column, NULL if the column is finished
+    for(j=1;j<nb_columns;j++){
+        cursor[j] = j;
+        last[j] = NULL;
+        for(i=j;i<nb_vars;i=i+nb_columns){
+            if(!table_walk_var(walk, j, vars_table[i])){
+                last[j] = NULL;
+                break;
+            }
+            last[j] = vars_table[i];
+        }
+    }
+
+    for(i=0;i<nb_vars && !finish;i=i+nb_columns){
+        if(!table_walk_var(walk, 0, vars_table[i])){
+            finish = 1;
+            break;
+        }
+        for(j=0;j<walk->nb_index;j++)index[j] = vars_table[i]->name[walk->columns_len[0]+j];
+        //The row is kept for the next request if another column has not been received up to it
+        for(j=1;j<nb_columns && nb_rows > 0;j++){
+            if(last[j] != NULL && table_walk_cmp(walk, j, last[j], index) < 0)break;
+        }
+        if(j<nb_columns && nb_rows > 0)break;
+
+        //Find the variables of the row in the other columns
+        values[0] = vars_table[i];
+        for(j=1;j<nb_columns;j++){
+            values[j] = NULL;
+            while(cursor[j] < nb_vars && table_walk_var(walk, j, vars_table[cursor[j]]) && table_walk_cmp(walk, j, vars_table[cursor[j]], index) < 0)cursor[j] = cursor[j]+nb_columns;
+            if(cursor[j] < nb_vars && table_walk_var(walk, j, vars_table[cursor[j]]) && table_walk_cmp(walk, j, vars_table[cursor[j]], index) == 0){
+                values[j] = vars_table[cursor[j]];
+                cursor[j] = cursor[j]+nb_columns;
+            }
+        }
+        for(j=0;j<walk->nb_index;j++)walk->last_index[j] = index[j];
+        nb_rows++;
+        if(!walk->row(monitor, index, values))finish = 1;
+    }
+
+    if(finish){
+        for(j=0;j<walk->nb_index;j++)walk->last_index[j] = 0;
+    }
+    return finish;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: monitor_if_status_next                                           *
+ *                                                                            *
+ * Purpose: Get the ifOperStatus bitmap of the device of a monitoring         *
+ *                                                                            *
+ * Parameters: monitor - A monitor_t pointer                                  *
+ *                                                                            *
+ * Return value:    1 - the next request of the ifTable walk is prepared, or  *
+ *                      the monitoring is finished                            *
+ *                  0 - the bitmap is complete in monitor->if_status          *
+ *                                                                            *
+ * Comment: The bitmap cached by the device is used if it is recent enough,   *
+ *          so the lacp and rrpp monitorings of a device share the same walk  *
+ ******************************************************************************/
+static short monitor_if_status_next(monitor_t *monitor){
+    oid oid_table_if_oper_status[] = {1,3,6,1,2,1,2,2,1,8};
+    int oid_len_if_oper_status = 10 ;
+
+    if(monitor->if_status == NULL){
+        monitor->if_status = device_if_status_get(monitor->device, monitor->arena);
+        if(monitor->if_status == NULL)if_status_new(&monitor->if_status, monitor->arena);
+        if(monitor->if_status == NULL){
+            monitor_fail(monitor, "Cannot allocate memory");
+            return 1;
+        }
+        monitor->last_if_index = 0;
+    }
+    //The bitmap is complete when its time is set
+    if(monitor->if_status->time != 0)return 0;
+    table_walk_init(&monitor->table_walk, 1, &monitor->last_if_index, monitor_if_status_row);
+    table_walk_add_column(&monitor->table_walk, oid_table_if_oper_status, oid_len_if_oper_status);
+    table_walk_request(monitor, &monitor->table_walk);
+    return 1;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: monitor_if_status_row                                            *
+ *                                                                            *
+ * Purpose: Save the ifOperStatus of an interface of the ifTable walk         *
+ *                                                                            *
+ * Parameters: monitor - A monitor_t pointer                                  *
+ *             index - the ifIndex of the interface                           *
+ *             values - the ifOperStatus of the interface                     *
+ *                                                                            *
+ * Return value:    1 - the walk continues                                    *
+ *                  0 - the bitmap can not be grown, the monitoring is failed *
+ *                                                                            *
+ ******************************************************************************/
+static short monitor_if_status_row(monitor_t *monitor, long *index, struct variable_list **values){
+    if(if_status_add(index[0], values[0]->type == ASN_INTEGER ? *values[0]->val.integer : 0, monitor->if_status, monitor->arena) != SUCCEED){
+        monitor_fail(monitor, "Cannot allocate memory");
+        return 0;
+    }
+    return 1;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: monitor_if_status_step                                           *
+ *                                                                            *
+ * Purpose: Save the ifOperStatus of a response of the ifTable walk           *
+ *                                                                            *
+ * Parameters: monitor - A monitor_t pointer                                  *
+ *             response - the response of the last request                    *
+ *                                                                            *
+ * Comment: At the end of the walk the bitmap is cached by the device         *
+ ******************************************************************************/
+static void monitor_if_status_step(monitor_t *monitor, struct snmp_pdu *response){
+    if(table_walk_response(monitor, &monitor->table_walk, response) && monitor->phase != MONITOR_PHASE_DONE){
+        monitor->if_status->time = time(NULL);
+        device_if_status_set(monitor->device, monitor->if_status);
+    }
+}
+
+
+/******************************************************************************
+ *                                                                            *
+ * Function: hp_all_monitoring                                                *
+ *                                                                            *
+ * Purpose: Item to monitor the IRF, the LACP and the RRPP of a switch in one *
+ *          call                                                              *
+ *                                                                            *
+ * Parameters: request - structure that contains item key and parameters      *
+ *             result - structure that will contain result                    *
+ *                                                                            *
+ * Return value: SYSINFO_RET_FAIL - function failed, item will be marked      *
+ *                                 as not supported by zabbix                 *
+ *               SYSINFO_RET_OK - success                                     *
+ *                                                                            *
+ * Comment: The parameters are the ones of monitor.irf                        *
+ *                                                                            *
+ *          In case of success the result structure will contain a JSON       *
+ *          object with the value of monitor.irf, monitor.lacp and            *
+ *          monitor.rrpp in the "irf", "lacp" and "rrpp" members, or an       *
+ *          object with an "error" member if a monitoring failed              *
+ *                                                                            *
+ *          The IRF monitoring runs at the same time as the two others. The   *
+ *          RRPP monitoring is started when the LACP one is finished, so the  *
+ *          ifOperStatus of the interfaces are only walked once               *
+ ******************************************************************************/
+static int	hp_all_monitoring(AGENT_REQUEST *request, AGENT_RESULT *result)
+{
+    AGENT_REQUEST monitor_request;
+    char *params[4];
+    AGENT_RESULT results[3];
+    struct snmp_session sessions[3];
+    monitor_t monitors[3];
+    struct zbx_json j;
+    arena_t *arena;
+    int ret;
+    int i;
+
+    if(request->nparam <3){
+        SET_MSG_RESULT(result, strdup("Parameters Missing"));
+        return SYSINFO_RET_FAIL;
+    }
+    if(request->nparam >5){
+        SET_MSG_RESULT(result, strdup("Too many parameters"));
+        return SYSINFO_RET_FAIL;
+    }
+    for(i=0;i<3;i++)init_result(&results[i]);
+    arena = arena_acquire();
+
+    //The request of the LACP and the RRPP monitoring is the one of the IRF
+    //monitoring without the number of switches
+    memset(&monitor_request, 0, sizeof(monitor_request));
+    monitor_request.key = request->key;
+    monitor_request.nparam = request->nparam >3 ? request->nparam-1 : 2;
+    monitor_request.params = params;
+    params[0] = get_rparam(request, 0);
+    params[1] = get_rparam(request, 1);
+    for(i=3;i<request->nparam;i++)params[i-1] = get_rparam(request, i);
+
+    //The LACP monitoring is the last one initialised, as it is the only one
+    //that must be finished once initialised
+    ret = irf_monitoring_init(request, &results[0], &sessions[0], &monitors[0], arena);
+    if(ret == SYSINFO_RET_OK)ret = rrpp_monitoring_init(&monitor_request, &results[2], &sessions[2], &monitors[2], arena);
+    if(ret == SYSINFO_RET_OK)ret = lacp_monitoring_init(&monitor_request, &results[1], &sessions[1], &monitors[1], arena);
+    if(ret != SYSINFO_RET_OK){
+        for(i=0;i<3;i++){
+            if(ISSET_MSG(&results[i]))SET_MSG_RESULT(result, strdup(results[i].msg));
+            free_result(&results[i]);
+        }
+        arena_release(arena);
+        return SYSINFO_RET_FAIL;
+    }
+    monitors[1].chained = &monitors[2];
+
+    //Run the monitorings until all the requests have been answered
+    monitor_loop(sessions, monitors, 2, arena);
+
+    //Build the JSON object with the result of every monitoring
+    zbx_json_init(&j, ZBX_JSON_STAT_BUF_LEN);
+    monitor_result_json(&j, "irf", &results[0]);
+    monitor_result_json(&j, "lacp", &results[1]);
+    monitor_result_json(&j, "rrpp", &results[2]);
+    SET_STR_RESULT(result, strdup(j.buffer));
+    zbx_json_free(&j);
+
+    for(i=0;i<3;i++)free_result(&results[i]);
+    arena_release(arena);
+    return SYSINFO_RET_OK;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: lacp_fingerprint                                                 *
+ *                                                                            *
+ * Purpose: Item to get the fingerprint of the LACP state of a switch         *
+ *                                                                            *
+ * Parameters: request - structure that contains item key and parameters      *
+ *             result - structure that will contain result                    *
+ *                                                                            *
+ * Return value: SYSINFO_RET_FAIL - function failed, item will be marked      *
+ *                                 as not supported by zabbix                 *
+ *               SYSINFO_RET_OK - success                                     *
+ *                                                                            *
+ * Comment: The parameters are the ones of monitor.lacp                       *
+ *                                                                            *
+ *          In case of success the result structure will contain the          *
+ *          fingerprint of the value of monitor.lacp, 0 if everything is OK   *
+ ******************************************************************************/
+static int	lacp_fingerprint(AGENT_REQUEST *request, AGENT_RESULT *result)
+{
+    return fingerprint_monitoring(request, result, lacp_monitoring_init, 0);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: lacp_changes                                                     *
+ *                                                                            *
+ * Purpose: Item to monitor the LACP of a switch only when its state changes  *
+ *                                                                            *
+ * Parameters: request - structure that contains item key and parameters      *
+ *             result - structure that will contain result                    *
+ *                                                                            *
+ * Return value: SYSINFO_RET_FAIL - function failed, item will be marked      *
+ *                                 as not supported by zabbix                 *
+ *               SYSINFO_RET_OK - success                                     *
+ *                                                                            *
+ * Comment: The parameters are the ones of monitor.lacp                       *
+ *                                                                            *
+ *          In case of success the result structure will contain the value    *
+ *          of monitor.lacp (an empty string if everything is OK), or no data *
+ *          if the state is the same as at the previous call                  *
+ ******************************************************************************/
+static int	lacp_changes(AGENT_REQUEST *request, AGENT_RESULT *result)
+{
+    return fingerprint_monitoring(request, result, lacp_monitoring_init, 1);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: rrpp_fingerprint                                                 *
+ *                                                                            *
+ * Purpose: Item to get the fingerprint of the RRPP state of a switch         *
+ *                                                                            *
+ * Parameters: request - structure that contains item key and parameters      *
+ *             result - structure that will contain result                    *
+ *                                                                            *
+ * Return value: SYSINFO_RET_FAIL - function failed, item will be marked      *
+ *                                 as not supported by zabbix                 *
+ *               SYSINFO_RET_OK - success                                     *
+ *                                                                            *
+ * Comment: The parameters are the ones of monitor.rrpp                       *
+ *                                                                            *
+ *          In case of success the result structure will contain the          *
+ *          fingerprint of the value of monitor.rrpp, 0 if everything is OK   *
+ ******************************************************************************/
+static int	rrpp_fingerprint(AGENT_REQUEST *request, AGENT_RESULT *result)
+{
+    return fingerprint_monitoring(request, result, rrpp_monitoring_init, 0);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: rrpp_changes                                                     *
+ *                                                                            *
+ * Purpose: Item to monitor the RRPP of a switch only when its state changes  *
+ *                                                                            *
+ * Parameters: request - structure that contains item key and parameters      *
+ *             result - structure that will contain result                    *
+ *                                                                            *
+ * Return value: SYSINFO_RET_FAIL - function failed, item will be marked      *
+ *                                 as not supported by zabbix                 *
+ *               SYSINFO_RET_OK - success                                     *
+ *                                                                            *
+ * Comment: The parameters are the ones of monitor.rrpp                       *
+ *                                                                            *
+ *          In case of success the result structure will contain the value    *
+ *          of monitor.rrpp (an empty string if everything is OK), or no data *
+ *          if the state is the same as at the previous call                  *
+ ******************************************************************************/
+static int	rrpp_changes(AGENT_REQUEST *request, AGENT_RESULT *result)
+{
+    return fingerprint_monitoring(request, result, rrpp_monitoring_init, 1);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: fingerprint_monitoring                                           *
+ *                                                                            *
+ * Purpose: Run a monitoring and return the fingerprint of its value, or its  *
+ *          value only if it changed                                          *
+ *                                                                            *
+ * Parameters: request - structure that contains item key and parameters      *
+ *             result - structure that will contain result                    *
+ *             function - the function initialising the monitoring            *
+ *             changes - 0 to return the fingerprint, 1 to return the value   *
+ *                       if it changed since the previous call                *
+ *                                                                            *
+ * Return value: SYSINFO_RET_FAIL - function failed                           *
+ *               SYSINFO_RET_OK - success                                     *
+ *                                                                            *
+ * Comment: The fingerprint of the last value returned is kept by the device  *
+ *          for every type of monitoring. It is only updated when the value   *
+ *          is returned, so the fingerprint items do not hide any change      *
+ ******************************************************************************/
+static int fingerprint_monitoring(AGENT_REQUEST *request, AGENT_RESULT *result, int (*function)(AGENT_REQUEST *, AGENT_RESULT *, struct snmp_session *, monitor_t *, arena_t *), short changes){
+    struct snmp_session session;
+    monitor_t monitor;
+    AGENT_RESULT state;
+    const char *value;
+    zbx_uint64_t fingerprint;
+    arena_t *arena = arena_acquire();
+
+    init_result(&state);
+    if(function(request, &state, &session, &monitor, arena) == SYSINFO_RET_OK){
+        //Run the monitoring until all the requests have been answered
+        monitor_run(session, &monitor);
+    }else{
+        monitor.ret = SYSINFO_RET_FAIL;
+    }
+    arena_release(arena);
+
+    if(monitor.ret != SYSINFO_RET_OK){
+        SET_MSG_RESULT(result, strdup(ISSET_MSG(&state) ? state.msg : "Unknown error in SNMP session"));
+        free_result(&state);
+        return SYSINFO_RET_FAIL;
+    }
+
+    value = ISSET_STR(&state) ? state.str : "";
+    fingerprint = text_fingerprint(value);
+    if(!changes){
+        SET_UI64_RESULT(result, fingerprint);
+    }else if(device_fingerprint_swap(monitor.device, monitor.type, fingerprint)){
+        SET_STR_RESULT(result, strdup(value));
+    }
+    free_result(&state);
+    return SYSINFO_RET_OK;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: irf_fleet_monitoring                                             *
+ *                                                                            *
+ * Purpose: Item to monitor the IRF of many devices in one call               *
+ *                                                                            *
+ * Parameters: request - structure that contains item key and parameters      *
+ *             result - structure that will contain result                    *
+ *                                                                            *
+ * Return value: SYSINFO_RET_FAIL - function failed, item will be marked      *
+ *                                 as not supported by zabbix                 *
+ *               SYSINFO_RET_OK - success                                     *
+ *                                                                            *
+ * Comment: The parameters are the ones of monitor.irf, except the            *
+ *          first one which is a list of IP addresses separated by spaces or  *
+ *          semicolons, or the full path of a file of ZBXMODHP_FLEET_DIR      *
+ *          containing one IP address per line                                *
+ *                                                                            *
+ *          In case of success the result structure will contain a JSON       *
+ *          object mapping every device to the value of monitor.irf           *
+ ******************************************************************************/
+static int	irf_fleet_monitoring(AGENT_REQUEST *request, AGENT_RESULT *result)
+{
+    return fleet_monitoring(request, result, irf_monitoring_init);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: lacp_fleet_monitoring                                            *
+ *                                                                            *
+ * Purpose: Item to monitor the LACP of many devices in one call              *
+ *                                                                            *
+ * Parameters: request - structure that contains item key and parameters      *
+ *             result - structure that will contain result                    *
+ *                                                                            *
+ * Return value: SYSINFO_RET_FAIL - function failed, item will be marked      *
+ *                                 as not supported by zabbix                 *
+ *               SYSINFO_RET_OK - success                                     *
+ *                                                                            *
+ * Comment: The parameters are the ones of monitor.lacp, except the           *
+ *          first one which is a list of IP addresses separated by spaces or  *
+ *          semicolons, or the full path of a file of ZBXMODHP_FLEET_DIR      *
+ *          containing one IP address per line                                *
+ *                                                                            *
+ *          In case of success the result structure will contain a JSON       *
+ *          object mapping every device to the value of monitor.lacp          *
+ ******************************************************************************/
+static int	lacp_fleet_monitoring(AGENT_REQUEST *request, AGENT_RESULT *result)
+{
+    return fleet_monitoring(request, result, lacp_monitoring_init);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: rrpp_fleet_monitoring                                            *
+ *                                                                            *
+ * Purpose: Item to monitor the RRPP of many devices in one call              *
+ *                                                                            *
+ * Parameters: request - structure that contains item key and parameters      *
+ *             result - structure that will contain result                    *
+ *                                                                            *
+ * Return value: SYSINFO_RET_FAIL - function failed, item will be marked      *
+ *                                 as not supported by zabbix                 *
+ *               SYSINFO_RET_OK - success                                     *
+ *                                                                            *
+ * Comment: The parameters are the ones of monitor.rrpp, except the           *
+ *          first one which is a list of IP addresses separated by spaces or  *
+ *          semicolons, or the full path of a file of ZBXMODHP_FLEET_DIR      *
+ *          containing one IP address per line                                *
+ *                                                                            *
+ *          In case of success the result structure will contain a JSON       *
+ *          object mapping every device to the value of monitor.rrpp          *
+ ******************************************************************************/
+static int	rrpp_fleet_monitoring(AGENT_REQUEST *request, AGENT_RESULT *result)
+{
+    return fleet_monitoring(request, result, rrpp_monitoring_init);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: fleet_monitoring                                                 *
+ *                                                                            *
+ * Purpose: Run a monitoring function against a list of devices               *
+ *                                                                            *
+ * Parameters: request - structure that contains item key and parameters      *
+ *             result - structure that will contain result                    *
+ *             function - the monitoring function to run for every device     *
+ *                                                                            *
+ * Return value: SYSINFO_RET_FAIL - function failed                           *
+ *               SYSINFO_RET_OK - success                                     *
+ *                                                                            *
+ * Comment: All the devices are polled at the same time by monitor_loop       *
+ *          The JSON object contains the value returned for every device, or  *
+ *          an object with an "error" member if the function failed           *
+ ******************************************************************************/
+static int fleet_monitoring(AGENT_REQUEST *request, AGENT_RESULT *result, int (*function)(AGENT_REQUEST *, AGENT_RESULT *, struct snmp_session *, monitor_t *, arena_t *)){
+    AGENT_REQUEST device_request;
+    char *params[MAX_FLEET_PARAMS];
+    char **hosts;
+    int nb_hosts;
+    AGENT_RESULT *results;
+    struct snmp_session *sessions;
+    monitor_t *monitors;
+    struct zbx_json j;
+    arena_t *arena;
+    const char *error;
+    int i;
+    
+    //Check if mandatory parameters are provided
+    if(request->nparam <2){
+        SET_MSG_RESULT(result, strdup("Parameters Missing"));
+        return SYSINFO_RET_FAIL;
+    }
+    if(request->nparam >MAX_FLEET_PARAMS){
+        SET_MSG_RESULT(result, strdup("Too many parameters"));
+        return SYSINFO_RET_FAIL;
+    }
+    
+    //Get the list of the devices to poll
+    arena = arena_acquire();
+    nb_hosts = fleet_hosts_load(get_rparam(request, 0), &hosts, arena, &error);
+    if(nb_hosts <0){
+        arena_release(arena);
+        SET_MSG_RESULT(result, strdup(error));
+        return SYSINFO_RET_FAIL;
+    }
+    results = (AGENT_RESULT *)arena_alloc(arena, sizeof(AGENT_RESULT)*(nb_hosts+1));
+    sessions = (struct snmp_session *)arena_alloc(arena, sizeof(struct snmp_session)*(nb_hosts+1));
+    monitors = (monitor_t *)arena_alloc(arena, sizeof(monitor_t)*(nb_hosts+1));
+    if(results == NULL || sessions == NULL || monitors == NULL){
+        arena_free(arena, monitors);
+        arena_free(arena, sessions);
+        arena_free(arena, results);
+        fleet_hosts_free(hosts, nb_hosts, arena);
+        arena_release(arena);
+        SET_MSG_RESULT(result, strdup("Cannot allocate memory"));
+        return SYSINFO_RET_FAIL;
+    }
+    
+    //The request of every device is the request of the fleet with the
+    //IP address of the device as first parameter
+    memset(&device_request, 0, sizeof(device_request));
+    device_request.key = request->key;
+    device_request.nparam = request->nparam;
+    device_request.params = params;
+    for(i=1;i<request->nparam;i++)params[i] = get_rparam(request, i);
+    for(i=0;i<nb_hosts;i++){
+        init_result(&results[i]);
+        params[0] = hosts[i];
+        //A device with invalid parameters is not polled
+        memset(&monitors[i], 0, sizeof(monitor_t));
+        monitors[i].phase = MONITOR_PHASE_DONE;
+        function(&device_request, &results[i], &sessions[i], &monitors[i], arena);
+    }
+    
+    //Poll all the devices at the same time
+    monitor_loop(sessions, monitors, nb_hosts, arena);
+    
+    //Build the JSON object with the result of every device
+    zbx_json_init(&j, ZBX_JSON_STAT_BUF_LEN);
+    for(i=0;i<nb_hosts;i++){
+        monitor_result_json(&j, hosts[i], &results[i]);
+        free_result(&results[i]);
+    }
+    SET_STR_RESULT(result, strdup(j.buffer));
+    zbx_json_free(&j);
+    
+    arena_free(arena, monitors);
+    arena_free(arena, sessions);
+    arena_free(arena, results);
+    fleet_hosts_free(hosts, nb_hosts, arena);
+    arena_release(arena);
+    return SYSINFO_RET_OK;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: monitor_result_json                                              *
+ *                                                                            *
+ * Purpose: Add the result of a monitoring to a JSON object                   *
+ *                                                                            *
+ * Parameters: j - the JSON object                                            *
+ *             name - the name of the member                                  *
+ *             result - the result of the monitoring                          *
+ *                                                                            *
+ * Comment: An error message is added as an object with an "error" member     *
+ ******************************************************************************/
+static void monitor_result_json(struct zbx_json *j, const char *name, AGENT_RESULT *result){
+    if(ISSET_MSG(result)){
+        zbx_json_addobject(j, name);
+        zbx_json_addstring(j, "error", result->msg, ZBX_JSON_TYPE_STRING);
+        zbx_json_close(j);
+    }else if(ISSET_UI64(result)){
+        zbx_json_adduint64(j, name, result->ui64);
+    }else if(ISSET_STR(result)){
+        zbx_json_addstring(j, name, result->str, ZBX_JSON_TYPE_STRING);
+    }else{
+        zbx_json_addstring(j, name, "", ZBX_JSON_TYPE_STRING);
+    }
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: fleet_hosts_load                                                 *
+ *                                                                            *
+ * Purpose: Build the list of the devices of a fleet                          *
+ *                                                                            *
+ * Parameters: hosts_param - IP addresses separated by spaces or semicolons,  *
+ *                           or the full path of a file                       *
+ *             hosts - A pointer that will contain the list of IP addresses   *
+ *             arena - the arena of the list, NULL to use malloc              *
+ *             error - A pointer that will contain the error message          *
+ *                                                                            *
+ * Return value:    the number of devices                                     *
+ *                  -1 if failure, error is then set                          *
+ *                                                                            *
+ * Comment: In a file, empty lines and lines starting with # are ignored      *
+ *          Only the files of the ZBXMODHP_FLEET_DIR directory can be read    *
+ *          The tokens which are not IP addresses are ignored                 *
+ ******************************************************************************/
+static int fleet_hosts_load(const char *hosts_param, char ***hosts, arena_t *arena, const char **error){
+    FILE *file = NULL;
+    char path[PATH_MAX];
+    char *line = NULL;
+    size_t line_size = 0;
+    size_t dir_len;
+    char *buffer;
+    char *token;
+    char *saveptr;
+    int nb_hosts = 0;
+    int max_hosts = 16;
+    
+    *error = "Cannot allocate memory";
+    *hosts = (char **)arena_alloc(arena, sizeof(char *)*max_hosts);
+    if(*hosts == NULL)return -1;
+    if(hosts_param == NULL)return 0;
+    
+    if(hosts_param[0] == '/'){
+        //The file must be in the directory allowed, once the links are resolved
+        dir_len = strlen(fleet_dir);
+        if(dir_len == 0){
+            *error = "Files of devices are disabled, ZBXMODHP_FLEET_DIR is not set";
+        }else if(realpath(hosts_param, path) == NULL){
+            *error = "Cannot read the list of devices";
+        }else if(strncmp(path, fleet_dir, dir_len) != 0 || path[dir_len] != '/'){
+            *error = "The file of devices is not in ZBXMODHP_FLEET_DIR";
+        }else{
+            file = fopen(path, "r");
+            if(file == NULL)*error = "Cannot read the list of devices";
+        }
+        if(file == NULL){
+            arena_free(arena, *hosts);
+            *hosts = NULL;
+            return -1;
+        }
+    }
+    
+    if(file == NULL){
+        //The parameter itself is split in IP addresses
+        buffer = arena_strdup(arena, hosts_param);
+        if(buffer == NULL){
+            arena_free(arena, *hosts);
+            *hosts = NULL;
+            return -1;
+        }
+        for(token = strtok_r(buffer, " ;\t\r\n", &saveptr); token !=NULL && nb_hosts >= 0; token = strtok_r(NULL, " ;\t\r\n", &saveptr)){
+            nb_hosts = fleet_hosts_add(token, hosts, nb_hosts, &max_hosts, arena);
+        }
+        arena_free(arena, buffer);
+    }else{
+        //Every line of the file is split in IP addresses, whatever its length
+        while(nb_hosts >= 0 && getline(&line, &line_size, file) != -1){
+            if(line[0] == '#')continue;
+            for(token = strtok_r(line, " ;\t\r\n", &saveptr); token !=NULL && nb_hosts >= 0; token = strtok_r(NULL, " ;\t\r\n", &saveptr)){
+                nb_hosts = fleet_hosts_add(token, hosts, nb_hosts, &max_hosts, arena);
+            }
+        }
+        free(line);
+        fclose(file);
+    }
+    if(nb_hosts < 0){
+        *hosts = NULL;
+        return -1;
+    }
+    return nb_hosts;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: fleet_hosts_add                                                  *
+ *                                                                            *
+ * Purpose: Add an IP address at the end of the list of the devices           *
+ *                                                                            *
+ * Parameters: token - the IP address read                                    *
+ *             hosts - A pointer of the list of IP addresses                  *
+ *             nb_hosts - the number of devices of the list                   *
+ *             max_hosts - A pointer of the size of the list                  *
+ *             arena - the arena of the list, NULL to use malloc              *
+ *                                                                            *
+ * Return value:    the new number of devices                                 *
+ *                  -1 if failure, the list is then freed                     *
+ *                                                                            *
+ * Comment: A token which is not an IP address is ignored, so the content of  *
+ *          the file is never returned                                        *
+ ******************************************************************************/
+static int fleet_hosts_add(const char *token, char ***hosts, int nb_hosts, int *max_hosts, arena_t *arena){
+    char **new_hosts;
+    char *host;
+
+    if(is_valid_ip(token) != 0){
+        zabbix_log(LOG_LEVEL_DEBUG, "zbxmodHP: a token of the list of devices is not an IP address, it is ignored");
+        return nb_hosts;
+    }
+    if(nb_hosts == *max_hosts){
+        new_hosts = (char **)arena_realloc(arena, *hosts, sizeof(char *)*(*max_hosts), sizeof(char *)*(*max_hosts)*2);
+        if(new_hosts == NULL){
+            fleet_hosts_free(*hosts, nb_hosts, arena);
+            return -1;
+        }
+        *hosts = new_hosts;
+        *max_hosts = *max_hosts*2;
+    }
+    host = arena_strdup(arena, token);
+    if(host == NULL){
+        fleet_hosts_free(*hosts, nb_hosts, arena);
+        return -1;
+    }
+    (*hosts)[nb_hosts++] = host;
+    return nb_hosts;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: fleet_hosts_free                                                 *
+ *                                                                            *
+ * Purpose: Free a list of devices built by fleet_hosts_load                  *
+ *                                                                            *
+ * Parameters: hosts - the list of IP addresses                               *
+ *             nb_hosts - the number of devices                               *
+ *             arena - the arena of the list, NULL if it comes from malloc    *
+ *                                                                            *
+ ******************************************************************************/
+static void fleet_hosts_free(char **hosts, int nb_hosts, arena_t *arena){
+    int i;
+    if(hosts == NULL)return;
+    for(i=0;i<nb_hosts;i++)arena_free(arena, hosts[i]);
+    arena_free(arena, hosts);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: module_stats                                                     *
+ *                                                                            *
+ * Purpose: Item to get the statistics of the module                          *
+ *                                                                            *
+ * Parameters: request - structure that contains item key and parameters      *
+ *             result - structure that will contain result                    *
+ *                                                                            *
+ * Return value: SYSINFO_RET_FAIL - function failed, item will be marked      *
+ *                                 as not supported by zabbix                 *
+ *               SYSINFO_RET_OK - success                                     *
+ *                                                                            *
+ * Comment: The item has no parameter                                         *
+ *                                                                            *
+ *          In case of success the result structure will contain a JSON       *
+ *          object with the counters of the process running the item since    *
+ *          it loaded the module, and the histogram of the duration of every  *
+ *          key called at least once                                          *
+ ******************************************************************************/
+static int	module_stats(AGENT_REQUEST *request, AGENT_RESULT *result)
+{
+    stats_t counters;
+    stats_latency_t *latency;
+    struct zbx_json j;
+    char buf[32];
+    int i;
+    int k;
+
+    latency = (stats_latency_t *)malloc(sizeof(stats_latency));
+    if(latency == NULL){
+        SET_MSG_RESULT(result, strdup("Cannot allocate memory"));
+        return SYSINFO_RET_FAIL;
+    }
+    //Copy the counters so the lock is not held while the JSON is built
+    pthread_mutex_lock(&stats_lock);
+    counters = stats;
+    memcpy(latency, stats_latency, sizeof(stats_latency));
+    pthread_mutex_unlock(&stats_lock);
+
+    zbx_json_init(&j, ZBX_JSON_STAT_BUF_LEN);
+    zbx_json_adduint64(&j, "pid", (zbx_uint64_t)getpid());
+    zbx_json_addobject(&j, "pdus_sent");
+    for(i=0;i<STATS_PDU_TYPES;i++)zbx_json_adduint64(&j, stats_pdu_names[i], counters.pdus_sent[i]);
+    zbx_json_close(&j);
+    zbx_json_addobject(&j, "pdus_received");
+    for(i=0;i<STATS_PDU_TYPES;i++)zbx_json_adduint64(&j, stats_pdu_names[i], counters.pdus_received[i]);
+    zbx_json_close(&j);
+    zbx_json_adduint64(&j, "bytes_sent", counters.bytes_sent);
+    zbx_json_adduint64(&j, "bytes_received", counters.bytes_received);
+    zbx_json_adduint64(&j, "retries", counters.retries);
+    zbx_json_adduint64(&j, "timeouts", counters.timeouts);
+    zbx_json_adduint64(&j, "errors", counters.errors);
+    zbx_json_adduint64(&j, "breaker_skips", counters.breaker_skips);
+    zbx_json_addobject(&j, "cache");
+    for(i=0;i<STATS_CACHES;i++){
+        zbx_json_addobject(&j, stats_cache_names[i]);
+        zbx_json_adduint64(&j, "hits", counters.cache_hits[i]);
+        zbx_json_adduint64(&j, "misses", counters.cache_misses[i]);
+        zbx_json_close(&j);
+    }
+    zbx_json_close(&j);
+
+    //The buckets are named by their upper bound in milliseconds, the empty ones are skipped
+    zbx_json_addobject(&j, "keys");
+    for(i=0;keys[i].key != NULL;i++){
+        if(latency[i].calls == 0)continue;
+        zbx_json_addobject(&j, keys[i].key);
+        zbx_json_adduint64(&j, "calls", latency[i].calls);
+        zbx_json_adduint64(&j, "failures", latency[i].failures);
+        zbx_json_adduint64(&j, "sum_ms", latency[i].sum);
+        zbx_json_adduint64(&j, "max_ms", latency[i].max);
+        zbx_json_addobject(&j, "buckets");
+        for(k=0;k<STATS_LATENCY_BUCKETS;k++){
+            if(latency[i].buckets[k] == 0)continue;
+            snprintf(buf, sizeof(buf), ZBX_FS_UI64, stats_latency_bound(k));
+            zbx_json_adduint64(&j, buf, latency[i].buckets[k]);
+        }
+        zbx_json_close(&j);
+        zbx_json_close(&j);
+    }
+    zbx_json_close(&j);
+
+    SET_STR_RESULT(result, strdup(j.buffer));
+    zbx_json_free(&j);
+    free(latency);
+    return SYSINFO_RET_OK;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: module_trace                                                     *
+ *                                                                            *
+ * Purpose: Item to get the phases of the monitorings of a device             *
+ *                                                                            *
+ * Parameters: request - structure that contains item key and parameters      *
+ *             result - structure that will contain result                    *
+ *                                                                            *
+ * Return value: SYSINFO_RET_FAIL - function failed, item will be marked      *
+ *                                 as not supported by zabbix                 *
+ *               SYSINFO_RET_OK - success                                     *
+ *                                                                            *
+ * Comment: The parameter of the request is the IP address of the device      *
+ *                                                                            *
+ *          In case of success the result structure will contain a JSON       *
+ *          object with, for every phase of the monitorings of the device     *
+ *          run by the process, the number of monitorings, the requests sent  *
+ *          and the total and maximum duration                                *
+ *                                                                            *
+ *          The tracing threshold of the module must be greater than 0        *
+ ******************************************************************************/
+static int	module_trace(AGENT_REQUEST *request, AGENT_RESULT *result)
+{
+    trace_t trace[MONITOR_TYPES*TRACE_PHASES];
+    trace_t *phase;
+    struct zbx_json j;
+    char *ip_address;
+    int type;
+    int i;
+
+    if(trace_threshold <= 0){
+        SET_MSG_RESULT(result, strdup("Tracing disabled"));
+        return SYSINFO_RET_FAIL;
+    }
+    if(request->nparam < 1){
+        SET_MSG_RESULT(result, strdup("Parameters Missing"));
+        return SYSINFO_RET_FAIL;
+    }
+    if(request->nparam > 1){
+        SET_MSG_RESULT(result, strdup("Too many parameters"));
+        return SYSINFO_RET_FAIL;
+    }
+    ip_address = get_rparam(request, 0);
+    if(is_valid_ip(ip_address)){
+        SET_MSG_RESULT(result, strdup("Invalid IP Address"));
+        return SYSINFO_RET_FAIL;
+    }
+
+    memset(trace, 0, sizeof(trace));
+    device_trace_get(device_struct_get(ip_address), trace);
+
+    //Only the phases that sent requests are given
+    zbx_json_init(&j, ZBX_JSON_STAT_BUF_LEN);
+    for(type=0;type<MONITOR_TYPES;type++){
+        zbx_json_addobject(&j, trace_type_names[type]);
+        for(i=0;i<TRACE_PHASES;i++){
+            phase = &trace[type*TRACE_PHASES + i];
+            if(phase->calls == 0 || trace_phase_names[type][i] == NULL)continue;
+            zbx_json_addobject(&j, trace_phase_names[type][i]);
+            zbx_json_adduint64(&j, "calls", phase->calls);
+            zbx_json_adduint64(&j, "pdus", phase->pdus);
+            zbx_json_adduint64(&j, "sum_ms", phase->sum);
+            zbx_json_adduint64(&j, "max_ms", phase->max);
+            zbx_json_close(&j);
+        }
+        zbx_json_close(&j);
+    }
+
+    SET_STR_RESULT(result, strdup(j.buffer));
+    zbx_json_free(&j);
+    return SYSINFO_RET_OK;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: module_recorder                                                  *
+ *                                                                            *
+ * Purpose: Item to dump the last SNMP exchanges with a device                *
+ *                                                                            *
+ * Parameters: request - structure that contains item key and parameters      *
+ *             result - structure that will contain result                    *
+ *                                                                            *
+ * Return value: SYSINFO_RET_FAIL - function failed, item will be marked      *
+ *                                 as not supported by zabbix                 *
+ *               SYSINFO_RET_OK - success                                     *
+ *                                                                            *
+ * Comment: The parameter of the request is the IP address of the device      *
+ *                                                                            *
+ *          In case of success the result structure will contain a JSON       *
+ *          object with the last FLIGHT_RECORDER_LEN exchanges of the         *
+ *          process with the device, from the oldest                          *
+ ******************************************************************************/
+static int	module_recorder(AGENT_REQUEST *request, AGENT_RESULT *result)
+{
+    flight_t *flights;
+    flight_t *flight;
+    struct zbx_json j;
+    char oid_buf[MAX_WALK_OID_LEN*11+1];
+    char *ip_address;
+    size_t len;
+    size_t k;
+    int nb_flights;
+    int i;
+
+    if(request->nparam < 1){
+        SET_MSG_RESULT(result, strdup("Parameters Missing"));
+        return SYSINFO_RET_FAIL;
+    }
+    if(request->nparam > 1){
+        SET_MSG_RESULT(result, strdup("Too many parameters"));
+        return SYSINFO_RET_FAIL;
+    }
+    ip_address = get_rparam(request, 0);
+    if(is_valid_ip(ip_address)){
+        SET_MSG_RESULT(result, strdup("Invalid IP Address"));
+        return SYSINFO_RET_FAIL;
+    }
+
+    flights = (flight_t *)malloc(sizeof(flight_t)*FLIGHT_RECORDER_LEN);
+    if(flights == NULL){
+        SET_MSG_RESULT(result, strdup("Cannot allocate memory"));
+        return SYSINFO_RET_FAIL;
+    }
+    nb_flights = device_flight_get(device_struct_get(ip_address), flights);
+
+    zbx_json_init(&j, ZBX_JSON_STAT_BUF_LEN);
+    zbx_json_addarray(&j, "exchanges");
+    for(i=0;i<nb_flights;i++){
+        flight = &flights[i];
+        //The oid is written with numbers only, as the MIBs may not be loaded
+        len = 0;
+        oid_buf[0] = '\0';
+        for(k=0;k<flight->name_length && len < sizeof(oid_buf);k++){
+            len += snprintf(oid_buf + len, sizeof(oid_buf) - len, ".%lu", (unsigned long)flight->name[k]);
+        }
+        zbx_json_addobject(&j, NULL);
+        zbx_json_addstring(&j, "oid", oid_buf, ZBX_JSON_TYPE_STRING);
+        zbx_json_addstring(&j, "type", stats_pdu_names[stats_pdu_type(flight->command)], ZBX_JSON_TYPE_STRING);
+        zbx_json_adduint64(&j, "varbinds", flight->nb_vars);
+        zbx_json_adduint64(&j, "tries", flight->nb_tries);
+        zbx_json_adduint64(&j, "request_time", flight->request_time);
+        zbx_json_adduint64(&j, "request_bytes", flight->request_bytes);
+        zbx_json_adduint64(&j, "response_time", flight->response_time);
+        zbx_json_adduint64(&j, "duration_ms", flight->response_time - flight->request_time);
+        if(flight->status == STAT_SUCCESS){
+            zbx_json_addstring(&j, "outcome", flight->errstat == SNMP_ERR_NOERROR ? "success" : snmp_errstring(flight->errstat), ZBX_JSON_TYPE_STRING);
+            zbx_json_adduint64(&j, "response_varbinds", flight->response_vars);
+            zbx_json_adduint64(&j, "response_bytes", flight->response_bytes);
+        }else{
+            zbx_json_addstring(&j, "outcome", flight->status == STAT_TIMEOUT ? "timeout" : "error", ZBX_JSON_TYPE_STRING);
+        }
+        zbx_json_close(&j);
+    }
+    zbx_json_close(&j);
+
+    SET_STR_RESULT(result, strdup(j.buffer));
+    zbx_json_free(&j);
+    free(flights);
+    return SYSINFO_RET_OK;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_module_init                                                  *
+ *                                                                            *
+ * Purpose: the function is called on agent startup                           *
+ *          It should be used to call any initialization routines             *
+ *                                                                            *
+ * Return value: ZBX_MODULE_OK - success                                      *
+ *               ZBX_MODULE_FAIL - module initialization failed               *
+ *                                                                            *
+ * Comment: the module won't be loaded in case of ZBX_MODULE_FAIL             *
+ *          The tracing threshold is read from ZBXMODHP_TRACE_THRESHOLD_MS    *
+ *          The directory of the files of devices is read from                *
+ *          ZBXMODHP_FLEET_DIR                                                *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_module_init()
+{
+    char *threshold;
+    char *dir;
+    char *end;
+    long value;
+
+    init_snmp("redundantProtocolsMonitoring");
+
+    //The tracing threshold built in the module can be changed without rebuilding it
+    threshold = getenv("ZBXMODHP_TRACE_THRESHOLD_MS");
+    if(threshold != NULL && *threshold != '\0'){
+        value = strtol(threshold, &end, 10);
+        if(*end != '\0' || value < 0){
+            zabbix_log(LOG_LEVEL_WARNING, "zbxmodHP: invalid ZBXMODHP_TRACE_THRESHOLD_MS \"%s\", the threshold stays %ld ms", threshold, trace_threshold);
+        }else{
+            trace_threshold = value;
+        }
+    }
+
+    //The fleet functions only read the files of this directory, the links are resolved so they can not leave it
+    dir = getenv("ZBXMODHP_FLEET_DIR");
+    fleet_dir[0] = '\0';
+    if(dir != NULL && *dir != '\0' && realpath(dir, fleet_dir) == NULL){
+        zabbix_log(LOG_LEVEL_WARNING, "zbxmodHP: invalid ZBXMODHP_FLEET_DIR \"%s\", the files of devices are disabled", dir);
+        fleet_dir[0] = '\0';
+    }
+    return ZBX_MODULE_OK;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: zbx_module_uninit                                                *
+ *                                                                            *
+ * Purpose: the function is called on agent shutdown                          *
+ *          It should be used to cleanup used resources if there are any      *
+ *                                                                            *
+ * Return value: ZBX_MODULE_OK - success                                      *
+ *               ZBX_MODULE_FAIL - function failed                            *
+ *                                                                            *
+ ******************************************************************************/
+int	zbx_module_uninit()
+{
+    device_struct_free(devices);
+    devices = NULL;
+    arena_pool_free();
+    loop_pool_free();
+    return ZBX_MODULE_OK;
+}
+
+
+/******************************************************************************
+ *                                                                            *
+ * Function: is_valid_ip                                                      *
+ *                                                                            *
+ * Purpose: Check if the IP address is a valid one                            *
+ *                                                                            *
+ * Parameters: src - string containing an IP address                          *
+ *                                                                            *
+ * Return value:    0 - the IP address is valid                               *
+ *                  1 - the IP address is invalid                             *
+ *                                                                            *
+ * Comment: The source code come from the inet_pton4 function                 *
+ *          of the inet_pton.c file of glibc                                  *
+ ******************************************************************************/
+static int is_valid_ip(const char *src)
+{
+    static const char digits[] = "0123456789";
+    int saw_digit, octets, ch;
+    unsigned char tmp[INADDRS], *tp;
+    
+    saw_digit = 0;
+    octets = 0;
+    tp = tmp;
+    *tp = 0;
+    while((ch = *src++) != '\0') {
+        const char *pch;
+        
+        if((pch = strchr(digits, ch)) != NULL) {
+            unsigned int val = *tp * 10 + (unsigned int)(pch - digits);
+            
+            if(saw_digit && *tp == 0)
+                return (1);
+            if(val > 255)
+                return (1);
+            *tp = (unsigned char)val;
+            if(! saw_digit) {
+                if(++octets > 4)
+                    return (1);
+                saw_digit = 1;
+            }
+        }
+        else if(ch == '.' && saw_digit) {
+            if(octets == 4)
+                return (1);
+            *++tp = 0;
+            saw_digit = 0;
+        }
+        else
+            return (1);
+    }
+    if(octets < 4)
+        return 1;
+    return 0;
+}
+/******************************************************************************
+ *                                                                            *
+ * Function: device_breaker_check                                             *
+ *                                                                            *
+ * Purpose: Check the circuit breaker of a device before polling it           *
+ *                                                                            *
+ * Parameters: device - A device_struct_t pointer                             *
+ *                                                                            *
+ * Return value:    BREAKER_CLOSED - the device can be polled                 *
+ *                  BREAKER_OPEN - the device is considered unreachable       *
+ *                  BREAKER_HALF_OPEN - the caller must send a probe and      *
+ *                                      give its status to                    *
+ *                                      device_breaker_probe                  *
+ *                                                                            *
+ * Comment: When the breaker is open no request is sent until the backoff     *
+ *          delay is elapsed. Then a single caller is allowed to probe the    *
+ *          device, the others still consider it unreachable                  *
+ ******************************************************************************/
+static int device_breaker_check(device_struct_t *device){
+    int state;
+    time_t now;
+
+    if(device == NULL)return BREAKER_CLOSED;
+
+    //While the backoff delay is not elapsed (or another probe is running) the device is skipped
+    pthread_mutex_lock(&devices_lock);
+    now = time(NULL);
+    state = BREAKER_CLOSED;
+    if(device->breaker_state == BREAKER_HALF_OPEN || (device->breaker_state == BREAKER_OPEN && now < device->breaker_retry)){
+        state = BREAKER_OPEN;
+    }
+    else if(device->breaker_state == BREAKER_OPEN){
+        device->breaker_state = BREAKER_HALF_OPEN;
+        state = BREAKER_HALF_OPEN;
+    }
+    pthread_mutex_unlock(&devices_lock);
+    return state;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: device_breaker_probe                                             *
+ *                                                                            *
+ * Purpose: Update the circuit breaker of a device with the status of a probe *
+ *                                                                            *
+ * Parameters: status - the status of the probe (a get of sysUpTime)          *
+ *             device - A device_struct_t pointer                             *
+ *                                                                            *
+ * Comment: If the probe succeeds the breaker is closed, otherwise it is      *
+ *          opened again with a doubled backoff delay                         *
+ ******************************************************************************/
+static void device_breaker_probe(int status, device_struct_t *device){
+    if(device == NULL)return;
+
+    pthread_mutex_lock(&devices_lock);
+    if(status == STAT_TIMEOUT){
+        if(device->breaker_backoff*2 < BREAKER_BACKOFF_MAX)device->breaker_backoff = device->breaker_backoff*2;
+        else device->breaker_backoff = BREAKER_BACKOFF_MAX;
+        device->breaker_retry = time(NULL) + device->breaker_backoff;
+        device->breaker_state = BREAKER_OPEN;
+    }
+    else{
+        zabbix_log(LOG_LEVEL_INFORMATION, "zbxmodHP: %s answers again, circuit breaker closed", device->ip_address);
+        device->nb_timeouts = 0;
+        device->breaker_backoff = BREAKER_BACKOFF_MIN;
+        device->breaker_state = BREAKER_CLOSED;
+    }
+    pthread_mutex_unlock(&devices_lock);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: device_breaker_update                                            *
+ *                                                                            *
+ * Purpose: Update the circuit breaker of a device with the status of a poll  *
+ *                                                                            *
+ * Parameters: status - the status of the last snmp request of the poll       *
+ *             device - A device_struct_t pointer                             *
+ *                                                                            *
+ * Comment: The breaker is opened after BREAKER_THRESHOLD consecutive polls   *
+ *          ending with a timeout                                             *
+ ******************************************************************************/
+static void device_breaker_update(int status, device_struct_t *device){
+    if(device == NULL)return;
+    
+    pthread_mutex_lock(&devices_lock);
+    if(device->breaker_state == BREAKER_CLOSED){
+        if(status != STAT_TIMEOUT){
+            device->nb_timeouts = 0;
+        }
+        else if(++device->nb_timeouts >= BREAKER_THRESHOLD){
+            zabbix_log(LOG_LEVEL_WARNING, "zbxmodHP: %s timed out %d times, circuit breaker opened", device->ip_address, device->nb_timeouts);
+            device->breaker_backoff = BREAKER_BACKOFF_MIN;
+            device->breaker_retry = time(NULL) + device->breaker_backoff;
+            device->breaker_state = BREAKER_OPEN;
+        }
+    }
+    pthread_mutex_unlock(&devices_lock);
+}
+
+
+/******************************************************************************
+ *                                                                            *
+ * Function: device_lacp_acquire                                              *
+ *                                                                            *
+ * Purpose: Take the aggregations cached by a device for a lacp monitoring    *
+ *                                                                            *
+ * Parameters: device - A device_struct_t pointer                             *
+ *                                                                            *
+ * Return value:    1 - the aggregations and the walk of the device can be    *
+ *                      used until device_lacp_release is called              *
+ *                  0 - they are already used by another thread               *
+ *                                                                            *
+ ******************************************************************************/
+static int device_lacp_acquire(device_struct_t *device){
+    int acquired = 0;
+
+    if(device == NULL)return 0;
+
+    pthread_mutex_lock(&devices_lock);
+    if(!device->lacp_busy){
+        device->lacp_busy = 1;
+        acquired = 1;
+    }
+    pthread_mutex_unlock(&devices_lock);
+    return acquired;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: device_lacp_release                                              *
+ *                                                                            *
+ * Purpose: Give back the aggregations cached by a device                     *
+ *                                                                            *
+ * Parameters: device - A device_struct_t pointer                             *
+ *                                                                            *
+ ******************************************************************************/
+static void device_lacp_release(device_struct_t *device){
+    if(device == NULL)return;
+
+    pthread_mutex_lock(&devices_lock);
+    device->lacp_busy = 0;
+    pthread_mutex_unlock(&devices_lock);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: device_if_status_get                                             *
+ *                                                                            *
+ * Purpose: Get a copy of the ifOperStatus bitmap cached by a device          *
+ *                                                                            *
+ * Parameters: device - A device_struct_t pointer                             *
+ *             arena - the arena of the copy, NULL to use malloc              *
+ *                                                                            *
+ * Return value:    the copy of the bitmap                                    *
+ *                  NULL if the device has no bitmap walked for less than     *
+ *                  IF_STATUS_MAX_AGE seconds                                 *
+ *                                                                            *
+ ******************************************************************************/
+static if_status_t * device_if_status_get(device_struct_t *device, arena_t *arena){
+    if_status_t *status = NULL;
+
+    if(device == NULL)return NULL;
+
+    pthread_mutex_lock(&devices_lock);
+    if(device->if_status != NULL && time(NULL) - device->if_status->time < IF_STATUS_MAX_AGE){
+        status = if_status_copy(device->if_status, arena);
+    }
+    pthread_mutex_unlock(&devices_lock);
+    stats_cache(STATS_CACHE_IF_STATUS, status != NULL);
+    return status;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: device_if_status_set                                             *
+ *                                                                            *
+ * Purpose: Cache the ifOperStatus bitmap of a device for the next calls      *
+ *                                                                            *
+ * Parameters: device - A device_struct_t pointer                             *
+ *             status - the bitmap walked, it is copied                       *
+ *                                                                            *
+ ******************************************************************************/
+static void device_if_status_set(device_struct_t *device, if_status_t *status){
+    if(device == NULL)return;
+
+    //The copy of the previous call is overwritten
+    pthread_mutex_lock(&devices_lock);
+    if_status_assign(&device->if_status, status);
+    pthread_mutex_unlock(&devices_lock);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: device_rrpp_get                                                  *
+ *                                                                            *
+ * Purpose: Get a copy of the rings evaluated for a device                    *
+ *                                                                            *
+ * Parameters: device - A device_struct_t pointer                             *
+ *             arena - the arena of the copy, NULL to use malloc              *
+ *                                                                            *
+ * Return value:    the copy of the rings                                     *
+ *                  NULL if the device has no rings evaluated for less than   *
+ *                  IF_STATUS_MAX_AGE seconds                                 *
+ *                                                                            *
+ ******************************************************************************/
+static rrpp_table_t * device_rrpp_get(device_struct_t *device, arena_t *arena){
+    rrpp_table_t *table = NULL;
+
+    if(device == NULL)return NULL;
+
+    pthread_mutex_lock(&devices_lock);
+    if(device->rrpp != NULL && time(NULL) - device->rrpp->time < IF_STATUS_MAX_AGE){
+        table = rrpp_table_copy(device->rrpp, arena);
+    }
+    pthread_mutex_unlock(&devices_lock);
+    stats_cache(STATS_CACHE_RRPP, table != NULL);
+    return table;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: device_rrpp_set                                                  *
+ *                                                                            *
+ * Purpose: Cache the rings evaluated for a device for the next calls         *
+ *                                                                            *
+ * Parameters: device - A device_struct_t pointer                             *
+ *             table - the rings evaluated, they are copied                   *
+ *                                                                            *
+ ******************************************************************************/
+static void device_rrpp_set(device_struct_t *device, rrpp_table_t *table){
+    if(device == NULL)return;
+
+    //The copy of the previous call is overwritten
+    pthread_mutex_lock(&devices_lock);
+    rrpp_table_assign(&device->rrpp, table);
+    pthread_mutex_unlock(&devices_lock);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: device_irf_get                                                   *
+ *                                                                            *
+ * Purpose: Get a copy of the members evaluated for a device                  *
+ *                                                                            *
+ * Parameters: device - A device_struct_t pointer                             *
+ *             arena - the arena of the copy, NULL to use malloc              *
+ *                                                                            *
+ * Return value:    the copy of the members                                   *
+ *                  NULL if the device has no members evaluated for less than *
+ *                  IF_STATUS_MAX_AGE seconds                                 *
+ *                                                                            *
+ ******************************************************************************/
+static irf_table_t * device_irf_get(device_struct_t *device, arena_t *arena){
+    irf_table_t *table = NULL;
+
+    if(device == NULL)return NULL;
+
+    pthread_mutex_lock(&devices_lock);
+    if(device->irf != NULL && time(NULL) - device->irf->time < IF_STATUS_MAX_AGE){
+        table = irf_table_copy(device->irf, arena);
+    }
+    pthread_mutex_unlock(&devices_lock);
+    stats_cache(STATS_CACHE_IRF, table != NULL);
+    return table;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: device_irf_set                                                   *
+ *                                                                            *
+ * Purpose: Cache the members evaluated for a devicefor the next calls        *
+ *                                                                            *
+ * Parameters: device - A device_struct_t pointer                             *
+ *             table - the members evaluated, they are copied                 *
+ *                                                                            *
+ ******************************************************************************/
+static void device_irf_set(device_struct_t *device, irf_table_t *table){
+    if(device == NULL)return;
+
+    //The copy of the previous call is overwritten
+    pthread_mutex_lock(&devices_lock);
+    irf_table_assign(&device->irf, table);
+    pthread_mutex_unlock(&devices_lock);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: device_fingerprint_swap                                          *
+ *                                                                            *
+ * Purpose: Replace the fingerprint of the last value returned for a device   *
+ *                                                                            *
+ * Parameters: device - A device_struct_t pointer                             *
+ *             type - MONITOR_IRF, MONITOR_LACP or MONITOR_RRPP               *
+ *             fingerprint - the fingerprint of the new value                 *
+ *                                                                            *
+ * Return value:    1 - the fingerprint changed or none was kept              *
+ *                  0 - the fingerprint is the same as the last one           *
+ *                                                                            *
+ ******************************************************************************/
+static short device_fingerprint_swap(device_struct_t *device, short type, zbx_uint64_t fingerprint){
+    short changed;
+
+    if(device == NULL)return 1;
+
+    pthread_mutex_lock(&devices_lock);
+    changed = !device->fingerprint_set[type] || device->fingerprint[type] != fingerprint;
+    device->fingerprint[type] = fingerprint;
+    device->fingerprint_set[type] = 1;
+    pthread_mutex_unlock(&devices_lock);
+    return changed;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: device_lacp_flaps_update                                         *
+ *                                                                            *
+ * Purpose: Record the transitions of the ports of the aggregations of a      *
+ *          device                                                            *
+ *                                                                            *
+ * Parameters: device - A device_struct_t pointer                             *
+ *             table - the aggregations evaluated                             *
+ *             status - the if_status_t used for the evaluation               *
+ *                                                                            *
+ ******************************************************************************/
+static void device_lacp_flaps_update(device_struct_t *device, agg_table_t *table, if_status_t *status){
+    agg_struct_t *agg_tmp;
+    short port_status;
+    int i;
+
+    if(device == NULL)return;
+
+    pthread_mutex_lock(&devices_lock);
+    for(agg_tmp = agg_table_next(table, NULL); agg_tmp != NULL; agg_tmp = agg_table_next(table, agg_tmp)){
+        for(i=0;i<agg_tmp->nb_ports;i++){
+            port_status = if_status_get(table->ports[agg_tmp->first_port+i], status);
+            if(port_status == PORT_UNKNOWN)continue;
+            if(flap_table_update(table->ports[agg_tmp->first_port+i], port_status, status->time, &device->port_flaps) != SUCCEED)break;
+        }
+    }
+    pthread_mutex_unlock(&devices_lock);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: device_lacp_flaps_count                                          *
+ *                                                                            *
+ * Purpose: Count the transitions of the ports of the aggregations of a       *
+ *          device during a window                                            *
+ *                                                                            *
+ * Parameters: device - A device_struct_t pointer                             *
+ *             table - the aggregations of the device                         *
+ *             window - the length of the window in seconds                   *
+ *                                                                            *
+ * Return value: the number of transitions                                    *
+ *                                                                            *
+ ******************************************************************************/
+static zbx_uint64_t device_lacp_flaps_count(device_struct_t *device, agg_table_t *table, long window){
+    agg_struct_t *agg_tmp;
+    time_t since = time(NULL) - window;
+    zbx_uint64_t nb = 0;
+    int i;
+
+    if(device == NULL)return 0;
+
+    pthread_mutex_lock(&devices_lock);
+    for(agg_tmp = agg_table_next(table, NULL); agg_tmp != NULL; agg_tmp = agg_table_next(table, agg_tmp)){
+        for(i=0;i<agg_tmp->nb_ports;i++){
+            nb += flap_table_count(table->ports[agg_tmp->first_port+i], since, device->port_flaps);
+        }
+    }
+    pthread_mutex_unlock(&devices_lock);
+    return nb;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: device_rrpp_flaps_update                                         *
+ *                                                                            *
+ * Purpose: Record the transitions of the rings of a device                   *
+ *                                                                            *
+ * Parameters: device - A device_struct_t pointer                             *
+ *             table - the rings evaluated                                    *
+ *             time - the time of the evaluation                              *
+ *                                                                            *
+ ******************************************************************************/
+static void device_rrpp_flaps_update(device_struct_t *device, rrpp_table_t *table, time_t time){
+    rrpp_struct_t *rrpp_tmp;
+
+    if(device == NULL)return;
+
+    pthread_mutex_lock(&devices_lock);
+    for(rrpp_tmp = rrpp_table_next(table, NULL); rrpp_tmp != NULL; rrpp_tmp = rrpp_table_next(table, rrpp_tmp)){
+        if(flap_table_update(rrpp_tmp->key, rrpp_tmp->status, time, &device->ring_flaps) != SUCCEED)break;
+    }
+    pthread_mutex_unlock(&devices_lock);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: device_rrpp_flaps_count                                          *
+ *                                                                            *
+ * Purpose: Count the transitions of the rings of a device during a window    *
+ *                                                                            *
+ * Parameters: device - A device_struct_t pointer                             *
+ *             table - the rings of the device                                *
+ *             window - the length of the window in seconds                   *
+ *                                                                            *
+ * Return value: the number of transitions                                    *
+ *                                                                            *
+ ******************************************************************************/
+static zbx_uint64_t device_rrpp_flaps_count(device_struct_t *device, rrpp_table_t *table, long window){
+    rrpp_struct_t *rrpp_tmp;
+    time_t since = time(NULL) - window;
+    zbx_uint64_t nb = 0;
+
+    if(device == NULL)return 0;
+
+    pthread_mutex_lock(&devices_lock);
+    for(rrpp_tmp = rrpp_table_next(table, NULL); rrpp_tmp != NULL; rrpp_tmp = rrpp_table_next(table, rrpp_tmp)){
+        nb += flap_table_count(rrpp_tmp->key, since, device->ring_flaps);
+    }
+    pthread_mutex_unlock(&devices_lock);
+    return nb;
+}
+
+
+/******************************************************************************
+ *                                                                            *
+ * Function: device_trace_add                                                 *
+ *                                                                            *
+ * Purpose: Add the phases of a monitoring to the ones of its device          *
+ *                                                                            *
+ * Parameters: device - A device_struct_t pointer                             *
+ *             type - MONITOR_IRF, MONITOR_LACP or MONITOR_RRPP               *
+ *             time - the time spent in every phase in milliseconds           *
+ *             pdus - the number of requests of every phase                   *
+ *                                                                            *
+ * Comment: The phases of the device are allocated on the first call          *
+ ******************************************************************************/
+static void device_trace_add(device_struct_t *device, short type, long long *time, int *pdus){
+    trace_t *trace;
+    int i;
+
+    if(device == NULL)return;
+
+    pthread_mutex_lock(&devices_lock);
+    if(device->trace == NULL)device->trace = (trace_t *)calloc(MONITOR_TYPES*TRACE_PHASES, sizeof(trace_t));
+    if(device->trace != NULL){
+        for(i=0;i<TRACE_PHASES;i++){
+            if(pdus[i] == 0)continue;
+            trace = &device->trace[type*TRACE_PHASES + i];
+            trace->calls++;
+            trace->pdus += pdus[i];
+            trace->sum += time[i];
+            if((zbx_uint64_t)time[i] > trace->max)trace->max = time[i];
+        }
+    }
+    pthread_mutex_unlock(&devices_lock);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: device_trace_get                                                 *
+ *                                                                            *
+ * Purpose: Get a copy of the phases of the monitorings of a device           *
+ *                                                                            *
+ * Parameters: device - A device_struct_t pointer                             *
+ *             trace - an array of MONITOR_TYPES*TRACE_PHASES trace_t that    *
+ *                     will contain the copy                                  *
+ *                                                                            *
+ * Return value:    1 - the device has been traced                            *
+ *                  0 - otherwise, the array is left unchanged                *
+ *                                                                            *
+ ******************************************************************************/
+static short device_trace_get(device_struct_t *device, trace_t *trace){
+    short found = 0;
+
+    if(device == NULL)return 0;
+
+    pthread_mutex_lock(&devices_lock);
+    if(device->trace != NULL){
+        memcpy(trace, device->trace, MONITOR_TYPES*TRACE_PHASES*sizeof(trace_t));
+        found = 1;
+    }
+    pthread_mutex_unlock(&devices_lock);
+    return found;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: device_flight_add                                                *
+ *                                                                            *
+ * Purpose: Add an SNMP exchange to the flight recorder of a device           *
+ *                                                                            *
+ * Parameters: device - A device_struct_t pointer                             *
+ *             flight - the exchange, it is copied                            *
+ *                                                                            *
+ * Comment: The recorder is allocated on the first call, then the oldest      *
+ *          exchange is replaced once FLIGHT_RECORDER_LEN are kept            *
+ ******************************************************************************/
+static void device_flight_add(device_struct_t *device, flight_t *flight){
+    flight_recorder_t *recorder;
+
+    if(device == NULL)return;
+
+    pthread_mutex_lock(&devices_lock);
+    if(device->recorder == NULL)device->recorder = (flight_recorder_t *)calloc(1, sizeof(flight_recorder_t));
+    recorder = device->recorder;
+    if(recorder != NULL){
+        recorder->flights[recorder->next] = *flight;
+        recorder->next = (recorder->next + 1) % FLIGHT_RECORDER_LEN;
+        if(recorder->nb_flights < FLIGHT_RECORDER_LEN)recorder->nb_flights++;
+    }
+    pthread_mutex_unlock(&devices_lock);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: device_flight_get                                                *
+ *                                                                            *
+ * Purpose: Get a copy of the SNMP exchanges recorded for a device            *
+ *                                                                            *
+ * Parameters: device - A device_struct_t pointer                             *
+ *             flights - an array of FLIGHT_RECORDER_LEN flight_t that will   *
+ *                       contain the exchanges, from the oldest               *
+ *                                                                            *
+ * Return value: the number of exchanges copied                               *
+ *                                                                            *
+ ******************************************************************************/
+static int device_flight_get(device_struct_t *device, flight_t *flights){
+    flight_recorder_t *recorder;
+    int first;
+    int i;
+    int nb = 0;
+
+    if(device == NULL)return 0;
+
+    pthread_mutex_lock(&devices_lock);
+    recorder = device->recorder;
+    if(recorder != NULL){
+        nb = recorder->nb_flights;
+        first = (recorder->next - nb + FLIGHT_RECORDER_LEN) % FLIGHT_RECORDER_LEN;
+        for(i=0;i<nb;i++)flights[i] = recorder->flights[(first + i) % FLIGHT_RECORDER_LEN];
+    }
+    pthread_mutex_unlock(&devices_lock);
+    return nb;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: stats_add                                                        *
+ *                                                                            *
+ * Purpose: Increment a counter of the module statistics                      *
+ *                                                                            *
+ * Parameters: counter - a member of the stats structure                      *
+ *                                                                            *
+ ******************************************************************************/
+static void stats_add(zbx_uint64_t *counter){
+    pthread_mutex_lock(&stats_lock);
+    (*counter)++;
+    pthread_mutex_unlock(&stats_lock);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: stats_cache                                                      *
+ *                                                                            *
+ * Purpose: Count a lookup in a cache kept by the devices                     *
+ *                                                                            *
+ * Parameters: cache - STATS_CACHE_IF_STATUS, STATS_CACHE_AGG,                *
+ *                     STATS_CACHE_RRPP or STATS_CACHE_IRF                    *
+ *             hit - 1 if the cached data is used, 0 if it must be polled     *
+ *                                                                            *
+ ******************************************************************************/
+static void stats_cache(short cache, short hit){
+    pthread_mutex_lock(&stats_lock);
+    if(hit)stats.cache_hits[cache]++;
+    else stats.cache_misses[cache]++;
+    pthread_mutex_unlock(&stats_lock);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: stats_pdu                                                        *
+ *                                                                            *
+ * Purpose: Count a PDU sent or received by the event loop                    *
+ *                                                                            *
+ * Parameters: pdu - the PDU                                                  *
+ *             received - 1 for a response, 0 for a request                   *
+ *                                                                            *
+ * Return value: the size of the message computed by stats_pdu_bytes          *
+ *                                                                            *
+ ******************************************************************************/
+static size_t stats_pdu(struct snmp_pdu *pdu, short received){
+    short type = stats_pdu_type(pdu->command);
+    size_t bytes = stats_pdu_bytes(pdu);
+
+    pthread_mutex_lock(&stats_lock);
+    if(received){
+        stats.pdus_received[type]++;
+        stats.bytes_received += bytes;
+    }else{
+        stats.pdus_sent[type]++;
+        stats.bytes_sent += bytes;
+    }
+    pthread_mutex_unlock(&stats_lock);
+    return bytes;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: stats_pdu_type                                                   *
+ *                                                                            *
+ * Purpose: Get the counter of a type of PDU                                  *
+ *                                                                            *
+ * Parameters: command - the command of the PDU                               *
+ *                                                                            *
+ * Return value: the STATS_PDU_* index of the type                            *
+ *                                                                            *
+ ******************************************************************************/
+static short stats_pdu_type(int command){
+    switch(command){
+        case SNMP_MSG_GET:
+            return STATS_PDU_GET;
+        case SNMP_MSG_GETNEXT:
+            return STATS_PDU_GETNEXT;
+        case SNMP_MSG_GETBULK:
+            return STATS_PDU_GETBULK;
+        case SNMP_MSG_RESPONSE:
+            return STATS_PDU_RESPONSE;
+        case SNMP_MSG_REPORT:
+            return STATS_PDU_REPORT;
+    }
+    return STATS_PDU_OTHER;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: stats_pdu_bytes                                                  *
+ *                                                                            *
+ * Purpose: Compute the size of the SNMP message of a PDU                     *
+ *                                                                            *
+ * Parameters: pdu - the PDU                                                  *
+ *                                                                            *
+ * Return value: the size of the BER encoding of the message                  *
+ *                                                                            *
+ * Comment: net-snmp does not give the size of the datagrams to the           *
+ *          callbacks, so it is computed from the PDU as a v1/v2c message.    *
+ *          Integers are encoded on their minimal length, the other values    *
+ *          on their val_len                                                  *
+ ******************************************************************************/
+static size_t stats_pdu_bytes(struct snmp_pdu *pdu){
+    struct variable_list *vars;
+    size_t varbinds = 0;
+    size_t value;
+    size_t len;
+
+    for(vars = pdu->variables; vars != NULL; vars = vars->next_variable){
+        switch(vars->type){
+            case ASN_INTEGER:
+            case ASN_COUNTER:
+            case ASN_GAUGE:
+            case ASN_TIMETICKS:
+                value = vars->val.integer != NULL ? stats_ber_int(*vars->val.integer) : 0;
+                break;
+            case ASN_OBJECT_ID:
+                value = vars->val.objid != NULL ? stats_ber_oid(vars->val.objid, vars->val_len/sizeof(oid)) : 0;
+                break;
+            default:
+                value = vars->val_len;
+                break;
+        }
+        varbinds += stats_ber_len(stats_ber_len(stats_ber_oid(vars->name, vars->name_length)) + stats_ber_len(value));
+    }
+    //The PDU has the request id, the error status and the error index before the varbinds
+    len = stats_ber_len(stats_ber_int(pdu->reqid)) + stats_ber_len(stats_ber_int(pdu->errstat)) + stats_ber_len(stats_ber_int(pdu->errindex)) + stats_ber_len(varbinds);
+    //The message has the version and the community before the PDU
+    len = stats_ber_len(stats_ber_int(pdu->version)) + stats_ber_len(pdu->community_len) + stats_ber_len(len);
+    return stats_ber_len(len);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: stats_ber_len                                                    *
+ *                                                                            *
+ * Purpose: Compute the size of a BER element from the size of its content    *
+ *                                                                            *
+ * Parameters: len - the size of the content                                  *
+ *                                                                            *
+ * Return value: the size of the tag, the length and the content              *
+ *                                                                            *
+ ******************************************************************************/
+static size_t stats_ber_len(size_t len){
+    size_t size = 2;
+    size_t value;
+
+    if(len >= 128){
+        for(value = len; value > 0; value >>= 8)size++;
+    }
+    return size + len;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: stats_ber_oid                                                    *
+ *                                                                            *
+ * Purpose: Compute the size of the BER encoding of an oid                    *
+ *                                                                            *
+ * Parameters: name - the oid                                                 *
+ *             name_length - the number of sub-identifiers of the oid         *
+ *                                                                            *
+ * Return value: the size of the content of the oid                           *
+ *                                                                            *
+ ******************************************************************************/
+static size_t stats_ber_oid(oid *name, size_t name_length){
+    size_t size = 0;
+    size_t i;
+    oid value;
+
+    //The two first sub-identifiers are encoded together
+    for(i = name_length > 1 ? 1 : 0; i<name_length; i++){
+        value = i == 1 ? name[0]*40 + name[1] : name[i];
+        for(size++; value >= 128; value >>= 7)size++;
+    }
+    return size;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: stats_ber_int                                                    *
+ *                                                                            *
+ * Purpose: Compute the size of the BER encoding of an integer                *
+ *                                                                            *
+ * Parameters: value - the integer                                            *
+ *                                                                            *
+ * Return value: the size of the content of the integer                       *
+ *                                                                            *
+ ******************************************************************************/
+static size_t stats_ber_int(long value){
+    size_t size = 1;
+
+    while(value >= 128 || value < -128){
+        value >>= 8;
+        size++;
+    }
+    return size;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: stats_latency_bucket                                             *
+ *                                                                            *
+ * Purpose: Get the bucket of the latency histograms of a duration            *
+ *                                                                            *
+ * Parameters: duration - the duration in milliseconds                        *
+ *                                                                            *
+ * Return value: the index of the bucket                                      *
+ *                                                                            *
+ * Comment: The buckets are 1ms wide below 4ms, then every power of two is    *
+ *          split in 4 buckets. The last bucket also counts the longer        *
+ *          durations                                                         *
+ ******************************************************************************/
+static int stats_latency_bucket(zbx_uint64_t duration){
+    zbx_uint64_t value;
+    int bits = 0;
+    int bucket;
+
+    if(duration < 4)return (int)duration;
+    for(value = duration; value >= 8; value >>= 1)bits++;
+    bucket = 4*(bits+1) + (int)(value-4);
+    return bucket < STATS_LATENCY_BUCKETS ? bucket : STATS_LATENCY_BUCKETS-1;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: stats_latency_bound                                              *
+ *                                                                            *
+ * Purpose: Get the upper bound of a bucket of the latency histograms         *
+ *                                                                            *
+ * Parameters: bucket - the index of the bucket                               *
+ *                                                                            *
+ * Return value: the first duration in milliseconds after the bucket          *
+ *                                                                            *
+ ******************************************************************************/
+static zbx_uint64_t stats_latency_bound(int bucket){
+    if(bucket < 4)return bucket+1;
+    return (zbx_uint64_t)(bucket%4 + 5) << (bucket/4 - 1);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: flight_request                                                   *
+ *                                                                            *
+ * Purpose: Start the record of an SNMP exchange when its request is sent     *
+ *                                                                            *
+ * Parameters: flight - A flight_t pointer                                    *
+ *             pdu - the request sent                                         *
+ *             bytes - the size of the request                                *
+ *                                                                            *
+ * Comment: If the request is sent again, only its number of tries changes,   *
+ *          flight->nb_tries must be set to 0 before a new request            *
+ ******************************************************************************/
+static void flight_request(flight_t *flight, struct snmp_pdu *pdu, size_t bytes){
+    struct variable_list *vars;
+    size_t i;
+
+    if(flight->nb_tries++ > 0)return;
+
+    flight->name_length = 0;
+    if(pdu->variables != NULL){
+        for(i=0;i<pdu->variables->name_length && i<MAX_WALK_OID_LEN;i++)flight->name[i] = pdu->variables->name[i];
+        flight->name_length = i;
+    }
+    flight->command = pdu->command;
+    flight->nb_vars = 0;
+    for(vars = pdu->variables; vars != NULL; vars = vars->next_variable)flight->nb_vars++;
+    flight->request_bytes = bytes;
+    flight->request_time = flight_clock();
+    flight->response_time = 0;
+    flight->status = STAT_SUCCESS;
+    flight->errstat = 0;
+    flight->response_vars = 0;
+    flight->response_bytes = 0;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: flight_response                                                  *
+ *                                                                            *
+ * Purpose: Finish the record of an SNMP exchange                             *
+ *                                                                            *
+ * Parameters: flight - A flight_t pointer                                    *
+ *             status - the status of the request                             *
+ *             response - the response received, only used if the status is   *
+ *                        STAT_SUCCESS                                        *
+ *             bytes - the size of the response                               *
+ *                                                                            *
+ ******************************************************************************/
+static void flight_response(flight_t *flight, int status, struct snmp_pdu *response, size_t bytes){
+    struct variable_list *vars;
+
+    flight->response_time = flight_clock();
+    flight->status = status;
+    if(status != STAT_SUCCESS || response == NULL)return;
+    flight->errstat = response->errstat;
+    for(vars = response->variables; vars != NULL; vars = vars->next_variable)flight->response_vars++;
+    flight->response_bytes = bytes;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: flight_clock                                                     *
+ *                                                                            *
+ * Purpose: Get the time of the records of the SNMP exchanges                 *
+ *                                                                            *
+ * Return value: the number of milliseconds since the Epoch                   *
+ *                                                                            *
+ ******************************************************************************/
+static zbx_uint64_t flight_clock(void){
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (zbx_uint64_t)tv.tv_sec*1000 + tv.tv_usec/1000;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: arena_acquire                                                    *
+ *                                                                            *
+ * Purpose: Get an arena to allocate the transient data of a call             *
+ *                                                                            *
+ * Return value:    an empty arena_t                                          *
+ *                  NULL if failure, the allocations are then done by malloc  *
+ *                                                                            *
+ * Comment: The arenas released by the previous calls are reused, so their    *
+ *          memory is allocated once                                          *
+ ******************************************************************************/
+static arena_t * arena_acquire(void){
+    arena_t *arena;
+
+    pthread_mutex_lock(&arenas_lock);
+    arena = arenas;
+    if(arena != NULL)arenas = arena->next;
+    pthread_mutex_unlock(&arenas_lock);
+    if(arena != NULL)return arena;
+
+    arena = (arena_t *)calloc(1, sizeof(arena_t));
+    if(arena == NULL)return NULL;
+    arena->base = (char *)malloc(ARENA_SIZE);
+    if(arena->base != NULL)arena->size = ARENA_SIZE;
+    return arena;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: arena_release                                                    *
+ *                                                                            *
+ * Purpose: Free all the allocations of an arena and give it back to the pool *
+ *                                                                            *
+ * Parameters: arena - An arena_t pointer                                     *
+ *                                                                            *
+ * Comment: If the arena was too small for the call, it is enlarged so the    *
+ *          next call does not need any other block. The block is never       *
+ *          enlarged beyond ARENA_MAX_SIZE, so the pool keeps at most         *
+ *          ARENA_MAX_SIZE bytes for every call run at the same time          *
+ ******************************************************************************/
+static void arena_release(arena_t *arena){
+    void *block;
+    size_t size;
+
+    if(arena == NULL)return;
+    size = arena->used + arena->overflow_size;
+    while(arena->overflow != NULL){
+        block = arena->overflow;
+        arena->overflow = *(void **)block;
+        free(block);
+    }
+    if(arena->overflow_size != 0 && arena->size < ARENA_MAX_SIZE){
+        if(size < arena->size*2)size = arena->size*2;
+        if(size > ARENA_MAX_SIZE)size = ARENA_MAX_SIZE;
+        free(arena->base);
+        arena->base = (char *)malloc(size);
+        arena->size = arena->base != NULL ? size : 0;
+    }
+    arena->used = 0;
+    arena->overflow_size = 0;
+
+    pthread_mutex_lock(&arenas_lock);
+    arena->next = arenas;
+    arenas = arena;
+    pthread_mutex_unlock(&arenas_lock);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: arena_pool_free                                                  *
+ *                                                                            *
+ * Purpose: Free the arenas of the pool                                       *
+ *                                                                            *
+ ******************************************************************************/
+static void arena_pool_free(void){
+    arena_t *arena;
+
+    pthread_mutex_lock(&arenas_lock);
+    while(arenas != NULL){
+        arena = arenas;
+        arenas = arena->next;
+        free(arena->base);
+        free(arena);
+    }
+    pthread_mutex_unlock(&arenas_lock);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: arena_alloc                                                      *
+ *                                                                            *
+ * Purpose: Allocate memory in an arena                                       *
+ *                                                                            *
+ * Parameters: arena - An arena_t pointer, NULL to use malloc                 *
+ *             size - the size to allocate                                    *
+ *                                                                            *
+ * Return value:    the address of the memory allocated                       *
+ *                  NULL if failure                                           *
+ *                                                                            *
+ * Comment: When the arena is full, a block is allocated by malloc until the  *
+ *          arena is released                                                 *
+ ******************************************************************************/
+static void * arena_alloc(arena_t *arena, size_t size){
+    char *block;
+
+    if(arena == NULL)return malloc(size);
+    size = (size + ARENA_ALIGN-1) & ~(size_t)(ARENA_ALIGN-1);
+    if(arena->used + size <= arena->size){
+        arena->used += size;
+        return arena->base + arena->used - size;
+    }
+    //The first bytes of the block link it to the other blocks
+    block = (char *)malloc(ARENA_ALIGN + size);
+    if(block == NULL)return NULL;
+    *(void **)block = arena->overflow;
+    arena->overflow = block;
+    arena->overflow_size += size;
+    return block + ARENA_ALIGN;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: arena_realloc                                                    *
+ *                                                                            *
+ * Purpose: Change the size of a memory allocated in an arena                 *
+ *                                                                            *
+ * Parameters: arena - An arena_t pointer, NULL to use realloc                *
+ *             ptr - the memory to resize, NULL to allocate a new one         *
+ *             old_size - the current size of the memory                      *
+ *             size - the new size                                            *
+ *                                                                            *
+ * Return value:    the address of the memory resized                         *
+ *                  NULL if failure, ptr is then left unchanged               *
+ *                                                                            *
+ ******************************************************************************/
+static void * arena_realloc(arena_t *arena, void *ptr, size_t old_size, size_t size){
+    char *new;
+    size_t aligned_old;
+    size_t aligned_new;
+
+    if(arena == NULL)return realloc(ptr, size);
+    //The last allocation of the arena can grow in place
+    aligned_old = (old_size + ARENA_ALIGN-1) & ~(size_t)(ARENA_ALIGN-1);
+    aligned_new = (size + ARENA_ALIGN-1) & ~(size_t)(ARENA_ALIGN-1);
+    if(ptr != NULL && (char *)ptr + aligned_old == arena->base + arena->used && arena->used - aligned_old + aligned_new <= arena->size){
+        arena->used = arena->used - aligned_old + aligned_new;
+        return ptr;
+    }
+    new = (char *)arena_alloc(arena, size);
+    if(new != NULL && ptr != NULL)memcpy(new, ptr, old_size < size ? old_size : size);
+    return new;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: arena_strdup                                                     *
+ *                                                                            *
+ * Purpose: Duplicate a string in an arena                                    *
+ *                                                                            *
+ * Parameters: arena - An arena_t pointer, NULL to use malloc                 *
+ *             str - the string to duplicate                                  *
+ *                                                                            *
+ * Return value:    the copy of the string                                    *
+ *                  NULL if failure                                           *
+ *                                                                            *
+ ******************************************************************************/
+static char * arena_strdup(arena_t *arena, const char *str){
+    size_t len = strlen(str)+1;
+    char *copy = (char *)arena_alloc(arena, len);
+
+    if(copy != NULL)memcpy(copy, str, len);
+    return copy;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: arena_free                                                       *
+ *                                                                            *
+ * Purpose: Free a memory allocated by arena_alloc                            *
+ *                                                                            *
+ * Parameters: arena - An arena_t pointer, NULL if the memory comes from      *
+ *                     malloc                                                 *
+ *             ptr - the memory to free                                       *
+ *                                                                            *
+ * Comment: The memory of an arena is only freed when the arena is released   *
+ ******************************************************************************/
+static void arena_free(arena_t *arena, void *ptr){
+    if(arena == NULL)free(ptr);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: text_struct_init                                                 *
+ *                                                                            *
+ * Purpose: Init an empty text_struct_t                                       *
+ *                                                                            *
+ * Parameters: text - A text_struct_t pointer                                 *
+ *             arena - the arena of the text, NULL to use malloc              *
+ *                                                                            *
+ ******************************************************************************/
+static void text_struct_init(text_struct_t *text, arena_t *arena){
+    if(text !=NULL){
+        text->str = NULL;
+        text->len = 0;
+        text->size = 0;
+        text->full = 0;
+        text->arena = arena;
+    }
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: text_struct_free                                                 *
+ *                                                                            *
+ * Purpose: Free the string of a text_struct_t                                *
+ *                                                                            *
+ * Parameters: text - A text_struct_t pointer                                 *
+ *                                                                            *
+ ******************************************************************************/
+static void text_struct_free(text_struct_t *text){
+    if(text !=NULL){
+        arena_free(text->arena, text->str);
+        text_struct_init(text, text->arena);
+    }
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: text_struct_add                                                  *
+ *                                                                            *
+ * Purpose: Append a formatted message at the end of a text                   *
+ *                                                                            *
+ * Parameters: text - A text_struct_t pointer                                 *
+ *             format - the printf format of the message                      *
+ *                                                                            *
+ * Return value:    SUCCEED - the message is appended                         *
+ *                  FAIL - the text is full, "Too many results" is appended   *
+ *                         instead and no more message can be added           *
+ *                                                                            *
+ * Comment: The string is doubled when the message does not fit, so the       *
+ *          messages are formatted once except when the string grows          *
+ ******************************************************************************/
+static int text_struct_add(text_struct_t *text, const char *format, ...){
+    char msg_too_many[]="Too many results\n";
+    size_t len_too_many = sizeof(msg_too_many)-1;
+    va_list args;
+    char *str;
+    size_t size;
+    int len;
+
+    if(text->full)return FAIL;
+
+    va_start(args, format);
+    len = vsnprintf(text->str == NULL ? NULL : text->str + text->len, text->size - text->len, format, args);
+    va_end(args);
+    if(len < 0)return FAIL;
+
+    //The message is replaced by the truncation message if it exceeds the cap
+    if(text->len + len + len_too_many > MAX_RESULT_LEN){
+        text->full = 1;
+        len = (int)len_too_many;
+    }
+    if(text->len + len + 1 > text->size){
+        size = text->size ? text->size*2 : 256;
+        while(size < text->len + len + 1)size = size*2;
+        str = (char *)arena_realloc(text->arena, text->str, text->size, size);
+        if(str == NULL){
+            if(text->str != NULL)text->str[text->len] = '\0';
+            text->full = 1;
+            return FAIL;
+        }
+        text->str = str;
+        text->size = size;
+        if(text->full){
+            memcpy(text->str + text->len, msg_too_many, len_too_many+1);
+        }else{
+            va_start(args, format);
+            vsnprintf(text->str + text->len, text->size - text->len, format, args);
+            va_end(args);
+        }
+    }else if(text->full){
+        memcpy(text->str + text->len, msg_too_many, len_too_many+1);
+    }
+    text->len += len;
+    return text->full ? FAIL : SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: text_struct_set_result                                           *
+ *                                                                            *
+ * Purpose: Set a text as the string result of an item                        *
+ *                                                                            *
+ * Parameters: text - A text_struct_t pointer                                 *
+ *             result - structure that will contain result                    *
+ *                                                                            *
+ * Comment: An empty text sets no result (no data)                            *
+ ******************************************************************************/
+static void text_struct_set_result(text_struct_t *text, AGENT_RESULT *result){
+    if(text->len !=0){
+        SET_STR_RESULT(result, strdup(text->str));
+    }
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: text_fingerprint                                                 *
+ *                                                                            *
+ * Purpose: Compute the fingerprint of the text result of an item             *
+ *                                                                            *
+ * Parameters: str - the text                                                 *
+ *                                                                            *
+ * Return value: the 64 bits FNV-1a hash of the text, 0 for an empty text     *
+ *                                                                            *
+ ******************************************************************************/
+static zbx_uint64_t text_fingerprint(const char *str){
+    zbx_uint64_t hash = 14695981039346656037ULL;
+
+    if(*str == '\0')return 0;
+    for(;*str != '\0';str++){
+        hash ^= (unsigned char)*str;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: agg_table_new                                                    *
+ *                                                                            *
+ * Purpose: Allocate a new empty agg_table_t                                  *
+ *                                                                            *
+ * Parameters: table - A pointer of an agg_table_t pointer                    *
+ *             arena - the arena of the table, NULL to use malloc             *
+ *                                                                            *
+ ******************************************************************************/
+static void agg_table_new(agg_table_t ** table, arena_t *arena){
+    if(table==NULL)return;
+    *table = (agg_table_t *)arena_alloc(arena, sizeof(agg_table_t));
+    if(*table!=NULL){
+        (*table)->aggs = NULL;
+        (*table)->nb_aggs = 0;
+        (*table)->max_aggs = 0;
+        (*table)->slots = NULL;
+        (*table)->nb_slots = 0;
+        (*table)->ports = NULL;
+        (*table)->max_ports = 0;
+        (*table)->walk_ports = NULL;
+        (*table)->nb_walk_ports = 0;
+        (*table)->max_walk_ports = 0;
+        (*table)->arena = arena;
+    }
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: agg_table_free                                                   *
+ *                                                                            *
+ * Purpose: Free an agg_table_t with all its aggregations                     *
+ *                                                                            *
+ * Parameters: table - An agg_table_t pointer                                 *
+ *                                                                            *
+ ******************************************************************************/
+static void agg_table_free(agg_table_t *table){
+    if(table!=NULL){
+        arena_free(table->arena, table->aggs);
+        arena_free(table->arena, table->slots);
+        arena_free(table->arena, table->ports);
+        arena_free(table->arena, table->walk_ports);
+        arena_free(table->arena, table);
+    }
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: agg_table_reset                                                  *
+ *                                                                            *
+ * Purpose: Remove all the aggregations of an agg_table_t                     *
+ *                                                                            *
+ * Parameters: table - An agg_table_t pointer                                 *
+ *                                                                            *
+ * Comment: The arrays are kept to be filled again without being allocated    *
+ *****************************************************************************/
+static void agg_table_reset(agg_table_t *table){
+    if(table!=NULL){
+        table->nb_aggs = 0;
+        if(table->nb_slots != 0)memset(table->slots, 0, sizeof(int)*table->nb_slots);
+        table->nb_walk_ports = 0;
+    }
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: table_slot                                                       *
+ *                                                                            *
+ * Purpose: Get the first slot of an open-addressing hash index to look at    *
+ *          for a key                                                         *
+ *                                                                            *
+ * Parameters:  key - the key of the element                                  *
+ *              nb_slots - the number of slots, a power of two                *
+ *                                                                            *
+ * Return value: the position of the slot                                     *
+ *                                                                            *
+ ******************************************************************************/
+static int table_slot(unsigned long key, int nb_slots){
+    unsigned int hash = (unsigned int)key;
+
+    //Mix the bits as the keys (ifIndex, rings) are often consecutive
+    hash ^= hash >> 16;
+    hash *= 0x45d9f3b;
+    hash ^= hash >> 16;
+    return (int)(hash & (unsigned int)(nb_slots-1));
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: agg_table_exist                                                  *
+ *                                                                            *
+ * Purpose: Retrieve the aggregation with a specific index value              *
+ *                                                                            *
+ * Parameters:  index - the index value of the aggregation                    *
+ *              table - An agg_table_t pointer                                *
+ *                                                                            *
+ * Return value:    the address of the aggregation if found                   *
+ *                  NULL otherwise                                            *
+ ******************************************************************************/
+static agg_struct_t * agg_table_exist(long index, agg_table_t * table){
+    int slot;
+
+    if(table==NULL || table->nb_slots==0)return NULL;
+    //The slots hold the position of the aggregations plus one, 0 is an empty slot
+    slot = table_slot(index, table->nb_slots);
+    while(table->slots[slot] != 0){
+        if(table->aggs[table->slots[slot]-1].index == index)return &table->aggs[table->slots[slot]-1];
+        slot = (slot+1) & (table->nb_slots-1);
+    }
+    return NULL;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: agg_table_add                                                    *
+ *                                                                            *
+ * Purpose: Add an aggregation at the end of the table with a index value     *
+ *                                                                            *
+ * Parameters:  index - the index value to initialise the new aggregation     *
+ *              table - A pointer of an agg_table_t pointer, the table is     *
+ *                      allocated with the first aggregation                  *
+ *              arena - the arena of a new table, NULL to use malloc          *
+ *                                                                            *
+ * Return value:    the address of the new aggregation                        *
+ *                  NULL if failure                                           *
+ *                                                                            *
+ * Comment: The address of the aggregations may change when one is added      *
+ ******************************************************************************/
+static agg_struct_t * agg_table_add(long index, agg_table_t ** table, arena_t *arena){
+    agg_table_t *t;
+    agg_struct_t *aggs;
+    int *slots;
+    int nb_slots;
+    int slot;
+    int i;
+
+    if(*table==NULL)agg_table_new(table, arena);
+    t = *table;
+    if(t==NULL)return NULL;
+
+    //The array of the aggregations is doubled when it is full
+    if(t->nb_aggs == t->max_aggs){
+        aggs = (agg_struct_t *)arena_realloc(t->arena, t->aggs, sizeof(agg_struct_t)*t->max_aggs, sizeof(agg_struct_t)*(t->max_aggs ? t->max_aggs*2 : 8));
+        if(aggs==NULL)return NULL;
+        t->aggs = aggs;
+        t->max_aggs = t->max_aggs ? t->max_aggs*2 : 8;
+    }
+    //The hash index is rebuilt with twice more slots when it is half full
+    if((t->nb_aggs+1)*2 > t->nb_slots){
+        nb_slots = t->nb_slots ? t->nb_slots*2 : 16;
+        slots = (int *)arena_alloc(t->arena, sizeof(int)*nb_slots);
+        if(slots==NULL)return NULL;
+        memset(slots, 0, sizeof(int)*nb_slots);
+        for(i=0;i<t->nb_aggs;i++){
+            slot = table_slot(t->aggs[i].index, nb_slots);
+            while(slots[slot] != 0)slot = (slot+1) & (nb_slots-1);
+            slots[slot] = i+1;
+        }
+        arena_free(t->arena, t->slots);
+        t->slots = slots;
+        t->nb_slots = nb_slots;
+    }
+
+    agg_struct_init(index, &t->aggs[t->nb_aggs]);
+    slot = table_slot(index, t->nb_slots);
+    while(t->slots[slot] != 0)slot = (slot+1) & (t->nb_slots-1);
+    t->slots[slot] = ++t->nb_aggs;
+    return &t->aggs[t->nb_aggs-1];
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: agg_table_next                                                   *
+ *                                                                            *
+ * Purpose: Browse the aggregations of a table in the order they were added   *
+ *                                                                            *
+ * Parameters:  table - An agg_table_t pointer                                *
+ *              agg - the current aggregation, NULL to get the first one      *
+ *                                                                            *
+ * Return value:    the address of the next aggregation                       *
+ *                  NULL at the end of the table                              *
+ *                                                                            *
+ ******************************************************************************/
+static agg_struct_t * agg_table_next(agg_table_t * table, agg_struct_t *agg){
+    if(table==NULL || table->nb_aggs==0)return NULL;
+    if(agg==NULL)return &table->aggs[0];
+    if(agg+1 < table->aggs+table->nb_aggs)return agg+1;
+    return NULL;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: agg_struct_init                                                  *
+ *                                                                            *
+ * Purpose: Init an agg_struct_t                                              *
+ *                                                                            *
+ * Parameters:  index - the index value to initialise the struct with         *
+ *              agg - An agg_struct_t pointer                                 *
+ *                                                                            *
+ ******************************************************************************/
+static void agg_struct_init(long index, agg_struct_t *agg){
+    if(agg!=NULL){
+        agg->index = index;
+        agg->first_port = 0;
+        agg->nb_ports = 0;
+        agg->status = AGG_STATUS_UNKNOWN;
+    }
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: agg_table_add_port                                               *
+ *                                                                            *
+ * Purpose: Attach a port to an aggregation of the table                      *
+ *                                                                            *
+ * Parameters:  port_index - the index of the port to add                     *
+ *              agg - An agg_struct_t pointer of the table                    *
+ *              table - An agg_table_t pointer                                *
+ *                                                                            *
+ * Return value:    SUCCEED - the port is attached                            *
+ *                  FAIL - the array of the ports can not be grown            *
+ *                                                                            *
+ * Comment: The ports are only kept in the order of the walk, they are        *
+ *          grouped by aggregation by agg_table_build_ports                   *
+ ******************************************************************************/
+static int agg_table_add_port(long port_index, agg_struct_t *agg, agg_table_t *table){
+    agg_port_struct_t *walk_ports;
+
+    if(agg==NULL || table==NULL)return FAIL;
+    //The array of the ports is doubled when it is full
+    if(table->nb_walk_ports == table->max_walk_ports){
+        walk_ports = (agg_port_struct_t *)arena_realloc(table->arena, table->walk_ports, sizeof(agg_port_struct_t)*table->max_walk_ports, sizeof(agg_port_struct_t)*(table->max_walk_ports ? table->max_walk_ports*2 : 16));
+        if(walk_ports==NULL)return FAIL;
+        table->walk_ports = walk_ports;
+        table->max_walk_ports = table->max_walk_ports ? table->max_walk_ports*2 : 16;
+    }
+    table->walk_ports[table->nb_walk_ports].port = port_index;
+    table->walk_ports[table->nb_walk_ports].agg = (int)(agg - table->aggs);
+    table->nb_walk_ports++;
+    agg->nb_ports++;
+    return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: agg_table_build_ports                                            *
+ *                                                                            *
+ * Purpose: Group the ports attached by the walk by aggregation               *
+ *                                                                            *
+ * Parameters:  table - An agg_table_t pointer                                *
+ *                                                                            *
+ * Comment: The ports of all the aggregations are stored in a single array,   *
+ *          those of an aggregation start at its first_port position          *
+ *          The array of the walk is kept for the next walk of the table      *
+ ******************************************************************************/
+static void agg_table_build_ports(agg_table_t *table){
+    long *ports;
+    int agg;
+    int i;
+
+    if(table==NULL)return;
+    if(table->nb_walk_ports > table->max_ports){
+        ports = (long *)arena_realloc(table->arena, table->ports, sizeof(long)*table->max_ports, sizeof(long)*table->nb_walk_ports);
+        if(ports==NULL){
+            //If failure, the aggregations are considered without port
+            for(i=0;i<table->nb_aggs;i++)table->aggs[i].nb_ports = 0;
+            table->nb_walk_ports = 0;
+            return;
+        }
+        table->ports = ports;
+        table->max_ports = table->nb_walk_ports;
+    }
+    //The ports of an aggregation follow the ports of the previous one
+    //first_port is set past the end of the ports of every aggregation, then moved back as they are placed from the last one
+    for(i=0;i<table->nb_aggs;i++){
+        table->aggs[i].first_port = (i ? table->aggs[i-1].first_port : 0) + table->aggs[i].nb_ports;
+    }
+    for(i=table->nb_walk_ports-1;i>=0;i--){
+        agg = table->walk_ports[i].agg;
+        table->ports[--table->aggs[agg].first_port] = table->walk_ports[i].port;
+    }
+    table->nb_walk_ports = 0;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: agg_table_eval_status                                            *
+ *                                                                            *
+ * Purpose: Set the status of all the aggregations from the ifOperStatus of   *
+ *          their ports                                                       *
+ *                                                                            *
+ * Parameters: table - An agg_table_t pointer with its ports built            *
+ *             status - the if_status_t of the switch                         *
+ *             arena - the arena of the member masks, NULL to use malloc      *
+ *                                                                            *
+ * Return value:    SUCCEED - the status of the aggregations is set           *
+ *                  FAIL - the member masks can not be allocated              *
+ *                                                                            *
+ * Comment: The ports whose status is not known are not counted as down       *
+ ******************************************************************************/
+static int agg_table_eval_status(agg_table_t *table, if_status_t *status, arena_t *arena){
+    zbx_uint64_t *mask;
+    int nb_words;
+    int nb_down;
+    int pos;
+    int i;
+    int j;
+
+    if(table==NULL || status==NULL)return SUCCEED;
+    nb_words = (status->nb_ifs+63)/64;
+    mask = (zbx_uint64_t *)arena_alloc(arena, sizeof(zbx_uint64_t)*(nb_words ? nb_words : 1));
+    if(mask==NULL)return FAIL;
+
+    for(i=0;i<table->nb_aggs;i++){
+        //Set the bits of the ports of the aggregation in its member mask
+        memset(mask, 0, sizeof(zbx_uint64_t)*nb_words);
+        for(j=0;j<table->aggs[i].nb_ports;j++){
+            pos = if_status_find(table->ports[table->aggs[i].first_port+j], status);
+            if(pos >= 0)mask[pos/64] |= (zbx_uint64_t)1 << (pos%64);
+        }
+        nb_down = if_status_count_down(mask, status);
+        if(nb_down == 0)table->aggs[i].status = AGG_STATUS_OK;
+        else if(nb_down == table->aggs[i].nb_ports)table->aggs[i].status = AGG_STATUS_DOWN;
+        else table->aggs[i].status = AGG_STATUS_LINK_DOWN;
+    }
+    arena_free(arena, mask);
+    return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: irf_table_new                                                    *
+ *                                                                            *
+ * Purpose: Allocate a new empty irf_table_t                                  *
+ *                                                                            *
+ * Parameters: table - A pointer of an irf_table_t pointer                    *
+ *             arena - the arena of the table, NULL to use malloc             *
+ *                                                                            *
+ ******************************************************************************/
+static void irf_table_new(irf_table_t ** table, arena_t *arena){
+    if(table==NULL)return;
+    *table = (irf_table_t *)arena_alloc(arena, sizeof(irf_table_t));
+    if(*table!=NULL){
+        (*table)->members = NULL;
+        (*table)->nb_members = 0;
+        (*table)->max_members = 0;
+        (*table)->time = 0;
+        (*table)->arena = arena;
+    }
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: irf_table_free                                                   *
+ *                                                                            *
+ * Purpose: Free an irf_table_t with all its members                          *
+ *                                                                            *
+ * Parameters: table - An irf_table_t pointer                                 *
+ *                                                                            *
+ ******************************************************************************/
+static void irf_table_free(irf_table_t *table){
+    if(table!=NULL){
+        arena_free(table->arena, table->members);
+        arena_free(table->arena, table);
+    }
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: irf_table_exist                                                  *
+ *                                                                            *
+ * Purpose: Retrieve the member with a specific id                            *
+ *                                                                            *
+ * Parameters:  member - the member id                                        *
+ *              table - An irf_table_t pointer                                *
+ *                                                                            *
+ * Return value:    the address of the member if found                        *
+ *                  NULL otherwise                                            *
+ *                                                                            *
+ * Comment: A stack has a few members, they are searched one after the other  *
+ ******************************************************************************/
+static irf_member_t * irf_table_exist(long member, irf_table_t * table){
+    int i;
+
+    if(table==NULL)return NULL;
+    for(i=0;i<table->nb_members;i++){
+        if(table->members[i].member == member)return &table->members[i];
+    }
+    return NULL;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: irf_table_add_port                                               *
+ *                                                                            *
+ * Purpose: Add an IRF port to its member and update the status of the member *
+ *                                                                            *
+ * Parameters:  member - the member id of the port                            *
+ *              port_status - the status of the port, 1 if it is up           *
+ *              table - A pointer of an irf_table_t pointer, the table is     *
+ *                      allocated with the first port                         *
+ *              arena - the arena of a new table, NULL to use malloc          *
+ *                                                                            *
+ * Return value:    the address of the member                                 *
+ *                  NULL if failure                                           *
+ *                                                                            *
+ ******************************************************************************/
+static irf_member_t * irf_table_add_port(long member, long port_status, irf_table_t ** table, arena_t *arena){
+    irf_table_t *t;
+    irf_member_t *members;
+    irf_member_t *m;
+
+    if(*table==NULL)irf_table_new(table, arena);
+    t = *table;
+    if(t==NULL)return NULL;
+
+    m = irf_table_exist(member, t);
+    if(m==NULL){
+        //The array of the members is doubled when it is full
+        if(t->nb_members == t->max_members){
+            members = (irf_member_t *)arena_realloc(t->arena, t->members, sizeof(irf_member_t)*t->max_members, sizeof(irf_member_t)*(t->max_members ? t->max_members*2 : MAX_IRF_SWITCHES));
+            if(members==NULL)return NULL;
+            t->members = members;
+            t->max_members = t->max_members ? t->max_members*2 : MAX_IRF_SWITCHES;
         }
+        m = &t->members[t->nb_members++];
+        m->member = member;
+        m->nb_ports = 0;
+        m->nb_ports_up = 0;
     }
-    ret = SYSINFO_RET_OK;
-    if(status !=STAT_SUCCESS){
-        
-        if (status == STAT_TIMEOUT){
-            SET_STR_RESULT(result, strdup("Request timeout"));
-            ret = SYSINFO_RET_OK;
-        }else if(status == STAT_ERR_INIT){
-            SET_MSG_RESULT(result, strdup("Error when Initializing SNMP session"));
-            ret = SYSINFO_RET_FAIL;
+
+    m->nb_ports++;
+    if(port_status == 1)m->nb_ports_up++;
+    if(m->nb_ports_up == m->nb_ports)m->status = IRF_MEMBER_OK;
+    else if(m->nb_ports_up == 0)m->status = IRF_MEMBER_DOWN;
+    else m->status = IRF_MEMBER_PORT_DOWN;
+    return m;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: irf_table_copy                                                   *
+ *                                                                            *
+ * Purpose: Duplicate an irf_table_t                                          *
+ *                                                                            *
+ * Parameters:  table - An irf_table_t pointer                                *
+ *              arena - the arena of the copy, NULL to use malloc             *
+ *                                                                            *
+ * Return value:    the copy of the table                                     *
+ *                  NULL if failure                                           *
+ *                                                                            *
+ ******************************************************************************/
+static irf_table_t * irf_table_copy(irf_table_t *table, arena_t *arena){
+    irf_table_t *copy;
+
+    if(table==NULL)return NULL;
+    irf_table_new(&copy, arena);
+    if(copy==NULL)return NULL;
+    if(table->nb_members > 0){
+        copy->members = (irf_member_t *)arena_alloc(arena, sizeof(irf_member_t)*table->nb_members);
+        if(copy->members==NULL){
+            irf_table_free(copy);
+            return NULL;
         }
-        else{
-            SET_MSG_RESULT(result, strdup("Unknown error in SNMP session"));
-            ret = SYSINFO_RET_FAIL;
+        memcpy(copy->members, table->members, sizeof(irf_member_t)*table->nb_members);
+        copy->nb_members = table->nb_members;
+        copy->max_members = table->nb_members;
+    }
+    copy->time = table->time;
+    return copy;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: irf_table_assign                                                 *
+ *                                                                            *
+ * Purpose: Copy an irf_table_t in another one allocated by malloc            *
+ *                                                                            *
+ * Parameters:  copy - A pointer of the irf_table_t pointer to overwrite,     *
+ *                     it is allocated if NULL                                *
+ *              table - An irf_table_t pointer                                *
+ *                                                                            *
+ * Return value:    SUCCEED - the table is copied                             *
+ *                  FAIL - the copy can not be grown                          *
+ *                                                                            *
+ * Comment: The arrays of the copy are reused while they are large enough     *
+ *****************************************************************************/
+static int irf_table_assign(irf_table_t **copy, irf_table_t *table){
+    irf_table_t *c;
+    irf_member_t *members;
+
+    if(table==NULL)return FAIL;
+    if(*copy==NULL){
+        irf_table_new(copy, NULL);
+        if(*copy==NULL)return FAIL;
+    }
+    c = *copy;
+    if(table->nb_members > c->max_members){
+        members = (irf_member_t *)realloc(c->members, sizeof(irf_member_t)*table->nb_members);
+        if(members==NULL)return FAIL;
+        c->members = members;
+        c->max_members = table->nb_members;
+    }
+    if(table->nb_members > 0)memcpy(c->members, table->members, sizeof(irf_member_t)*table->nb_members);
+    c->nb_members = table->nb_members;
+    c->time = table->time;
+    return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: rrpp_table_new                                                   *
+ *                                                                            *
+ * Purpose: Allocate a new empty rrpp_table_t                                 *
+ *                                                                            *
+ * Parameters: table - A pointer of an rrpp_table_t pointer                   *
+ *             arena - the arena of the table, NULL to use malloc             *
+ *                                                                            *
+ ******************************************************************************/
+static void rrpp_table_new(rrpp_table_t ** table, arena_t *arena){
+    if(table==NULL)return;
+    *table = (rrpp_table_t *)arena_alloc(arena, sizeof(rrpp_table_t));
+    if(*table!=NULL){
+        (*table)->rings = NULL;
+        (*table)->nb_rings = 0;
+        (*table)->max_rings = 0;
+        (*table)->slots = NULL;
+        (*table)->nb_slots = 0;
+        (*table)->time = 0;
+        (*table)->arena = arena;
+    }
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: rrpp_table_free                                                  *
+ *                                                                            *
+ * Purpose: Free an rrpp_table_t with all its rings                           *
+ *                                                                            *
+ * Parameters: table - An rrpp_table_t pointer                                *
+ *                                                                            *
+ ******************************************************************************/
+static void rrpp_table_free(rrpp_table_t *table){
+    if(table!=NULL){
+        arena_free(table->arena, table->rings);
+        arena_free(table->arena, table->slots);
+        arena_free(table->arena, table);
+    }
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: rrpp_table_key                                                   *
+ *                                                                            *
+ * Purpose: Pack the domain and the ring id of a ring in a single key         *
+ *                                                                            *
+ * Parameters:  domain - the domain id of the rrpp ring                       *
+ *              ring - the ring id of the rrpp ring                           *
+ *                                                                            *
+ * Return value: the domain in the 16 high bits and the ring in the 16 low    *
+ *               bits                                                         *
+ *                                                                            *
+ ******************************************************************************/
+static unsigned int rrpp_table_key(long domain, long ring){
+    return ((unsigned int)domain & 0xffff) << 16 | ((unsigned int)ring & 0xffff);
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: rrpp_table_exist                                                 *
+ *                                                                            *
+ * Purpose: Retrieve the ring with a specific domain and ring id              *
+ *                                                                            *
+ * Parameters:  domain - the domain id of the rrpp ring                       *
+ *              ring - the ring id of the rrpp ring                           *
+ *              table - An rrpp_table_t pointer                               *
+ *                                                                            *
+ * Return value:    the address of the ring if found                          *
+ *                  NULL otherwise                                            *
+ ******************************************************************************/
+static rrpp_struct_t * rrpp_table_exist(long domain, long ring, rrpp_table_t * table){
+    rrpp_struct_t *rrpp;
+    int slot;
+
+    if(table==NULL || table->nb_slots==0)return NULL;
+    //The slots hold the position of the rings plus one, 0 is an empty slot
+    slot = table_slot(rrpp_table_key(domain, ring), table->nb_slots);
+    while(table->slots[slot] != 0){
+        rrpp = &table->rings[table->slots[slot]-1];
+        if(rrpp->domain == domain && rrpp->ring == ring)return rrpp;
+        slot = (slot+1) & (table->nb_slots-1);
+    }
+    return NULL;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: rrpp_table_add                                                   *
+ *                                                                            *
+ * Purpose: Add a ring at the end of the table                                *
+ *                                                                            *
+ * Parameters:  domain - the domain id of the rrpp ring                       *
+ *              ring - the ring id of the rrpp ring                           *
+ *              table - A pointer of an rrpp_table_t pointer, the table is    *
+ *                      allocated with the first ring                         *
+ *              arena - the arena of a new table, NULL to use malloc          *
+ *                                                                            *
+ * Return value:    the address of the new ring                               *
+ *                  NULL if failure                                           *
+ *                                                                            *
+ * Comment: The address of the rings may change when one is added             *
+ ******************************************************************************/
+static rrpp_struct_t * rrpp_table_add(long domain, long ring, rrpp_table_t ** table, arena_t *arena){
+    rrpp_table_t *t;
+    rrpp_struct_t *rings;
+    int *slots;
+    int nb_slots;
+    int slot;
+    int i;
+
+    if(*table==NULL)rrpp_table_new(table, arena);
+    t = *table;
+    if(t==NULL)return NULL;
+
+    //The array of the rings is doubled when it is full
+    if(t->nb_rings == t->max_rings){
+        rings = (rrpp_struct_t *)arena_realloc(t->arena, t->rings, sizeof(rrpp_struct_t)*t->max_rings, sizeof(rrpp_struct_t)*(t->max_rings ? t->max_rings*2 : 8));
+        if(rings==NULL)return NULL;
+        t->rings = rings;
+        t->max_rings = t->max_rings ? t->max_rings*2 : 8;
+    }
+    //The hash index is rebuilt with twice more slots when it is half full
+    if((t->nb_rings+1)*2 > t->nb_slots){
+        nb_slots = t->nb_slots ? t->nb_slots*2 : 16;
+        slots = (int *)arena_alloc(t->arena, sizeof(int)*nb_slots);
+        if(slots==NULL)return NULL;
+        memset(slots, 0, sizeof(int)*nb_slots);
+        for(i=0;i<t->nb_rings;i++){
+            slot = table_slot(t->rings[i].key, nb_slots);
+            while(slots[slot] != 0)slot = (slot+1) & (nb_slots-1);
+            slots[slot] = i+1;
         }
+        arena_free(t->arena, t->slots);
+        t->slots = slots;
+        t->nb_slots = nb_slots;
     }
-    //Free the aggregation structures
-    rrpp_struct_free(rrpp);
-    return ret;
+
+    rrpp_struct_init(domain, ring, &t->rings[t->nb_rings]);
+    slot = table_slot(t->rings[t->nb_rings].key, t->nb_slots);
+    while(t->slots[slot] != 0)slot = (slot+1) & (t->nb_slots-1);
+    t->slots[slot] = ++t->nb_rings;
+    return &t->rings[t->nb_rings-1];
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: rrpp_table_next                                                  *
+ *                                                                            *
+ * Purpose: Browse the rings of a table in the order they were added          *
+ *                                                                            *
+ * Parameters:  table - An rrpp_table_t pointer                               *
+ *              rrpp - the current ring, NULL to get the first one            *
+ *                                                                            *
+ * Return value:    the address of the next ring                              *
+ *                  NULL at the end of the table                              *
+ *                                                                            *
+ ******************************************************************************/
+static rrpp_struct_t * rrpp_table_next(rrpp_table_t * table, rrpp_struct_t *rrpp){
+    if(table==NULL || table->nb_rings==0)return NULL;
+    if(rrpp==NULL)return &table->rings[0];
+    if(rrpp+1 < table->rings+table->nb_rings)return rrpp+1;
+    return NULL;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: rrpp_table_eval_status                                           *
+ *                                                                            *
+ * Purpose: Set the status of all the rings from the ifOperStatus of their    *
+ *          primary and secondary ports                                       *
+ *                                                                            *
+ * Parameters: table - An rrpp_table_t pointer                                *
+ *             status - the if_status_t of the switch                         *
+ *                                                                            *
+ * Comment: A port whose index is 0 is considered up                          *
+ ******************************************************************************/
+static void rrpp_table_eval_status(rrpp_table_t *table, if_status_t *status){
+    rrpp_struct_t *rrpp_tmp;
+    short port;
+
+    for(rrpp_tmp = rrpp_table_next(table, NULL); rrpp_tmp != NULL; rrpp_tmp = rrpp_table_next(table, rrpp_tmp)){
+        rrpp_tmp->status = RING_STATUS_OK;
+        for(port=RRPP_PRIMARY_PORT;port<=RRPP_SECONDARY_PORT;port++){
+            if(rrpp_struct_get_port(port, rrpp_tmp)==0){
+                rrpp_struct_set_port_status(PORT_UP, port, rrpp_tmp);
+            }else{
+                rrpp_struct_set_port_status(if_status_get(rrpp_struct_get_port(port, rrpp_tmp), status), port, rrpp_tmp);
+            }
+        }
+        if(rrpp_struct_get_port_status(RRPP_PRIMARY_PORT, rrpp_tmp)==PORT_DOWN)rrpp_tmp->status |= RING_STATUS_PRIMARY_DOWN;
+        if(rrpp_struct_get_port_status(RRPP_SECONDARY_PORT, rrpp_tmp)==PORT_DOWN)rrpp_tmp->status |= RING_STATUS_SECONDARY_DOWN;
+    }
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: rrpp_table_copy                                                  *
+ *                                                                            *
+ * Purpose: Duplicate an rrpp_table_t                                         *
+ *                                                                            *
+ * Parameters:  table - An rrpp_table_t pointer                               *
+ *              arena - the arena of the copy, NULL to use malloc             *
+ *                                                                            *
+ * Return value:    the copy of the table                                     *
+ *                  NULL if failure                                           *
+ *                                                                            *
+ ******************************************************************************/
+static rrpp_table_t * rrpp_table_copy(rrpp_table_t *table, arena_t *arena){
+    rrpp_table_t *copy;
+
+    if(table==NULL)return NULL;
+    rrpp_table_new(&copy, arena);
+    if(copy==NULL)return NULL;
+    if(table->nb_rings > 0){
+        copy->rings = (rrpp_struct_t *)arena_alloc(arena, sizeof(rrpp_struct_t)*table->nb_rings);
+        copy->slots = (int *)arena_alloc(arena, sizeof(int)*table->nb_slots);
+        if(copy->rings==NULL || copy->slots==NULL){
+            rrpp_table_free(copy);
+            return NULL;
+        }
+        memcpy(copy->rings, table->rings, sizeof(rrpp_struct_t)*table->nb_rings);
+        memcpy(copy->slots, table->slots, sizeof(int)*table->nb_slots);
+        copy->nb_rings = table->nb_rings;
+        copy->max_rings = table->nb_rings;
+        copy->nb_slots = table->nb_slots;
+    }
+    copy->time = table->time;
+    return copy;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: rrpp_table_assign                                                *
+ *                                                                            *
+ * Purpose: Copy an rrpp_table_t in another one allocated by malloc           *
+ *                                                                            *
+ * Parameters:  copy - A pointer of the rrpp_table_t pointer to overwrite,    *
+ *                     it is allocated if NULL                                *
+ *              table - An rrpp_table_t pointer                               *
+ *                                                                            *
+ * Return value:    SUCCEED - the table is copied                             *
+ *                  FAIL - the copy can not be grown                          *
+ *                                                                            *
+ * Comment: The arrays of the copy are reused while they are large enough     *
+ *****************************************************************************/
+static int rrpp_table_assign(rrpp_table_t **copy, rrpp_table_t *table){
+    rrpp_table_t *c;
+    rrpp_struct_t *rings;
+    int *slots;
+
+    if(table==NULL)return FAIL;
+    if(*copy==NULL){
+        rrpp_table_new(copy, NULL);
+        if(*copy==NULL)return FAIL;
+    }
+    c = *copy;
+    if(table->nb_rings > c->max_rings){
+        rings = (rrpp_struct_t *)realloc(c->rings, sizeof(rrpp_struct_t)*table->nb_rings);
+        if(rings==NULL)return FAIL;
+        c->rings = rings;
+        c->max_rings = table->nb_rings;
+    }
+    //The size of the hash index only changes with the number of rings
+    if(table->nb_slots != c->nb_slots){
+        slots = (int *)realloc(c->slots, sizeof(int)*(table->nb_slots ? table->nb_slots : 1));
+        if(slots==NULL)return FAIL;
+        c->slots = slots;
+        c->nb_slots = table->nb_slots;
+    }
+    if(table->nb_rings > 0){
+        memcpy(c->rings, table->rings, sizeof(rrpp_struct_t)*table->nb_rings);
+        memcpy(c->slots, table->slots, sizeof(int)*table->nb_slots);
+    }
+    c->nb_rings = table->nb_rings;
+    c->time = table->time;
+    return SUCCEED;
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: rrpp_struct_init                                                 *
+ *                                                                            *
+ * Purpose: Init an rrpp_struct_t                                             *
+ *                                                                            *
+ * Parameters:  domain - the domain id of the rrpp ring                       *
+ *              ring - the ring id of the rrpp ring                           *
+ *              rrpp - An rrpp_struct_t pointer                               *
+ *                                                                            *
+ ******************************************************************************/
+static void rrpp_struct_init(long domain, long ring,rrpp_struct_t *rrpp){
+    if(rrpp !=NULL){
+        rrpp->key = rrpp_table_key(domain, ring);
+        rrpp->domain = domain;
+        rrpp->ring = ring;
+        rrpp->primary_port = 0;
+        rrpp->secondary_port = 0;
+        rrpp->primary_port_status = RRPP_UNKNOWN;
+        rrpp->secondary_port_status = RRPP_UNKNOWN;
+        rrpp->status = RING_STATUS_OK;
+    }
+}
+
+
+/******************************************************************************
+ *                                                                            *
+ * Function: rrpp_struct_set_port                                             *
+ *                                                                            *
+ * Purpose: Set the index of a port (primary or secondary) in the rrpp        *
+ *          structure                                                         *
+ *                                                                            *
+ * Parameters:  port_index - the index of the port                            *
+ *              selected_port - the port(primary or secondary) to set         *
+ *              rrpp - An rrpp_struct_t pointer                               *
+ *                                                                            *
+ ******************************************************************************/
+static void rrpp_struct_set_port(long port_index, short selected_port, rrpp_struct_t *rrpp){
+    if(rrpp !=NULL){
+        if(selected_port == RRPP_PRIMARY_PORT){
+            rrpp->primary_port = port_index;
+        }
+        if(selected_port == RRPP_SECONDARY_PORT){
+            rrpp->secondary_port = port_index;
+        }
+    }
+}
+
+/******************************************************************************
+ *                                                                            *
+ * Function: rrpp_struct_get_port                                             *
+ *                                                                            *
+ * Purpose: Get the index of a port (primary or secondary) in the rrpp        *
+ *          structure                                                         *
+ *                                                                            *
+ * Parameters:  selected_port - the port(primary or secondary) to get         *
+ *              rrpp - An rrpp_struct_t pointer                               *
+ *                                                                            *
+ ******************************************************************************/
+static long rrpp_struct_get_port(short selected_port, rrpp_struct_t *rrpp){
+    if(rrpp !=NULL){
+        if(selected_port == RRPP_PRIMARY_PORT){
+            return rrpp->primary_port;
+        }
+        if(selected_port == RRPP_SECONDARY_PORT){
+            return rrpp->secondary_port;
+        }
+    }
+    return 0;
 }
 
+/******************************************************************************
+ *                                                                            *
+ * Function: rrpp_struct_set_port_status                                      *
+ *                                                                            *
+ * Purpose: Set the status of a port (primary or secondary) in the rrpp       *
+ *          structure                                                         *
+ *                                                                            *
+ * Parameters:  port_status - the index of the port                           *
+ *              selected_port - the port(primary or secondary) to set         *
+ *              rrpp - An rrpp_struct_t pointer                               *
+ *                                                                            *
+ ******************************************************************************/
+static void rrpp_struct_set_port_status(short port_status, short selected_port, rrpp_struct_t *rrpp){
+    if(rrpp !=NULL){
+        if(selected_port == RRPP_PRIMARY_PORT){
+            rrpp->primary_port_status = port_status;
+        }
+        if(selected_port == RRPP_SECONDARY_PORT){
+            rrpp->secondary_port_status = port_status;
+        }
+    }
+}
 
 /******************************************************************************
  *                                                                            *
- * Function: zbx_module_init                                                  *
- *                                                                            *
- * Purpose: the function is called on agent startup                           *
- *          It should be used to call any initialization routines             *
+ * Function: rrpp_struct_get_port                                             *
  *                                                                            *
- * Return value: ZBX_MODULE_OK - success                                      *
- *               ZBX_MODULE_FAIL - module initialization failed               *
+ * Purpose: Get the status of a port (primary or secondary) in the rrpp       *
+ *          structure                                                         *
  *                                                                            *
- * Comment: the module won't be loaded in case of ZBX_MODULE_FAIL             *
+ * Parameters:  selected_port - the port(primary or secondary) to Get         *
+ *              rrpp - An rrpp_struct_t pointer                               *
  *                                                                            *
  ******************************************************************************/
-int	zbx_module_init()
-{
-    init_snmp("redundantProtocolsMonitoring");
-    return ZBX_MODULE_OK;
+static short rrpp_struct_get_port_status(short selected_port, rrpp_struct_t *rrpp){
+    if(rrpp !=NULL){
+        if(selected_port == RRPP_PRIMARY_PORT){
+            return rrpp->primary_port_status;
+        }
+        if(selected_port == RRPP_SECONDARY_PORT){
+            return rrpp->secondary_port_status;
+        }
+    }
+    return RRPP_UNKNOWN;
 }
 
 /******************************************************************************
  *                                                                            *
- * Function: zbx_module_uninit                                                *
+ * Function: if_status_new                                                    *
  *                                                                            *
- * Purpose: the function is called on agent shutdown                          *
- *          It should be used to cleanup used resources if there are any      *
+ * Purpose: Allocate a new if_status_t without any interface                  *
  *                                                                            *
- * Return value: ZBX_MODULE_OK - success                                      *
- *               ZBX_MODULE_FAIL - function failed                            *
+ * Parameters: status - A pointer of an if_status_t pointer                   *
+ *             arena - the arena of the bitmap, NULL to use malloc            *
  *                                                                            *
  ******************************************************************************/
-int	zbx_module_uninit()
-{
-    return ZBX_MODULE_OK;
+static void if_status_new(if_status_t ** status, arena_t *arena){
+    if(status==NULL)return;
+    *status = (if_status_t *)arena_alloc(arena, sizeof(if_status_t));
+    if(*status!=NULL)memset(*status, 0, sizeof(if_status_t));
 }
 
-
 /******************************************************************************
  *                                                                            *
- * Function: is_valid_ip                                                      *
- *                                                                            *
- * Purpose: Check if the IP address is a valid one                            *
+ * Function: if_status_free                                                   *
  *                                                                            *
- * Parameters: src - string containing an IP address                          *
+ * Purpose: Free an if_status_t                                               *
  *                                                                            *
- * Return value:    0 - the IP address is valid                               *
- *                  1 - the IP address is invalid                             *
+ * Parameters: status - An if_status_t pointer                                *
+ *             arena - the arena of the bitmap, NULL if allocated by malloc   *
  *                                                                            *
- * Comment: The source code come from the inet_pton4 function                 *
- *          of the inet_pton.c file of glibc                                  *
  ******************************************************************************/
-static int is_valid_ip(const char *src)
-{
-    static const char digits[] = "0123456789";
-    int saw_digit, octets, ch;
-    unsigned char tmp[INADDRS], *tp;
-    
-    saw_digit = 0;
-    octets = 0;
-    tp = tmp;
-    *tp = 0;
-    while((ch = *src++) != '\0') {
-        const char *pch;
-        
-        if((pch = strchr(digits, ch)) != NULL) {
-            unsigned int val = *tp * 10 + (unsigned int)(pch - digits);
-            
-            if(saw_digit && *tp == 0)
-                return (1);
-            if(val > 255)
-                return (1);
-            *tp = (unsigned char)val;
-            if(! saw_digit) {
-                if(++octets > 4)
-                    return (1);
-                saw_digit = 1;
-            }
-        }
-        else if(ch == '.' && saw_digit) {
-            if(octets == 4)
-                return (1);
-            *++tp = 0;
-            saw_digit = 0;
-        }
-        else
-            return (1);
-    }
-    if(octets < 4)
-        return 1;
-    return 0;
-}
-char* itoa(int i, char b[]){
-    char const digit[] = "0123456789";
-    char* p = b;
-    if(i<0){
-        *p++ = '-';
-        i *= -1;
+static void if_status_free(if_status_t *status, arena_t *arena){
+    if(status!=NULL){
+        arena_free(arena, status->ifindex);
+        arena_free(arena, status->up);
+        arena_free(arena, status->present);
+        arena_free(arena, status);
     }
-    int shifter = i;
-    do{ //Move to where representation ends
-        ++p;
-        shifter = shifter/10;
-    }while(shifter);
-    do{ //Move back, inserting digits as u go
-        *--p = digit[i%10];
-        i = i/10;
-    }while(i);
-    return b;
-}
-/******************************************************************************
- *                                                                            *
- * Function: snmpbulkget                                                      *
- *                                                                            *
- * Purpose: Do an snmpbulkget request                                         *
- *                                                                            *
- * Parameters: session - an init struct snmp_session                          *
- *             response - a struct snmp_pdu that will contains the response   *
- *                        of the resquest if no failure                       *
- *             id_oid - the oid of the node where to start the request        *
- *             id_len - the lenght of the oid provided                        *
- *             max_repetition - the max repetition of the bulkget request     *
- *                                                                            *
- * Return value:    STAT_SUCCESS - the request was succesfull                 *
- *                  STAT_TIMEOUT - the request timeout                        *
- *                  STAT_ERROR - an error happened during the request         *
- *                  STAT_ERR_INIT - Incorrect initialisation                  *
- *                                                                            *                        *
- ******************************************************************************/
-static int snmpbulkget(struct snmp_session session, struct snmp_pdu ** response, oid id_oid[MAX_OID_LEN], size_t id_len,int max_repetition){
-    int status;
-    struct snmp_session *sess_handle;
-    struct snmp_pdu *pdu;
-    
-    //Init the session
-    sess_handle = snmp_open(&session);
-    if (!sess_handle) {
-        return STAT_ERR_INIT;
-    }
-    //Create the PDU
-    pdu = snmp_pdu_create(SNMP_MSG_GETBULK);
-    pdu->errstat = 0;   //Set getbulk non repeater
-    pdu->errindex = max_repetition; //Set getbulk max repetition
-    snmp_add_null_var(pdu, id_oid, id_len);
-    
-    //Send request
-    status = snmp_synch_response(sess_handle, pdu, response);
-    
-    //Close session
-    snmp_close(sess_handle);
-    return status;
 }
 
 /******************************************************************************
  *                                                                            *
- * Function: snmpbulkget                                                      *
+ * Function: if_status_add                                                    *
  *                                                                            *
- * Purpose: Do an snmpget request                                             *
+ * Purpose: Add the ifOperStatus of the next interface of the ifTable walk    *
  *                                                                            *
- * Parameters: session - an init struct snmp_session                          *
- *             response - a struct snmp_pdu that will contains the response   *
- *                        of the resquest if no failure                       *
- *             id_oid - the oid of the node to request                        *
- *             id_len - the lenght of the oid provided                        *
+ * Parameters:  ifindex - the ifIndex of the interface                        *
+ *              oper_status - the ifOperStatus of the interface, 0 if it is   *
+ *                            not known                                       *
+ *              status - An if_status_t pointer                               *
+ *              arena - the arena of the bitmap, NULL to use malloc           *
  *                                                                            *
- * Return value:    STAT_SUCCESS - the request was succesfull                 *
- *                  STAT_TIMEOUT - the request timeout                        *
- *                  STAT_ERROR - an error happened during the request         *
- *                  STAT_ERR_INIT - Incorrect initialisation                  *
+ * Return value:    SUCCEED - the interface is added                          *
+ *                  FAIL - the bitmap can not be grown                        *
  *                                                                            *
+ * Comment: The interfaces must be added by increasing ifIndex, as they are   *
+ *          returned by the walk, the others are ignored                      *
  ******************************************************************************/
-static int snmpget(struct snmp_session session, struct snmp_pdu ** response,oid id_oid[MAX_OID_LEN], size_t id_len){
-    int status;
-    struct snmp_session *sess_handle;
-    struct snmp_pdu *pdu;
-    
-    //Init the session
-    sess_handle = snmp_open(&session);
-    if (!sess_handle) {
-        return STAT_ERR_INIT;
+static int if_status_add(long ifindex, long oper_status, if_status_t *status, arena_t *arena){
+    long *ifindexes;
+    zbx_uint64_t *up;
+    zbx_uint64_t *present;
+    int max_ifs;
+    int pos;
+
+    if(status==NULL)return FAIL;
+    if(status->nb_ifs > 0 && ifindex <= status->ifindex[status->nb_ifs-1])return SUCCEED;
+
+    //The bitmap is doubled when it is full, it is always a whole number of words
+    if(status->nb_ifs == status->max_ifs){
+        max_ifs = status->max_ifs ? status->max_ifs*2 : 64;
+        ifindexes = (long *)arena_realloc(arena, status->ifindex, sizeof(long)*status->max_ifs, sizeof(long)*max_ifs);
+        if(ifindexes==NULL)return FAIL;
+        status->ifindex = ifindexes;
+        up = (zbx_uint64_t *)arena_realloc(arena, status->up, sizeof(zbx_uint64_t)*(status->max_ifs/64), sizeof(zbx_uint64_t)*(max_ifs/64));
+        if(up==NULL)return FAIL;
+        status->up = up;
+        present = (zbx_uint64_t *)arena_realloc(arena, status->present, sizeof(zbx_uint64_t)*(status->max_ifs/64), sizeof(zbx_uint64_t)*(max_ifs/64));
+        if(present==NULL)return FAIL;
+        status->present = present;
+        memset(status->up + status->max_ifs/64, 0, sizeof(zbx_uint64_t)*((max_ifs-status->max_ifs)/64));
+        memset(status->present + status->max_ifs/64, 0, sizeof(zbx_uint64_t)*((max_ifs-status->max_ifs)/64));
+        status->max_ifs = max_ifs;
     }
-    
-    //Create the PDU
-    pdu = snmp_pdu_create(SNMP_MSG_GET);
-    snmp_add_null_var(pdu, id_oid, id_len);
-    //Send request
-    status = snmp_synch_response(sess_handle, pdu, response);
-    
-    //Close session
-    snmp_close(sess_handle);
-    return status;
-}
 
+    pos = status->nb_ifs++;
+    status->ifindex[pos] = ifindex;
+    if(oper_status != 0)status->present[pos/64] |= (zbx_uint64_t)1 << (pos%64);
+    if(oper_status == PORT_UP)status->up[pos/64] |= (zbx_uint64_t)1 << (pos%64);
+    return SUCCEED;
+}
 
 /******************************************************************************
  *                                                                            *
- * Function: agg_struct_new                                                   *
+ * Function: if_status_find                                                   *
  *                                                                            *
- * Purpose: Allocate a new agg_struct_t                                       *
+ * Purpose: Get the bit of an interface in the bitmap                         *
  *                                                                            *
- * Parameters: agg - A pointer of an agg_struct_t pointer                     *
+ * Parameters:  ifindex - the ifIndex of the interface                        *
+ *              status - An if_status_t pointer                               *
+ *                                                                            *
+ * Return value:    the position of the bit of the interface                  *
+ *                  -1 if the interface is not in the ifTable                 *
  *                                                                            *
  ******************************************************************************/
-static void agg_struct_new(agg_struct_t ** agg){
-    if(agg!=NULL)*agg = (agg_struct_t *)malloc(sizeof(agg_struct_t));
+static int if_status_find(long ifindex, if_status_t *status){
+    int low = 0;
+    int high;
+    int middle;
+
+    if(status==NULL)return -1;
+    //The interfaces are sorted by ifIndex
+    high = status->nb_ifs-1;
+    while(low <= high){
+        middle = (low+high)/2;
+        if(status->ifindex[middle] == ifindex)return middle;
+        if(status->ifindex[middle] < ifindex)low = middle+1;
+        else high = middle-1;
+    }
+    return -1;
 }
 
 /******************************************************************************
  *                                                                            *
- * Function: agg_struct_free                                                  *
+ * Function: if_status_get                                                    *
+ *                                                                            *
+ * Purpose: Get the ifOperStatus of an interface                              *
  *                                                                            *
- * Purpose: Free aa agg_struct_t with all the next dependencies               *
+ * Parameters:  ifindex - the ifIndex of the interface                        *
+ *              status - An if_status_t pointer                               *
  *                                                                            *
- * Parameters: agg - An agg_struct_t pointer                                  *
+ * Return value:    PORT_UP - the interface is up                             *
+ *                  PORT_DOWN - the interface is not up                       *
+ *                  PORT_UNKNOWN - the status of the interface is not known   *
  *                                                                            *
  ******************************************************************************/
-static void agg_struct_free(agg_struct_t *agg){
-    agg_struct_t * current = agg;
-    agg_struct_t * next;
-    //Free all the structure by browsing through them
-    if(agg!=NULL){
-        while (current !=NULL) {
-            next = current->next;
-            free(current);
-            current = next;
-        }
-    }
+static short if_status_get(long ifindex, if_status_t *status){
+    int pos = if_status_find(ifindex, status);
+
+    if(pos < 0 || !(status->present[pos/64] & (zbx_uint64_t)1 << (pos%64)))return PORT_UNKNOWN;
+    if(status->up[pos/64] & (zbx_uint64_t)1 << (pos%64))return PORT_UP;
+    return PORT_DOWN;
 }
 
 /******************************************************************************
  *                                                                            *
- * Function: agg_struct_init                                                  *
+ * Function: if_status_count_down                                             *
  *                                                                            *
- * Purpose: Init an agg_struct_t                                              *
+ * Purpose: Count the interfaces of a mask whose status is known and not up   *
  *                                                                            *
- * Parameters:  index - the index value to initialise the struct with         *
- *              agg - An agg_struct_t pointer                                 *
+ * Parameters:  mask - a bitmap of the interfaces to count, with the same     *
+ *                     positions as the status bitmap                         *
+ *              status - An if_status_t pointer                               *
+ *                                                                            *
+ * Return value: the number of interfaces down                                *
  *                                                                            *
  ******************************************************************************/
-static void agg_struct_init(long index, agg_struct_t *agg){
-    if(agg!=NULL){
-        agg->index = index;
-        agg->next = NULL;
-        agg->nb_ports = 0;
-        agg->status = AGG_STATUS_UNKNOWN;
+static int if_status_count_down(zbx_uint64_t *mask, if_status_t *status){
+    zbx_uint64_t word;
+    int nb_down = 0;
+    int i;
+
+    //The interfaces are evaluated 64 at a time
+    for(i=0;i<(status->nb_ifs+63)/64;i++){
+        word = mask[i] & status->present[i] & ~status->up[i];
+#if defined(__GNUC__)
+        nb_down += __builtin_popcountll(word);
+#else
+        while(word){
+            word &= word-1;
+            nb_down++;
+        }
+#endif
     }
+    return nb_down;
 }
 
 /******************************************************************************
  *                                                                            *
- * Function: agg_struct_exist                                                 *
+ * Function: if_status_copy                                                   *
  *                                                                            *
- * Purpose: Retrieve a struct node in the list with a specific index value    *
+ * Purpose: Duplicate an if_status_t                                          *
  *                                                                            *
- * Parameters:  index - the index value of the aggregation                    *
- *              agg - An agg_struct_t pointer                                 *
+ * Parameters:  status - An if_status_t pointer                               *
+ *              arena - the arena of the copy, NULL to use malloc             *
+ *                                                                            *
+ * Return value:    the copy of the bitmap                                    *
+ *                  NULL if failure                                           *
  *                                                                            *
- * Return value:    the address of the node if found                          *
- *                  NULL otherwise                                            *
  ******************************************************************************/
-static agg_struct_t * agg_struct_exist(long index,agg_struct_t * agg){
-    agg_struct_t *n = agg;
-    while(n != NULL){
-        if(n->index == index)return n;
-        n = n->next;
+static if_status_t * if_status_copy(if_status_t *status, arena_t *arena){
+    if_status_t *copy;
+    int max_ifs;
+
+    if(status==NULL)return NULL;
+    if_status_new(&copy, arena);
+    if(copy==NULL)return NULL;
+    max_ifs = (status->nb_ifs+63)/64*64;
+    if(max_ifs > 0){
+        copy->ifindex = (long *)arena_alloc(arena, sizeof(long)*max_ifs);
+        copy->up = (zbx_uint64_t *)arena_alloc(arena, sizeof(zbx_uint64_t)*(max_ifs/64));
+        copy->present = (zbx_uint64_t *)arena_alloc(arena, sizeof(zbx_uint64_t)*(max_ifs/64));
+        if(copy->ifindex==NULL || copy->up==NULL || copy->present==NULL){
+            if_status_free(copy, arena);
+            return NULL;
+        }
+        memcpy(copy->ifindex, status->ifindex, sizeof(long)*status->nb_ifs);
+        memcpy(copy->up, status->up, sizeof(zbx_uint64_t)*(max_ifs/64));
+        memcpy(copy->present, status->present, sizeof(zbx_uint64_t)*(max_ifs/64));
     }
-    return NULL;
+    copy->nb_ifs = status->nb_ifs;
+    copy->max_ifs = max_ifs;
+    copy->time = status->time;
+    return copy;
 }
 
 /******************************************************************************
  *                                                                            *
- * Function: agg_struct_add                                                   *
+ * Function: if_status_assign                                                 *
  *                                                                            *
- * Purpose: Add a struct node at the end of the list with a index value       *
+ * Purpose: Copy an if_status_t in another one allocated by malloc            *
  *                                                                            *
- * Parameters:  index - the index value to initialise the new struct with     *
- *              agg - An agg_struct_t pointer                                 *
+ * Parameters:  copy - A pointer of the if_status_t pointer to overwrite,     *
+ *                     it is allocated if NULL                                *
+ *              status - An if_status_t pointer                               *
  *                                                                            *
- ******************************************************************************/
-static agg_struct_t * agg_struct_add(long index, agg_struct_t ** agg){
-    agg_struct_t *n = *agg;
-    agg_struct_t * new;
-    agg_struct_new(&new);
-    agg_struct_init(index, new);
-    if(*agg==NULL)*agg = new;
-    else{
-        while (n->next !=NULL) n = n->next;
-        n->next = new;
+ * Return value:    SUCCEED - the bitmap is copied                            *
+ *                  FAIL - the copy can not be grown                          *
+ *                                                                            *
+ * Comment: The arrays of the copy are reused while they are large enough     *
+ *****************************************************************************/
+static int if_status_assign(if_status_t **copy, if_status_t *status){
+    if_status_t *c;
+    long *ifindexes;
+    zbx_uint64_t *up;
+    zbx_uint64_t *present;
+    int max_ifs;
+
+    if(status==NULL)return FAIL;
+    if(*copy==NULL){
+        if_status_new(copy, NULL);
+        if(*copy==NULL)return FAIL;
     }
-    return new;
+    c = *copy;
+    max_ifs = (status->nb_ifs+63)/64*64;
+    if(max_ifs > c->max_ifs){
+        ifindexes = (long *)realloc(c->ifindex, sizeof(long)*max_ifs);
+        if(ifindexes==NULL)return FAIL;
+        c->ifindex = ifindexes;
+        up = (zbx_uint64_t *)realloc(c->up, sizeof(zbx_uint64_t)*(max_ifs/64));
+        if(up==NULL)return FAIL;
+        c->up = up;
+        present = (zbx_uint64_t *)realloc(c->present, sizeof(zbx_uint64_t)*(max_ifs/64));
+        if(present==NULL)return FAIL;
+        c->present = present;
+        c->max_ifs = max_ifs;
+    }
+    if(max_ifs > 0){
+        memcpy(c->ifindex, status->ifindex, sizeof(long)*status->nb_ifs);
+        memcpy(c->up, status->up, sizeof(zbx_uint64_t)*(max_ifs/64));
+        memcpy(c->present, status->present, sizeof(zbx_uint64_t)*(max_ifs/64));
+    }
+    c->nb_ifs = status->nb_ifs;
+    c->time = status->time;
+    return SUCCEED;
 }
 
+
 /******************************************************************************
  *                                                                            *
- * Function: agg_struct_add_port                                              *
+ * Function: flap_table_free                                                  *
  *                                                                            *
- * Purpose: Add a port in the aggregation structure                           *
+ * Purpose: Free a flap_table_t                                               *
  *                                                                            *
- * Parameters:  port_index - the index of the port to add                     *
- *              agg - An agg_struct_t pointer                                 *
+ * Parameters:  table - A flap_table_t pointer                                *
  *                                                                            *
  ******************************************************************************/
-static void agg_struct_add_port(long port_index,agg_struct_t *agg){
-    if(agg!=NULL && agg->nb_ports<MAX_PORT_AGG){
-        agg->ports[agg->nb_ports] = port_index;
-        agg->nb_ports ++;
+static void flap_table_free(flap_table_t *table){
+    if(table!=NULL){
+        free(table->flaps);
+        free(table->slots);
+        free(table);
     }
 }
 
 /******************************************************************************
  *                                                                            *
- * Function: rrpp_struct_new                                                  *
+ * Function: flap_table_exist                                                 *
  *                                                                            *
- * Purpose: Allocate a new rrpp_struct_t                                      *
+ * Purpose: Retrieve the history of a port or a ring                          *
  *                                                                            *
- * Parameters: rppp - A pointer of an rrpp_struct_t pointer                   *
+ * Parameters:  key - the ifIndex of the port or the key of the ring          *
+ *              table - A flap_table_t pointer                                *
  *                                                                            *
+ * Return value:    the address of the history if found                       *
+ *                  NULL otherwise                                            *
  ******************************************************************************/
-static void rrpp_struct_new(rrpp_struct_t ** rrpp){
-    if(rrpp !=NULL) *rrpp = (rrpp_struct_t *)malloc(sizeof(rrpp_struct_t));
+static flap_struct_t * flap_table_exist(unsigned long key, flap_table_t * table){
+    int slot;
+
+    if(table==NULL || table->nb_slots==0)return NULL;
+    //The slots hold the position of the histories plus one, 0 is an empty slot
+    slot = table_slot(key, table->nb_slots);
+    while(table->slots[slot] != 0){
+        if(table->flaps[table->slots[slot]-1].key == key)return &table->flaps[table->slots[slot]-1];
+        slot = (slot+1) & (table->nb_slots-1);
+    }
+    return NULL;
 }
 
 /******************************************************************************
  *                                                                            *
- * Function: rrpp_struct_free                                                 *
+ * Function: flap_table_update                                                *
+ *                                                                            *
+ * Purpose: Give the status of a port or a ring to its history                *
  *                                                                            *
- * Purpose: Free aa rrpp_struct_t with all the next dependencies              *
+ * Parameters:  key - the ifIndex of the port or the key of the ring          *
+ *              status - the status evaluated                                 *
+ *              time - the time of the evaluation                             *
+ *              table - A pointer of a flap_table_t pointer, the table is     *
+ *                      allocated with the first history                      *
  *                                                                            *
- * Parameters: rrpp - An rrpp_struct_t pointer                                *
+ * Return value:    SUCCEED - the history is updated                          *
+ *                  FAIL - the history can not be allocated                   *
  *                                                                            *
+ * Comment: A transition is recorded when the status differs from the last    *
+ *          one. A status older than the last one is ignored, as the          *
+ *          evaluations of the items of a device may end in any order         *
  ******************************************************************************/
-static void rrpp_struct_free(rrpp_struct_t *rrpp){
-    rrpp_struct_t * current = rrpp;
-    rrpp_struct_t * next;
-    //Free all the structure by browsing through them
-    if(rrpp!=NULL){
-        while (current !=NULL) {
-            next = current->next;
-            free(current);
-            current = next;
+static int flap_table_update(unsigned long key, short status, time_t time, flap_table_t ** table){
+    flap_table_t *t;
+    flap_struct_t *flap;
+    flap_struct_t *flaps;
+    int *slots;
+    int nb_slots;
+    int slot;
+    int i;
+
+    flap = flap_table_exist(key, *table);
+    if(flap != NULL){
+        if(time < flap->time)return SUCCEED;
+        if(status != flap->status){
+            flap->last_change = (flap->last_change+1) % FLAP_HISTORY_LEN;
+            flap->changes[flap->last_change] = time;
+            if(flap->nb_changes < FLAP_HISTORY_LEN)flap->nb_changes++;
+            flap->status = status;
+        }
+        flap->time = time;
+        return SUCCEED;
+    }
+
+    if(*table==NULL){
+        *table = (flap_table_t *)malloc(sizeof(flap_table_t));
+        if(*table==NULL)return FAIL;
+        memset(*table, 0, sizeof(flap_table_t));
+    }
+    t = *table;
+
+    //The array of the histories is doubled when it is full
+    if(t->nb_flaps == t->max_flaps){
+        flaps = (flap_struct_t *)realloc(t->flaps, sizeof(flap_struct_t)*(t->max_flaps ? t->max_flaps*2 : 8));
+        if(flaps==NULL)return FAIL;
+        t->flaps = flaps;
+        t->max_flaps = t->max_flaps ? t->max_flaps*2 : 8;
+    }
+    //The hash index is rebuilt with twice more slots when it is half full
+    if((t->nb_flaps+1)*2 > t->nb_slots){
+        nb_slots = t->nb_slots ? t->nb_slots*2 : 16;
+        slots = (int *)calloc(nb_slots, sizeof(int));
+        if(slots==NULL)return FAIL;
+        for(i=0;i<t->nb_flaps;i++){
+            slot = table_slot(t->flaps[i].key, nb_slots);
+            while(slots[slot] != 0)slot = (slot+1) & (nb_slots-1);
+            slots[slot] = i+1;
         }
+        free(t->slots);
+        t->slots = slots;
+        t->nb_slots = nb_slots;
     }
+
+    //The first status known is not a transition
+    flap = &t->flaps[t->nb_flaps];
+    memset(flap, 0, sizeof(flap_struct_t));
+    flap->key = key;
+    flap->status = status;
+    flap->time = time;
+    slot = table_slot(key, t->nb_slots);
+    while(t->slots[slot] != 0)slot = (slot+1) & (t->nb_slots-1);
+    t->slots[slot] = ++t->nb_flaps;
+    return SUCCEED;
 }
 
 /******************************************************************************
  *                                                                            *
- * Function: rrpp_struct_init                                                 *
+ * Function: flap_table_count                                                 *
  *                                                                            *
- * Purpose: Init an rrpp_struct_t                                             *
+ * Purpose: Count the transitions of a port or a ring since a given time      *
  *                                                                            *
- * Parameters:  domain - the domain ip of the rrpp ring                       *
- *              ring - the ring id of the rrpp ring                           *
- *              rrpp - An rrpp_struct_t pointer                               *
+ * Parameters:  key - the ifIndex of the port or the key of the ring          *
+ *              since - the oldest time counted                               *
+ *              table - A flap_table_t pointer                                *
+ *                                                                            *
+ * Return value: the number of transitions, at most FLAP_HISTORY_LEN          *
  *                                                                            *
  ******************************************************************************/
-static void rrpp_struct_init(short domain, short ring,rrpp_struct_t *rrpp){
-    if(rrpp !=NULL){
-        rrpp->next = NULL;
-        rrpp->domain = domain;
-        rrpp->ring = ring;
-        rrpp->primary_port = 0;
-        rrpp->secondary_port = 0;
-        rrpp->primary_port_status = RRPP_UNKNOWN;
-        rrpp->secondary_port_status = RRPP_UNKNOWN;
+static int flap_table_count(unsigned long key, time_t since, flap_table_t * table){
+    flap_struct_t *flap = flap_table_exist(key, table);
+    int nb = 0;
+    int i;
+
+    if(flap == NULL)return 0;
+    //The transitions are browsed from the last one until an older one is found
+    for(i=0;i<flap->nb_changes;i++){
+        if(flap->changes[(flap->last_change-i+FLAP_HISTORY_LEN) % FLAP_HISTORY_LEN] < since)break;
+        nb++;
     }
+    return nb;
 }
 
 /******************************************************************************
  *                                                                            *
- * Function: rrpp_struct_exist                                                *
+ * Function: device_struct_new                                                *
  *                                                                            *
- * Purpose: Retrieve a struct node in the list with a specific index value    *
+ * Purpose: Allocate a new device_struct_t                                    *
  *                                                                            *
- * Parameters:  domain - the domain ip of the rrpp ring                       *
- *              ring - the ring id of the rrpp ring                           *
- *              rrpp - An rrpp_struct_t pointer                               *
+ * Parameters: device - A pointer of a device_struct_t pointer                *
  *                                                                            *
- * Return value:    the address of the node if found                          *
- *                  NULL otherwise                                            *
  ******************************************************************************/
-static rrpp_struct_t * rrpp_struct_exist(short domain,short ring,rrpp_struct_t * rrpp){
-    rrpp_struct_t *n = rrpp;
-    while(n != NULL){
-        if(n->domain == domain && n->ring == ring)return n;
-        n = n->next;
-    }
-    return NULL;
+static void device_struct_new(device_struct_t ** device){
+    if(device !=NULL) *device = (device_struct_t *)malloc(sizeof(device_struct_t));
 }
 
 /******************************************************************************
  *                                                                            *
- * Function: rrpp_struct_add                                                  *
+ * Function: device_struct_free                                               *
  *                                                                            *
- * Purpose: Add a struct node at the end of the list with a index value       *
+ * Purpose: Free a device_struct_t with all the next dependencies             *
  *                                                                            *
- * Parameters:  domain - the domain ip of the rrpp ring                       *
- *              ring - the ring id of the rrpp ring                           *
- *              rrpp - An rrpp_struct_t pointer                               *
+ * Parameters: device - A device_struct_t pointer                             *
  *                                                                            *
  ******************************************************************************/
-static rrpp_struct_t * rrpp_struct_add(short domain, short ring, rrpp_struct_t ** rrpp){
-    rrpp_struct_t *n = *rrpp;
-    rrpp_struct_t * new;
-    rrpp_struct_new(&new);
-    rrpp_struct_init(domain,ring, new);
-    if(*rrpp==NULL)*rrpp = new;
-    else{
-        while (n->next !=NULL) n = n->next;
-        n->next = new;
+static void device_struct_free(device_struct_t *device){
+    device_struct_t * current = device;
+    device_struct_t * next;
+    //Free all the structure by browsing through them
+    while (current !=NULL) {
+        next = current->next;
+        agg_table_free(current->agg);
+        agg_table_free(current->lacp_walk.agg);
+        agg_table_free(current->lacp_walk.spare);
+        if_status_free(current->if_status, NULL);
+        rrpp_table_free(current->rrpp);
+        irf_table_free(current->irf);
+        flap_table_free(current->port_flaps);
+        flap_table_free(current->ring_flaps);
+        free(current->trace);
+        free(current->recorder);
+        free(current);
+        current = next;
     }
-    return new;
 }
 
-
 /******************************************************************************
  *                                                                            *
- * Function: rrpp_struct_set_port                                             *
+ * Function: device_struct_init                                               *
  *                                                                            *
- * Purpose: Set the index of a port (primary or secondary) in the rrpp        *
- *          structure                                                         *
+ * Purpose: Init a device_struct_t                                            *
  *                                                                            *
- * Parameters:  port_index - the index of the port                            *
- *              selected_port - the port(primary or secondary) to set         *
- *              rrpp - An rrpp_struct_t pointer                               *
+ * Parameters:  ip_address - the IP address of the device                     *
+ *              device - A device_struct_t pointer                            *
  *                                                                            *
  ******************************************************************************/
-static void rrpp_struct_set_port(long port_index, short selected_port, rrpp_struct_t *rrpp){
-    if(rrpp !=NULL){
-        if(selected_port == RRPP_PRIMARY_PORT){
-            rrpp->primary_port = port_index;
-        }
-        if(selected_port == RRPP_SECONDARY_PORT){
-            rrpp->secondary_port = port_index;
-        }
+static void device_struct_init(const char *ip_address, device_struct_t *device){
+    if(device !=NULL){
+        device->next = NULL;
+        strncpy(device->ip_address, ip_address, IP_ADDRESS_LEN-1);
+        device->ip_address[IP_ADDRESS_LEN-1] = '\0';
+        device->nb_timeouts = 0;
+        device->breaker_state = BREAKER_CLOSED;
+        device->breaker_retry = 0;
+        device->breaker_backoff = BREAKER_BACKOFF_MIN;
+        device->agg = NULL;
+        device->agg_discovered = 0;
+        device->agg_time = 0;
+        device->agg_eval_time = 0;
+        lacp_walk_init(&device->lacp_walk);
+        device->lacp_walk.spare = NULL;
+        device->lacp_busy = 0;
+        device->if_status = NULL;
+        device->rrpp = NULL;
+        device->irf = NULL;
+        memset(device->fingerprint, 0, sizeof(device->fingerprint));
+        memset(device->fingerprint_set, 0, sizeof(device->fingerprint_set));
+        device->port_flaps = NULL;
+        device->ring_flaps = NULL;
+        device->trace = NULL;
+        device->recorder = NULL;
     }
 }
 
 /******************************************************************************
  *                                                                            *
- * Function: rrpp_struct_get_port                                             *
+ * Function: device_struct_exist                                              *
  *                                                                            *
- * Purpose: Get the index of a port (primary or secondary) in the rrpp        *
- *          structure                                                         *
+ * Purpose: Retrieve a struct node in the list with a specific IP address     *
  *                                                                            *
- * Parameters:  selected_port - the port(primary or secondary) to get         *
- *              rrpp - An rrpp_struct_t pointer                               *
+ * Parameters:  ip_address - the IP address of the device                     *
+ *              device - A device_struct_t pointer                            *
  *                                                                            *
+ * Return value:    the address of the node if found                          *
+ *                  NULL otherwise                                            *
  ******************************************************************************/
-static long rrpp_struct_get_port(short selected_port, rrpp_struct_t *rrpp){
-    if(rrpp !=NULL){
-        if(selected_port == RRPP_PRIMARY_PORT){
-            return rrpp->primary_port;
-        }
-        if(selected_port == RRPP_SECONDARY_PORT){
-            return rrpp->secondary_port;
-        }
+static device_struct_t * device_struct_exist(const char *ip_address, device_struct_t * device){
+    device_struct_t *n = device;
+    while(n != NULL){
+        if(strcmp(n->ip_address, ip_address) == 0)return n;
+        n = n->next;
     }
-    return 0;
+    return NULL;
 }
 
 /******************************************************************************
  *                                                                            *
- * Function: rrpp_struct_set_port_status                                      *
+ * Function: device_struct_add                                                *
  *                                                                            *
- * Purpose: Set the status of a port (primary or secondary) in the rrpp       *
- *          structure                                                         *
+ * Purpose: Add a struct node at the beginning of the list                    *
  *                                                                            *
- * Parameters:  port_status - the index of the port                           *
- *              selected_port - the port(primary or secondary) to set         *
- *              rrpp - An rrpp_struct_t pointer                               *
+ * Parameters:  ip_address - the IP address of the device                     *
+ *              device - A pointer of a device_struct_t pointer               *
  *                                                                            *
  ******************************************************************************/
-static void rrpp_struct_set_port_status(short port_status, short selected_port, rrpp_struct_t *rrpp){
-    if(rrpp !=NULL){
-        if(selected_port == RRPP_PRIMARY_PORT){
-            rrpp->primary_port_status = port_status;
-        }
-        if(selected_port == RRPP_SECONDARY_PORT){
-            rrpp->secondary_port_status = port_status;
-        }
-    }
+static device_struct_t * device_struct_add(const char *ip_address, device_struct_t ** device){
+    device_struct_t * new;
+    device_struct_new(&new);
+    if(new == NULL)return NULL;
+    device_struct_init(ip_address, new);
+    new->next = *device;
+    *device = new;
+    return new;
 }
 
 /******************************************************************************
  *                                                                            *
- * Function: rrpp_struct_get_port                                             *
+ * Function: device_struct_get                                                *
  *                                                                            *
- * Purpose: Get the status of a port (primary or secondary) in the rrpp       *
- *          structure                                                         *
+ * Purpose: Retrieve the state of a device, it is created on the first call   *
  *                                                                            *
- * Parameters:  selected_port - the port(primary or secondary) to Get         *
- *              rrpp - An rrpp_struct_t pointer                               *
+ * Parameters:  ip_address - the IP address of the device                     *
  *                                                                            *
+ * Return value:    the address of the node                                   *
+ *                  NULL if it can not be allocated                           *
  ******************************************************************************/
-static short rrpp_struct_get_port_status(short selected_port, rrpp_struct_t *rrpp){
-    if(rrpp !=NULL){
-        if(selected_port == RRPP_PRIMARY_PORT){
-            return rrpp->primary_port_status;
-        }
-        if(selected_port == RRPP_SECONDARY_PORT){
-            return rrpp->secondary_port_status;
-        }
-    }
-    return RRPP_UNKNOWN;
+static device_struct_t * device_struct_get(const char *ip_address){
+    device_struct_t *device;
+    if(ip_address == NULL)return NULL;
+    pthread_mutex_lock(&devices_lock);
+    device = device_struct_exist(ip_address, devices);
+    if(device == NULL)device = device_struct_add(ip_address, &devices);
+    pthread_mutex_unlock(&devices_lock);
+    return device;
 }
 